@@ -422,6 +422,8 @@
 		kNMCloseComplete	= 8,
 		/**allow servers to be called back to update the response data before an enumeration response is returned to a client.*/
 		kNMUpdateResponse	= 9,
+		/**Sent to an endpoint opened asynchronously (e.g. with "IPasync=true" in a TCP/IP config string) once it is connected, or with an error if it could not be.  Until then the endpoint can only be closed.*/
+		kNMOpenComplete		= 10,
 
 		/**Define the next free callback # available (also an easy way to avoid ending , on updates) */
 		kNMNextFreeCallbackCode
@@ -657,6 +659,16 @@
 		char		name[kNMNameLength];
 	};
 	typedef struct NMProtocolStruct NMProtocol;
+	
+	/**One piece of a scatter/gather send, passed in arrays to \ref ProtocolSendv() and \ref ProtocolSendPacketv().  \ref ProtocolSendPackets() takes an array of them too, one per datagram.*/
+	struct NMIOVecStruct
+	{
+		/**Start of the data for this piece.*/
+		void		*data;
+		/**Length of the data for this piece, in bytes.*/
+		NMUInt32	length;
+	};
+	typedef struct NMIOVecStruct NMIOVec;
 		
 	/**Opaque reference to an OpenPlay Endpoint. All data sending/receiving in OpenPlay occurs through Endpoints.*/
 	typedef struct Endpoint *PEndpointRef;
@@ -784,6 +796,36 @@
 	};
 	typedef struct NSpGameInfo				NSpGameInfo;
 	
+	/* Message pool statistics.  Messages bigger than the standard message size
+	   are carved from power-of-two size classes; anything above the pool
+	   ceiling is allocated on its own and counted in oversizeAllocs. */
+
+	enum {
+		kNSpMessagePoolMaxClasses			= 16,
+		kNSpDefaultMessagePoolCeiling		= 65536
+	};
+
+	struct NSpMessagePoolClassStats {
+		NMUInt32 							blockSize;		/* Largest message this class holds */
+		NMUInt32 							blocks;			/* Blocks allocated for this class */
+		NMUInt32 							freeBlocks;		/* Blocks waiting on the free list */
+		NMUInt32 							hits;			/* Allocations served from the free list */
+		NMUInt32 							misses;			/* Allocations that went to the heap */
+	};
+	typedef struct NSpMessagePoolClassStats	NSpMessagePoolClassStats;
+
+	struct NSpMessagePoolStats {
+		NMUInt32 							classCount;
+		NMUInt32 							oversizeAllocs;
+		NSpMessagePoolClassStats 			classes[kNSpMessagePoolMaxClasses];
+	};
+	typedef struct NSpMessagePoolStats		NSpMessagePoolStats;
+
+	/* Default bytes of postponed sends held per connection channel */
+	enum {
+		kNSpDefaultSendBacklogSize			= 65536
+	};
+	
 	/* Structure used for sending and receiving network messages */
 
 	struct NSpMessageHeader {
@@ -910,7 +952,8 @@
 	/* Options for Hosting Joining, and Deleting games */
 	enum {
 		kNSpGameFlag_DontAdvertise		= 0x00000001,
-		kNSpGameFlag_ForceTerminateGame = 0x00000002
+		kNSpGameFlag_ForceTerminateGame = 0x00000002,
+		kNSpGameFlag_CoalesceSends		= 0x00000004	/* gather small registered messages into fewer writes; see NSpGame_Flush */
 	};
 	
 	/* Message "what" types */
@@ -1140,6 +1183,19 @@ extern "C" {
 											NMUInt32 inLength, 
 											NMFlags inFlags);
 										
+		OP_DEFINE_API_C(NMErr) 
+		ProtocolSendPacketv				(	PEndpointRef endpoint, 
+											const NMIOVec *inVectors, 
+											NMUInt32 inCount, 
+											NMFlags inFlags);
+										
+		OP_DEFINE_API_C(NMErr) 
+		ProtocolSendPackets				(	PEndpointRef endpoint, 
+											const NMIOVec *inPackets, 
+											NMUInt32 inCount, 
+											NMUInt32 *outSent, 
+											NMFlags inFlags);
+										
 		OP_DEFINE_API_C(NMErr) 
 		ProtocolReceivePacket			(	PEndpointRef endpoint, 
 											void *outData, 
@@ -1165,6 +1221,12 @@ extern "C" {
 											NMUInt32 inSize, 
 											NMFlags inFlags);
 												
+		OP_DEFINE_API_C(NMSInt32) 
+		ProtocolSendv					(	PEndpointRef endpoint, 
+											const NMIOVec *inVectors, 
+											NMUInt32 inCount, 
+											NMFlags inFlags);
+												
 		OP_DEFINE_API_C(NMErr) 
 		ProtocolReceive					(	PEndpointRef endpoint, 
 											void *outData, 
@@ -1348,6 +1410,12 @@ extern "C" {
 	NSpGame_GetInfo					(NSpGameReference 		inGame,
 									 NSpGameInfo *			ioInfo);
 	
+	/* In a game hosted or joined with kNSpGameFlag_CoalesceSends, small registered
+	   messages wait a few milliseconds to share one write with those that follow.
+	   NSpGame_Flush sends anything waiting now, e.g. at the end of a frame. */
+	OP_DEFINE_API_C( NMErr )
+	NSpGame_Flush					(NSpGameReference 		inGame);
+	
 	/**************************  Messaging  **************************/
 	OP_DEFINE_API_C( NMErr )
 	NSpMessage_Send					(NSpGameReference 		inGame,
@@ -1357,9 +1425,30 @@ extern "C" {
 	OP_DEFINE_API_C( NSpMessageHeader *)
 	NSpMessage_Get					(NSpGameReference 		inGame);
 	
+	/* Like NSpMessage_Get, but the message stays in NetSprocket's receive buffer
+	   instead of being handed over.  It holds one reference; NSpMessage_Retain
+	   adds one, NSpMessage_Return drops one, and the buffer is reused once the
+	   last is returned.  Never pass a borrowed message to NSpMessage_Release.
+	   NSpGame_Dispose takes back any borrowed messages still outstanding; they
+	   are invalid once the game is disposed and must not be read or returned. */
+	OP_DEFINE_API_C( NSpMessageHeader *)
+	NSpMessage_GetBorrowed			(NSpGameReference 		inGame);
+
+	OP_DEFINE_API_C( NMErr )
+	NSpMessage_Retain				(NSpGameReference 		inGame,
+									 NSpMessageHeader *		inMessage);
+
+	OP_DEFINE_API_C( NMErr )
+	NSpMessage_Return				(NSpGameReference 		inGame,
+									 NSpMessageHeader *		inMessage);
+
 	OP_DEFINE_API_C( NMUInt32 )
 	NSpMessage_GetBacklog( NSpGameReference inGame );
 
+	OP_DEFINE_API_C( NMErr )
+	NSpMessage_GetPoolStats			(NSpGameReference 		inGame,
+									 NSpMessagePoolStats *	outStats);
+
 	OP_DEFINE_API_C( void )
 	NSpMessage_Release				(NSpGameReference 		inGame,
 									 NSpMessageHeader *		inMessage);
@@ -1409,6 +1498,10 @@ extern "C" {
 	NSpPlayer_GetRoundTripTime		(NSpGameReference 		inGame,
 									 NSpPlayerID 			inPlayer);
 	
+	OP_DEFINE_API_C( NMSInt32 )
+	NSpPlayer_GetRoundTripJitter	(NSpGameReference 		inGame,
+									 NSpPlayerID 			inPlayer);
+	
 	OP_DEFINE_API_C( NMSInt32 )
 	NSpPlayer_GetThruput			(NSpGameReference 		inGame,
 									 NSpPlayerID 			inPlayer);
@@ -1458,6 +1551,15 @@ extern "C" {
 	OP_DEFINE_API_C( void )
 	NSpSetConnectTimeout			(NMUInt32 				inSeconds);
 	
+	OP_DEFINE_API_C( void )
+	NSpSetMessagePoolCeiling		(NMUInt32 				inMaxMessageSize);
+	
+	/* Bytes of postponed sends each connection will hold, per stream and datagram
+	   channel, before NSpMessage_Send returns kNSpPipeFullErr.  Defaults to
+	   kNSpDefaultSendBacklogSize. */
+	OP_DEFINE_API_C( void )
+	NSpSetSendBacklogSize			(NMUInt32 				inBytes);
+	
 	OP_DEFINE_API_C( void )
 	NSpClearMessageHeader			(NSpMessageHeader *		inMessage);
 	
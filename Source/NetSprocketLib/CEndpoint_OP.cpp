@@ -75,14 +75,11 @@ CEndpoint::CEndpoint(NSpGame *inGame)
 	machine_mem_zero(&mStreamSendInfo, sizeof (SendInfo));	
 	machine_mem_zero(&mDatagramSendInfo, sizeof (SendInfo));
 
-	mStreamSendInfo.sendQ = new NMList();
+	mStreamSendInfo.sendQ = new NSpSendRing(gSendBacklogSize);
 	op_assert(mStreamSendInfo.sendQ);
 	
-	mStreamSendInfo.sendQ->Init();
-	
-	mDatagramSendInfo.sendQ = new NMList();
+	mDatagramSendInfo.sendQ = new NSpSendRing(gSendBacklogSize);
 	op_assert(mDatagramSendInfo.sendQ);
-	mDatagramSendInfo.sendQ->Init();
 		
 		
 	mConnectionReqCount = 0;
@@ -97,11 +94,34 @@ CEndpoint::CEndpoint(NSpGame *inGame)
 	mCurrentMessage = NULL;
 	
 	mRTT = 0;
+	mRTTVar = 0;
+	bHaveRTT = false;
+	mNextPingTime = 0;
+	bEchoPending = false;
+	mEchoStamp = 0;
+	mEchoReceived = 0;
 	mMaxRTT = 0;
-	mThruput = 0;
+	mBytesReceived = 0;
+	mAckBytes = 0;
+	mAckStamp = 0;
+	bHaveAck = false;
+	mAckThruput = 0;
+	mProbeThruput = 0;
+	mNextProbeTime = 0;
+	mProbeStart = 0;
+	mProbeBytes = 0;
+	bProbing = false;
+	bProbeReplyPending = false;
+	mProbeReplyRate = 0;
+	mProbeReplyTo = 0;
 	mMinThruput = 0;
 	mLastSentMessageTimeStamp = 0;
 	bDisposing = false;	
+
+	bCoalesce = (0 != (mGame->GetFlags() & kNSpGameFlag_CoalesceSends));
+	mCoalesceBuffer = NULL;
+	mCoalesceLen = 0;
+	mCoalesceStart = 0;
 }
 
 //----------------------------------------------------------------------------------------
@@ -124,13 +144,11 @@ CEndpoint::CEndpoint(NSpGame *inGame, EPCookie *inUnreliableCookie, EPCookie *in
 	machine_mem_zero(&mStreamSendInfo, sizeof (SendInfo));
 	machine_mem_zero(&mDatagramSendInfo, sizeof (SendInfo));
 
-	mStreamSendInfo.sendQ = new NMList();
+	mStreamSendInfo.sendQ = new NSpSendRing(gSendBacklogSize);
 	op_assert(mStreamSendInfo.sendQ);
-	mStreamSendInfo.sendQ->Init();
 	
-	mDatagramSendInfo.sendQ = new NMList();
+	mDatagramSendInfo.sendQ = new NSpSendRing(gSendBacklogSize);
 	op_assert(mDatagramSendInfo.sendQ);
-	mDatagramSendInfo.sendQ->Init();
 		
 	mPendingJoinConnections = NULL;
 	bAcceptConnections = false;
@@ -145,8 +163,26 @@ CEndpoint::CEndpoint(NSpGame *inGame, EPCookie *inUnreliableCookie, EPCookie *in
 	mCurrentMessage = NULL;
 	
 	mRTT = 0;
+	mRTTVar = 0;
+	bHaveRTT = false;
+	mNextPingTime = 0;
+	bEchoPending = false;
+	mEchoStamp = 0;
+	mEchoReceived = 0;
 	mMaxRTT = 0;
-	mThruput = 0;
+	mBytesReceived = 0;
+	mAckBytes = 0;
+	mAckStamp = 0;
+	bHaveAck = false;
+	mAckThruput = 0;
+	mProbeThruput = 0;
+	mNextProbeTime = 0;
+	mProbeStart = 0;
+	mProbeBytes = 0;
+	bProbing = false;
+	bProbeReplyPending = false;
+	mProbeReplyRate = 0;
+	mProbeReplyTo = 0;
 	mMinThruput = 0;
 
 
@@ -165,9 +201,32 @@ CEndpoint::CEndpoint(NSpGame *inGame, EPCookie *inUnreliableCookie, EPCookie *in
 	bHosting = false;
 	
 	mRTT = 0;
+	mRTTVar = 0;
+	bHaveRTT = false;
+	mNextPingTime = 0;
+	bEchoPending = false;
+	mEchoStamp = 0;
+	mEchoReceived = 0;
 	mMaxRTT = 0;
-	mThruput = 0;
+	mBytesReceived = 0;
+	mAckBytes = 0;
+	mAckStamp = 0;
+	bHaveAck = false;
+	mAckThruput = 0;
+	mProbeThruput = 0;
+	mNextProbeTime = 0;
+	mProbeStart = 0;
+	mProbeBytes = 0;
+	bProbing = false;
+	bProbeReplyPending = false;
+	mProbeReplyRate = 0;
+	mProbeReplyTo = 0;
 	mMinThruput = 0;
+
+	bCoalesce = (0 != (mGame->GetFlags() & kNSpGameFlag_CoalesceSends));
+	mCoalesceBuffer = NULL;
+	mCoalesceLen = 0;
+	mCoalesceStart = 0;
 }
 
 //----------------------------------------------------------------------------------------
@@ -240,35 +299,13 @@ NMSInt32					messageLength;
 CEndpoint::~CEndpoint()
 {
 	if (mStreamSendInfo.sendQ)
-	{
-		if (false == mStreamSendInfo.sendQ->IsEmpty())
-		{
-			SendQItem	*item;
-			
-			while ((item = (SendQItem *) mStreamSendInfo.sendQ->RemoveFirst()) != NULL)
-			{
-				delete item;	
-			}
-		}
-		
 		delete mStreamSendInfo.sendQ;
-	}
 	
 	if (mDatagramSendInfo.sendQ)
-	{
-		if (false == mDatagramSendInfo.sendQ->IsEmpty())
-		{
-			SendQItem	*item;
-			
-			while ((item = (SendQItem *) mDatagramSendInfo.sendQ->RemoveFirst()) != NULL)
-			{
-				delete item;	
-			}
-		}
-
 		delete mDatagramSendInfo.sendQ;
-	}
 		
+	if (mCoalesceBuffer)
+		InterruptSafe_free(mCoalesceBuffer);
 
 	if (mEndpointCookie)
 		InterruptSafe_free(mEndpointCookie);
@@ -573,7 +610,7 @@ CEndpoint::FindPendingJoin(void *inCookie)
 NMUInt32
 CEndpoint::GetBacklog( void )
 {
-	return( mStreamSendInfo.backlog );
+	return( mStreamSendInfo.sendQ->Count() );
 }
 
 //----------------------------------------------------------------------------------------
@@ -627,6 +664,9 @@ EPCookie						*theCookie = NULL;
 	{
 		if (orderly)
 		{
+			//	Don't leave gathered messages behind on an orderly close
+			Flush();
+
 			DEBUG_PRINT("Calling ProtocolCloseEndpt in CEndpoint::Disconnect (2)");
 			status = ::ProtocolCloseEndpoint(mOpenPlayEndpoint, true);
 			mOpenPlayEndpoint = NULL;
@@ -692,15 +732,19 @@ NMBoolean	state;
 // CEndpoint::SendMessage
 //----------------------------------------------------------------------------------------
 //		We assume that all of the header information has already been set
-//		up by the time we get here
+//		up by the time we get here.  If inBody is non-NULL, the message body
+//		is taken from there rather than from the memory following the header,
+//		and the two go out together without being copied into one buffer.
 
 NMErr
 CEndpoint::SendMessage(NSpMessageHeader *inHeader, NMUInt8 *inBody, NSpFlags inFlags, NMBoolean swapIt)
 {
 	NMErr	 	result = kNMNoError;
 	NMUInt32		messageLength;
-	
-	UNUSED_PARAMETER(inBody);
+	NMSInt32		what;
+	NMIOVec		vectors[2];
+	NMUInt32	vectorCount;
+	NMUInt8		*body;
 
 	op_vassert_return((inHeader != NULL),"inHeader is NULL!",kNSpInvalidParameterErr);
 
@@ -718,12 +762,14 @@ CEndpoint::SendMessage(NSpMessageHeader *inHeader, NMUInt8 *inBody, NSpFlags inF
 	if (swapIt)
 	{
 		messageLength = inHeader->messageLen;
+		what = inHeader->what;
 		inHeader->version |= inFlags;
 		SwapBytesForSend(inHeader);	// This will byte-swap the header too, but we've already extracted what	
 	}								// we need from it above.
 	else
 	{
 		messageLength = SWAP4(inHeader->messageLen);	// Since this field was pre-swapped, must get right value.
+		what = SWAP4(inHeader->what);
 		inHeader->when = SWAP4(inHeader->when);			// Since this field is now not swapped, must swap it.
 	}	
 #else
@@ -736,9 +782,28 @@ CEndpoint::SendMessage(NSpMessageHeader *inHeader, NMUInt8 *inBody, NSpFlags inF
 
 	//	Get the message length...
 	messageLength = inHeader->messageLen;
+	what = inHeader->what;
 
 #endif								
 
+	//	Header and body go out as separate pieces, unless we weren't given a body
+	//	(in which case it had better follow the header)
+	vectors[0].data = inHeader;
+	if ((inBody != NULL) && (messageLength > sizeof(NSpMessageHeader)))
+	{
+		vectors[0].length = sizeof(NSpMessageHeader);
+		vectors[1].data = inBody;
+		vectors[1].length = messageLength - sizeof(NSpMessageHeader);
+		vectorCount = 2;
+		body = inBody;
+	}
+	else
+	{
+		vectors[0].length = messageLength;
+		vectorCount = 1;
+		body = NULL;
+	}
+
 	if (mStreamSendInfo.ep == NULL)
 		mStreamSendInfo.ep = mOpenPlayEndpoint;
 
@@ -750,9 +815,33 @@ CEndpoint::SendMessage(NSpMessageHeader *inHeader, NMUInt8 *inBody, NSpFlags inF
 	// That should probably be fixed at some point
 	if (inFlags & kNSpSendFlag_Registered)
 	{
+		//	On a coalescing link, small user messages are gathered and go out together
+		//	once the buffer fills or the window closes (see IdleLink).  System messages
+		//	drive joins and the like, which wait on the reply, so they never linger.
+		//	A backlog means the link is already saturated, so those take the normal path.
+		if (bCoalesce && !(inFlags & kNSpSendFlag_Blocking) && !(what & kNSpSystemMessagePrefix)
+			&& (messageLength <= kCoalesceBufferSize) && mStreamSendInfo.sendQ->IsEmpty())
+		{
+			result = CoalesceSend(vectors, vectorCount, messageLength);
+
+			if (result)
+				goto error;
+
+			return (kNMNoError);
+		}
+
+		//	Anything already gathered was sent before this, so it has to go first
+		if (mCoalesceLen > 0)
+		{
+			result = Flush();
+
+			if (result)
+				goto error;
+		}
+
 		//	If there is a backlog, postpone or return an error
 		//	We HAVE to postpone it if there is already a backlog, else things will be out of order!
-		if (mStreamSendInfo.backlog > 0)
+		if (false == mStreamSendInfo.sendQ->IsEmpty())
 		{
 			op_vpause("CEndpoint::SendMessage - There is a backlog... postponing send.");
 			
@@ -762,7 +851,7 @@ CEndpoint::SendMessage(NSpMessageHeader *inHeader, NMUInt8 *inBody, NSpFlags inF
 			}
 			else
 			{
-				result = PostponeSend(&mStreamSendInfo, inHeader);
+				result = PostponeSend(&mStreamSendInfo, inHeader, 0, body);
 			}
 		}
 		else
@@ -772,9 +861,9 @@ CEndpoint::SendMessage(NSpMessageHeader *inHeader, NMUInt8 *inBody, NSpFlags inF
 			mStreamSendInfo.sendInProgress = true;
 
 			if (inFlags & kNSpSendFlag_Blocking)
-				result = ::ProtocolSend(mOpenPlayEndpoint, (void *) inHeader, messageLength, kNMBlocking);
+				result = ::ProtocolSendv(mOpenPlayEndpoint, vectors, vectorCount, kNMBlocking);
 			else
-				result = ::ProtocolSend(mOpenPlayEndpoint, (void *) inHeader, messageLength, 0);
+				result = ::ProtocolSendv(mOpenPlayEndpoint, vectors, vectorCount, 0);
 			
 				
 			if ((kNMFlowErr == result) || ((result > 0) && (result < messageLength)))
@@ -786,7 +875,7 @@ CEndpoint::SendMessage(NSpMessageHeader *inHeader, NMUInt8 *inBody, NSpFlags inF
 				if (bytesSent)	//	if we sent any, we have to send it all
 				{
 					op_vpause("CEndpoint::SendMessage - Bytes sent.  Calling PostponeSend...");
-					result = PostponeSend(&mStreamSendInfo, inHeader, bytesSent); 		
+					result = PostponeSend(&mStreamSendInfo, inHeader, bytesSent, body); 		
 				}
 				else
 				{
@@ -795,7 +884,7 @@ CEndpoint::SendMessage(NSpMessageHeader *inHeader, NMUInt8 *inBody, NSpFlags inF
 					else
 					{
 						op_vpause("CEndpoint::SendMessage - No bytes were sent.  Calling PostponeSend...");
-						result = PostponeSend(&mStreamSendInfo, inHeader); 		
+						result = PostponeSend(&mStreamSendInfo, inHeader, 0, body); 		
 					}
 				}
 			}
@@ -818,7 +907,7 @@ CEndpoint::SendMessage(NSpMessageHeader *inHeader, NMUInt8 *inBody, NSpFlags inF
 		//	Do the send
 		mDatagramSendInfo.sendInProgress = true;
 		
-		result = ProtocolSendPacket(mOpenPlayEndpoint, (void *) inHeader, messageLength, 0);
+		result = ProtocolSendPacketv(mOpenPlayEndpoint, vectors, vectorCount, 0);
 
 		if (kNMFlowErr == result)
 		{
@@ -832,7 +921,7 @@ CEndpoint::SendMessage(NSpMessageHeader *inHeader, NMUInt8 *inBody, NSpFlags inF
 				op_vpause("Flow Error");
 #endif
 				//	We got a flow error.  Q up the message to send later
-				result = PostponeSend(&mDatagramSendInfo, inHeader);
+				result = PostponeSend(&mDatagramSendInfo, inHeader, 0, body);
 			}
 		}
 
@@ -863,10 +952,13 @@ error:
 //----------------------------------------------------------------------------------------
 
 NMErr
-CEndpoint::PostponeSend(SendInfo *inInfo, NSpMessageHeader *inData, NMUInt32 inBytesSent, NMBoolean inAddToTail)
+CEndpoint::PostponeSend(SendInfo *inInfo, NSpMessageHeader *inData, NMUInt32 inBytesSent, NMUInt8 *inBody)
 {
 
-	SendQItem	*qItem = NULL;
+	NMIOVec		vectors[2];
+	NMUInt32	vectorCount;
+	NMUInt32	messageLength;
+	NMUInt32	headerLeft;
 	NMErr	status = kNMNoError;
 	NMEndpointMode	endpointMode = kNMModeNone;
 	NMErr notifierErr = kNMNoError;
@@ -886,27 +978,41 @@ CEndpoint::PostponeSend(SendInfo *inInfo, NSpMessageHeader *inData, NMUInt32 inB
 		goto error;
 	}
 
-	if (inInfo->backlog > kMaxSendBacklog)
+	//	Every path to this point has byte-swapped the header on little-endian
+	//	platforms, so swap the length back before using it
+	messageLength = inData->messageLen;
+
+#if !big_endian
+	messageLength = SWAP4(messageLength);
+#endif
+
+	//	Queue whatever hasn't gone yet.  If the body was handed to us separately,
+	//	inData is just the header, so gather the two back together.
+	if (inBody == NULL)
 	{
-		op_vpause("CEndpoint::PostponeSend - Pipe is full.");
-		status = kNSpPipeFullErr;
-		goto error;
+		vectors[0].data = (NMUInt8 *) inData + inBytesSent;
+		vectors[0].length = messageLength - inBytesSent;
+		vectorCount = 1;
 	}
+	else
+	{
+		headerLeft = (inBytesSent < sizeof (NSpMessageHeader)) ? sizeof (NSpMessageHeader) - inBytesSent : 0;
 
-	op_vpause("CEndpoint::PostponeSend - About to create new SendQItem...");
-	
-	qItem = new SendQItem( (void *) inData, inBytesSent);
-	if (qItem == NULL){
-		status = kNSpMemAllocationErr;
-		goto error;
+		vectors[0].data = (NMUInt8 *) inData + inBytesSent;
+		vectors[0].length = headerLeft;
+		vectors[1].data = inBody + (inBytesSent + headerLeft - sizeof (NSpMessageHeader));
+		vectors[1].length = messageLength - inBytesSent - headerLeft;
+		vectorCount = 2;
 	}
 
-	if (inAddToTail)
-		inInfo->sendQ->AddLast(qItem);
-	else
-		inInfo->sendQ->AddFirst(qItem);
-		
-	inInfo->backlog++;
+	//	The rest of a half-sent stream message has to go out or the stream is
+	//	corrupt, so that one may grow the backlog past its bound instead of failing
+	if (false == AppendQ(inInfo, vectors, vectorCount, inBytesSent > 0))
+	{
+		op_vpause("CEndpoint::PostponeSend - Pipe is full.");
+		status = kNSpPipeFullErr;
+		goto error;
+	}
 
 	if (status)
 	{
@@ -924,87 +1030,233 @@ error:
 	return (kNMNoError);
 }
 
+//----------------------------------------------------------------------------------------
+// CEndpoint::AppendQ
+//----------------------------------------------------------------------------------------
+//	Adds to a backlog under its QLock.  A flow clear can arrive for either mode
+//	while we hold only one mode's notifier, so the lock, not the notifier, is
+//	what keeps RunQ out of the ring.  RunQ doesn't wait for the lock; if it
+//	gave up while we had it, we run the backlog on its behalf.
+
+NMBoolean
+CEndpoint::AppendQ(SendInfo *inInfo, const NMIOVec *inVectors, NMUInt32 inCount, NMBoolean inForce)
+{
+	NMBoolean	appended;
+
+	machine_wait_for_lock(&inInfo->QLock);
+	appended = inInfo->sendQ->Append(inVectors, inCount, inForce);
+	machine_clear_lock(&inInfo->QLock);
+
+	if (inInfo->runPending)
+		RunQ(inInfo);
+
+	return (appended);
+}
+
 //----------------------------------------------------------------------------------------
 // CEndpoint::RunQ
 //----------------------------------------------------------------------------------------
+//	Only tries for the QLock, since a send can call us straight back with a
+//	flow clear.  Whoever holds the lock sees runPending once they release it
+//	and goes around again, so no flow clear is lost.
 
 NMErr
 CEndpoint::RunQ(SendInfo *inInfo)
 {
 
-	NMErr	result = kNMNoError;
-	SendQItem	*theItem;
-	NMUInt32	leftToSend;
-	char		*dataPointer;
+	NMErr		result = kNMNoError;
+	NMIOVec		vectors[kMaxSendBatch];
+	NMUInt32	count;
+	NMUInt32	sent;
+	NMUInt32	index;
 	
-	
-	if (machine_acquire_lock(&inInfo->QLock))
+	inInfo->runPending = true;
+
+	while (machine_acquire_lock(&inInfo->QLock))
 	{
-		if (inInfo->sendQ->IsEmpty())
-		{
-			machine_clear_lock(&inInfo->QLock);
-			return (kNMNoError);
-		}
-	
-		do
+		inInfo->runPending = false;
+		result = kNMNoError;
+
+		while ((false == inInfo->sendQ->IsEmpty()) && (result >= kNMNoError))
 		{
-			theItem = (SendQItem *) inInfo->sendQ->RemoveFirst();
+			count = inInfo->sendQ->Peek(vectors, kMaxSendBatch);
 
-			if (NULL == theItem)
-				continue;
-				
-			leftToSend = theItem->BytesLeft();
-				
-			dataPointer = (char *)theItem->mData + theItem->mTotalSent;
-			
 			if (inInfo == &mStreamSendInfo)
 			{
-				result = ::ProtocolSend(mOpenPlayEndpoint, (void *) dataPointer, leftToSend, 0);
+				//	The stream doesn't care where one message ends, so send the
+				//	front of the backlog in one go and retire whatever went
+				for (index = 0, sent = 0; index < count; index++)
+					sent += vectors[index].length;
+
+				result = ::ProtocolSendv(mOpenPlayEndpoint, vectors, count, 0);
 			
 				if (result > 0)
 				{
-					if (result < leftToSend)
-					{
-						theItem->AdvanceBuffPtr(result);
-						inInfo->sendQ->AddFirst(theItem);	// put it back on the front
+					inInfo->sendQ->Consume(result);
+
+					if ((NMUInt32) result < sent)
 						result = kNMFlowErr;
-					}
-					else
-					{
-						inInfo->backlog--;
-						delete theItem;
-					}
 				}
-				else
+				else if (0 == result)
 				{
-					inInfo->sendQ->AddFirst(theItem);	// put it back on the front
+					result = kNMFlowErr;
 				}
 			}
 			else
 			{
-				result = ::ProtocolSendPacket(mOpenPlayEndpoint, (void *) dataPointer, leftToSend, 0);
+				//	Send as many of the queued datagrams as we can in one go
+				result = ::ProtocolSendPackets(mOpenPlayEndpoint, vectors, count, &sent, 0);
 
-				if (kNMNoError == result)
-				{
-					inInfo->backlog--;
-					delete theItem;
-				}
-				else
-				{
-					inInfo->sendQ->AddFirst(theItem);	// put it back on the front
-				}
+				for (index = 0; index < sent; index++)
+					inInfo->sendQ->Consume(vectors[index].length);
+
+				if ((sent < count) && (result >= kNMNoError))
+					result = kNMFlowErr;
 			}
-		
-		
-		} while ((false == inInfo->sendQ->IsEmpty()) && (result >= kNMNoError));
+		}
 			
 		machine_clear_lock(&inInfo->QLock);
+
+		if (false == inInfo->runPending)
+			break;
 	}
 	
 	if (result > 0)
 		result = kNMNoError;
 
-	return (kNMNoError);
+	return (result);
+}
+
+//----------------------------------------------------------------------------------------
+// CEndpoint::CoalesceSend
+//----------------------------------------------------------------------------------------
+//	Copies an (already byte-swapped) registered message onto the end of the
+//	coalescing buffer.  The bytes on the wire are exactly what separate sends
+//	would have produced; only the number of writes changes.
+
+NMErr
+CEndpoint::CoalesceSend(NMIOVec *inVectors, NMUInt32 inCount, NMUInt32 inLength)
+{
+	NMErr		status;
+	NMUInt32	index;
+
+	status = ProtocolEnterNotifier(mOpenPlayEndpoint, kNMStreamMode);
+	if (status)
+		return (status);
+
+	if (mCoalesceLen + inLength > kCoalesceBufferSize)
+		status = FlushCoalesced();
+
+	if ((kNMNoError == status) && (NULL == mCoalesceBuffer))
+	{
+		mCoalesceBuffer = (NMUInt8 *) InterruptSafe_alloc(kCoalesceBufferSize);
+
+		if (NULL == mCoalesceBuffer)
+			status = kNSpMemAllocationErr;
+	}
+
+	if (kNMNoError == status)
+	{
+		if (0 == mCoalesceLen)
+			mCoalesceStart = ::GetTimestampMilliseconds() & 0xFFFFFFFF;
+
+		for (index = 0; index < inCount; index++)
+		{
+			machine_move_data(inVectors[index].data, mCoalesceBuffer + mCoalesceLen, inVectors[index].length);
+			mCoalesceLen += inVectors[index].length;
+		}
+
+		//	Not even a bare header would fit behind this, so don't wait
+		if (kCoalesceBufferSize - mCoalesceLen < sizeof (NSpMessageHeader))
+			status = FlushCoalesced();
+	}
+
+	ProtocolLeaveNotifier(mOpenPlayEndpoint, kNMStreamMode);
+
+	return (status);
+}
+
+//----------------------------------------------------------------------------------------
+// CEndpoint::FlushCoalesced
+//----------------------------------------------------------------------------------------
+//	Sends whatever is in the coalescing buffer as one write.  The caller has
+//	entered the notifier.  These messages were accepted when they were sent, so
+//	anything the endpoint won't take now goes to the backlog even if that pushes
+//	it past its bound (by at most kCoalesceBufferSize).
+
+NMErr
+CEndpoint::FlushCoalesced(void)
+{
+	NMErr		result = kNMNoError;
+	NMIOVec		vector;
+	NMUInt32	bytesSent = 0;
+
+	if (0 == mCoalesceLen)
+		return (kNMNoError);
+
+	if (mStreamSendInfo.ep == NULL)
+		mStreamSendInfo.ep = mOpenPlayEndpoint;
+
+	//	Behind a backlog, the gathered bytes just join the end of it
+	if (mStreamSendInfo.sendQ->IsEmpty())
+	{
+		mStreamSendInfo.sendInProgress = true;
+
+		result = ::ProtocolSend(mOpenPlayEndpoint, mCoalesceBuffer, mCoalesceLen, 0);
+
+		if (result > 0)
+			bytesSent = result;
+		
+		if ((result >= 0) || (kNMFlowErr == result))
+			result = kNMNoError;
+	}
+
+	if ((kNMNoError == result) && (bytesSent < mCoalesceLen))
+	{
+		vector.data = mCoalesceBuffer + bytesSent;
+		vector.length = mCoalesceLen - bytesSent;
+
+		if (false == AppendQ(&mStreamSendInfo, &vector, 1, true))
+			result = kNSpMemAllocationErr;
+	}
+
+	mCoalesceLen = 0;
+
+	if (mStreamSendInfo.sendInProgress)
+	{
+		mStreamSendInfo.sendInProgress = false;
+
+		if (mStreamSendInfo.goData)
+			RunQ(&mStreamSendInfo);
+	}
+
+	if (result)
+		DEBUG_PRINT("ERROR in CEndpoint::FlushCoalesced, result = %ld", result);
+
+	return (result);
+}
+
+//----------------------------------------------------------------------------------------
+// CEndpoint::Flush
+//----------------------------------------------------------------------------------------
+
+NMErr
+CEndpoint::Flush(void)
+{
+	NMErr	status;
+
+	if ((0 == mCoalesceLen) || (kOPInvalidEndpointRef == mOpenPlayEndpoint))
+		return (kNMNoError);
+
+	status = ProtocolEnterNotifier(mOpenPlayEndpoint, kNMStreamMode);
+	if (status)
+		return (status);
+
+	status = FlushCoalesced();
+
+	ProtocolLeaveNotifier(mOpenPlayEndpoint, kNMStreamMode);
+
+	return (status);
 }
 
 //----------------------------------------------------------------------------------------
@@ -1023,7 +1275,10 @@ NMErr	status = kNMNoError;
 		else
 			RunQ(&mStreamSendInfo);
 	}
-	else 
+
+	//	The flow clear doesn't say which mode cleared, and where both modes
+	//	share one endpoint it may be the datagram backlog that's been waiting
+	if ((inEP != mOpenPlayEndpoint) || (mDatagramSendInfo.ep == inEP))
 	{
 		if (mDatagramSendInfo.sendInProgress)
 			mDatagramSendInfo.goData = true;
@@ -1044,6 +1299,348 @@ void CEndpoint::Idle(void)
 		ProtocolIdle(mOpenPlayEndpoint);
 }
 
+//	Rate in bytes per second for a byte count over a span of milliseconds, without
+//	overflowing 32 bits along the way
+static inline NMUInt32
+bytes_per_second(NMUInt32 inBytes, NMUInt32 inMilliseconds)
+{
+	return ((inBytes / inMilliseconds) * 1000 + ((inBytes % inMilliseconds) * 1000) / inMilliseconds);
+}
+
+//----------------------------------------------------------------------------------------
+// CEndpoint::IdleLink
+//----------------------------------------------------------------------------------------
+//	Link upkeep, called from the game's idle path: a round-trip ping every
+//	kRTTPingInterval and a throughput probe burst every kThruputProbeInterval.
+
+void
+CEndpoint::IdleLink(NSpPlayerID inTo)
+{
+	NMUInt32		now;
+
+	if (!bConnected || bDisposing || (kOPInvalidEndpointRef == mOpenPlayEndpoint))
+		return;
+
+	//	Stamps only travel as 32 bits, so keep the clock we use for them in 32 bits
+	now = ::GetTimestampMilliseconds() & 0xFFFFFFFF;
+
+	//	Gathered messages have waited long enough for company
+	if ((mCoalesceLen > 0) && ((now - mCoalesceStart) >= kCoalesceWindow))
+		Flush();
+
+	//	Don't add to a link that is already backed up; we'll try again next idle
+	if (false == mDatagramSendInfo.sendQ->IsEmpty())
+		return;
+
+	if (bProbeReplyPending)
+		SendThruputReply();
+
+	if ((0 == mNextPingTime) || ((NMSInt32) (now - mNextPingTime) >= 0))
+	{
+		mNextPingTime = now + kRTTPingInterval;
+		SendRTTPing(inTo, now);
+	}
+
+	//	Hold off probing until a round trip has completed, so we know the peer
+	//	has finished joining and will credit the probes to us
+	if ((0 == kThruputProbeInterval) || !bHaveRTT)
+		return;
+
+	if ((0 == mNextProbeTime) || ((NMSInt32) (now - mNextProbeTime) >= 0))
+	{
+		mNextProbeTime = now + kThruputProbeInterval;
+		SendThruputProbe(inTo);
+	}
+}
+
+//----------------------------------------------------------------------------------------
+// CEndpoint::SendRTTPing
+//----------------------------------------------------------------------------------------
+//	There is no separate reply message: each ping echoes the last ping we got from
+//	the peer (and how long we sat on it), so with both ends pinging, a sample costs
+//	one small datagram per interval in each direction.  The ping also reports how
+//	many bytes we've received from the peer, which drives its throughput estimate.
+
+void
+CEndpoint::SendRTTPing(NSpPlayerID inTo, NMUInt32 inNow)
+{
+	TRTTPingMessage	ping;
+
+	NSpClearMessageHeader(&ping.header);
+	ping.header.version = kVersion10Message;
+	ping.header.what = kRTTPing;
+	ping.header.from = mGame->NSpPlayer_GetMyID();
+	ping.header.to = inTo;
+	ping.header.messageLen = sizeof (TRTTPingMessage);
+
+	ping.flags = 0;
+	ping.stamp = inNow;
+	ping.echoStamp = 0;
+	ping.echoDelay = 0;
+	ping.bytesReceived = mBytesReceived & 0xFFFFFFFF;
+
+	if (bEchoPending)
+	{
+		bEchoPending = false;
+
+		ping.flags |= kRTTHasEcho;
+		ping.echoStamp = mEchoStamp;
+		ping.echoDelay = (inNow - mEchoReceived) & 0xFFFFFFFF;
+	}
+
+	(void) SendMessage(&ping.header, NULL, kNSpSendFlag_Normal);
+}
+
+//----------------------------------------------------------------------------------------
+// CEndpoint::SendThruputProbe
+//----------------------------------------------------------------------------------------
+//	Sends kThruputProbeCount probes back to back.  The far end times how quickly
+//	the burst arrives and replies with the rate it saw.
+
+void
+CEndpoint::SendThruputProbe(NSpPlayerID inTo)
+{
+	NMUInt8			buffer[kThruputProbeSize];
+	TThruputMessage	*probe = (TThruputMessage *) buffer;
+	NMUInt32		size, i;
+
+	//	Keep each probe within a standard receive buffer, so it's read in one piece
+	size = (gStandardMessageSize < kThruputProbeSize) ? gStandardMessageSize : (NMUInt32) kThruputProbeSize;
+
+	machine_mem_zero(buffer, size);
+
+	for (i = 0; i < kThruputProbeCount; i++)
+	{
+		//	SendMessage swaps the header in place, so fill it in every time
+		NSpClearMessageHeader(&probe->header);
+		probe->header.version = kVersion10Message;
+		probe->header.what = kThruputPing;
+		probe->header.from = mGame->NSpPlayer_GetMyID();
+		probe->header.to = inTo;
+		probe->header.messageLen = size;
+		probe->count = i;
+
+		if (kNMNoError != SendMessage(&probe->header, NULL, kNSpSendFlag_Normal))
+			break;
+	}
+}
+
+//----------------------------------------------------------------------------------------
+// CEndpoint::SendThruputReply
+//----------------------------------------------------------------------------------------
+//	Tells the peer the rate its last burst arrived at.  The burst is timed on the
+//	notifier, but the reply waits for IdleLink: sending from the notifier can
+//	postpone the send, and that enters the notifier again.
+
+void
+CEndpoint::SendThruputReply(void)
+{
+	TThruputMessage	reply;
+
+	bProbeReplyPending = false;
+
+	NSpClearMessageHeader(&reply.header);
+	reply.header.version = kVersion10Message;
+	reply.header.what = kThruputPingReply;
+	reply.header.from = mGame->NSpPlayer_GetMyID();
+	reply.header.to = mProbeReplyTo;
+	reply.header.messageLen = sizeof (TThruputMessage);
+	reply.count = mProbeReplyRate;
+
+	(void) SendMessage(&reply.header, NULL, kNSpSendFlag_Normal);
+}
+
+//----------------------------------------------------------------------------------------
+// CEndpoint::HandleLinkMessage
+//----------------------------------------------------------------------------------------
+//	Called from the receive paths before a message is handed to the game.  It
+//	counts the bytes received from the sender, and consumes pings and probes here,
+//	on the notifier, so their timing doesn't include queueing time.  Datagrams can
+//	arrive on an endpoint other than the one we talk to the sender on (the host's
+//	listener, for instance), so the game picks the endpoint to credit.
+
+NMBoolean
+CEndpoint::HandleLinkMessage(ERObject *inERObject)
+{
+	NSpMessageHeader	*header = inERObject->PeekNetMessage();
+	NMUInt32			received = inERObject->GetTimeReceived() & 0xFFFFFFFF;
+	CEndpoint			*endpoint;
+
+	endpoint = mGame->GetPeerEndpoint(header->from);
+
+	if (NULL != endpoint)
+		endpoint->mBytesReceived += header->messageLen;
+
+	switch (header->what)
+	{
+		case kRTTPing:
+			if ((NULL != endpoint) && (header->messageLen >= sizeof (TRTTPingMessage)))
+			{
+#if !big_endian
+				SwapRTTPing(header);
+#endif
+				endpoint->HandleRTTPing((TRTTPingMessage *) header, received);
+			}
+			break;
+
+		case kThruputPing:
+		case kThruputPingReply:
+			if ((NULL != endpoint) && (header->messageLen >= sizeof (TThruputMessage)))
+			{
+#if !big_endian
+				SwapThruput(header);
+#endif
+				endpoint->HandleThruputMessage((TThruputMessage *) header, received);
+			}
+			break;
+
+		default:
+			return (false);
+	}
+
+	mGame->ReleaseERObject(inERObject);
+
+	return (true);
+}
+
+//----------------------------------------------------------------------------------------
+// CEndpoint::HandleRTTPing
+//----------------------------------------------------------------------------------------
+
+void
+CEndpoint::HandleRTTPing(TRTTPingMessage *inPing, NMUInt32 inTimeReceived)
+{
+	NMUInt32	elapsed, bytes;
+
+	//	Our own stamp came back; take off however long the peer held it
+	if (inPing->flags & kRTTHasEcho)
+	{
+		elapsed = (inTimeReceived - inPing->echoStamp) & 0xFFFFFFFF;
+
+		if (elapsed >= inPing->echoDelay)
+			UpdateRTT(elapsed - inPing->echoDelay);
+	}
+
+	//	Hold on to the peer's stamp; it goes back out with our next ping
+	mEchoStamp = inPing->stamp;
+	mEchoReceived = inTimeReceived;
+	bEchoPending = true;
+
+	//	Bytes the peer acknowledges receiving over its ping interval are the rate
+	//	the link is actually delivering.  Pings can be reordered; skip stale ones.
+	elapsed = (inPing->stamp - mAckStamp) & 0xFFFFFFFF;
+
+	if (bHaveAck && ((0 == elapsed) || (elapsed >= 0x80000000)))
+		return;
+
+	if (bHaveAck)
+	{
+		bytes = (inPing->bytesReceived - mAckBytes) & 0xFFFFFFFF;
+		UpdateThruput(&mAckThruput, bytes_per_second(bytes, elapsed));
+	}
+
+	mAckStamp = inPing->stamp;
+	mAckBytes = inPing->bytesReceived;
+	bHaveAck = true;
+}
+
+//----------------------------------------------------------------------------------------
+// CEndpoint::HandleThruputMessage
+//----------------------------------------------------------------------------------------
+
+void
+CEndpoint::HandleThruputMessage(TThruputMessage *inMessage, NMUInt32 inTimeReceived)
+{
+	NMUInt32		elapsed;
+
+	//	The peer's verdict on our last burst
+	if (kThruputPingReply == inMessage->header.what)
+	{
+		UpdateThruput(&mProbeThruput, inMessage->count);
+		return;
+	}
+
+	//	Time the peer's burst from its first probe to its last.  A lost first probe
+	//	skips the burst; a lost last one just means no reply this time.
+	if (0 == inMessage->count)
+	{
+		mProbeStart = inTimeReceived;
+		mProbeBytes = 0;
+		bProbing = true;
+		return;
+	}
+
+	if (!bProbing)
+		return;
+
+	mProbeBytes += inMessage->header.messageLen;
+
+	if (inMessage->count < kThruputProbeCount - 1)
+		return;
+
+	bProbing = false;
+
+	//	The clock only has millisecond resolution; a burst that beat it is at least this fast
+	elapsed = (inTimeReceived - mProbeStart) & 0xFFFFFFFF;
+
+	if (0 == elapsed)
+		elapsed = 1;
+
+	//	Set the flag last; IdleLink on the app thread picks the reply up from here
+	mProbeReplyRate = bytes_per_second(mProbeBytes, elapsed);
+	mProbeReplyTo = inMessage->header.from;
+	bProbeReplyPending = true;
+}
+
+//----------------------------------------------------------------------------------------
+// CEndpoint::UpdateThruput
+//----------------------------------------------------------------------------------------
+
+void
+CEndpoint::UpdateThruput(NMUInt32 *ioEstimate, NMUInt32 inSample)
+{
+	NMSInt32	delta;
+
+	if (0 == *ioEstimate)
+	{
+		*ioEstimate = inSample;
+		return;
+	}
+
+	//	Smooth with a gain of 1/4
+	delta = (NMSInt32) inSample - (NMSInt32) *ioEstimate;
+	*ioEstimate = (NMUInt32) ((NMSInt32) *ioEstimate + delta / 4);
+}
+
+//----------------------------------------------------------------------------------------
+// CEndpoint::UpdateRTT
+//----------------------------------------------------------------------------------------
+//	Folds a sample into the smoothed round trip and its variation, with the usual
+//	1/8 and 1/4 gains (RFC 6298).  Both are kept scaled so the gains are shifts.
+
+void
+CEndpoint::UpdateRTT(NMUInt32 inSample)
+{
+	NMSInt32	delta;
+
+	if (!bHaveRTT)
+	{
+		mRTT = inSample << 3;
+		mRTTVar = inSample << 1;
+		bHaveRTT = true;
+		return;
+	}
+
+	delta = (NMSInt32) inSample - (NMSInt32) (mRTT >> 3);
+	mRTT = (NMUInt32) ((NMSInt32) mRTT + delta);
+
+	if (delta < 0)
+		delta = -delta;
+
+	delta -= (NMSInt32) (mRTTVar >> 2);
+	mRTTVar = (NMUInt32) ((NMSInt32) mRTTVar + delta);
+}
+
 //----------------------------------------------------------------------------------------
 // CEndpoint::Notifier
 //----------------------------------------------------------------------------------------
@@ -1271,7 +1868,10 @@ CEndpoint::DoReceiveStream(PEndpointRef inEndpoint, EPCookie *inCookie)
 						// we are done...
 						
 						if (theHeader->messageLen == sizeof(NSpMessageHeader))
-							mGame->HandleNewEvent(mCurrentMessage, this, inCookie);
+						{
+							if (!HandleLinkMessage(mCurrentMessage))
+								mGame->HandleNewEvent(mCurrentMessage, this, inCookie);
+						}
 						else
 						{
 							// There is more to read.  Setup for reading the body of
@@ -1324,7 +1924,9 @@ CEndpoint::DoReceiveStream(PEndpointRef inEndpoint, EPCookie *inCookie)
 				else
 				{
 					bReadingBody = false;
-					mGame->HandleNewEvent(mCurrentMessage, this, inCookie);
+
+					if (!HandleLinkMessage(mCurrentMessage))
+						mGame->HandleNewEvent(mCurrentMessage, this, inCookie);
 				}
 	
 			}
@@ -1485,7 +2087,8 @@ CEndpoint::DoReceiveDatagram(PEndpointRef inEndpoint, EPCookie *inCookie)
 									
 				if (status == kNMNoError)
 				{
-					mGame->HandleNewEvent(theERObject, this, inCookie);
+					if (!HandleLinkMessage(theERObject))
+						mGame->HandleNewEvent(theERObject, this, inCookie);
 				}
 				else
 				{
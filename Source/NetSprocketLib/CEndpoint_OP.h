@@ -66,6 +66,9 @@
 
 	class NSpGame;
 	class ERObject;
+	class NSpSendRing;
+	struct TRTTPingMessage;
+	struct TThruputMessage;
 
 	typedef enum
 	{
@@ -102,11 +105,11 @@
 	typedef struct
 	{
 		PEndpointRef	ep;
-		NMUInt32		backlog;
 		NMBoolean		sendInProgress;
 		NMBoolean		goData;
-		NMList			*sendQ;
-		machine_lock	QLock;
+		volatile NMBoolean	runPending;
+		NSpSendRing		*sendQ;
+		machine_lock	QLock;		// guards sendQ; RunQ only tries for it
 	} SendInfo;
 
 	class CEndpoint
@@ -118,7 +121,13 @@
 		enum { kRTTResponse = 0xF0F0F0F1};
 		enum { kThruputQuery = 0xF0F0F000};
 		enum { kThruputResponse = 0xF0F0F001};
-		enum { kMaxSendBacklog = 5};
+		enum { kMaxSendBatch = 8};	//	queued datagrams handed to ProtocolSendPackets at once
+		enum { kRTTPingInterval = 1000};	//	milliseconds between round-trip pings
+		enum { kThruputProbeInterval = 10000};	//	milliseconds between probe bursts; 0 relies on acknowledged bytes alone
+		enum { kThruputProbeCount = 8};
+		enum { kThruputProbeSize = 1024};
+		enum { kCoalesceBufferSize = 1400};	//	small registered messages gathered into one stream write
+		enum { kCoalesceWindow = 5};		//	milliseconds a gathered message may wait for company
 		
 		CEndpoint(NSpGame *inGame);
 		CEndpoint(NSpGame *inGame, EPCookie *inUnreliableCookie, EPCookie *inCookie);
@@ -132,18 +141,17 @@
 		virtual	NMBoolean	Host(NMBoolean inAdvertise);
 				void		Advertise(NMBoolean inAdvertise);
 
-				NMUInt32	GetRTT(void *inCookie = NULL);
 				NMSInt32	GetNormalizedTimeDifferential();
 
-				NMUInt32	GetThruput(void *inCookie = NULL);
-
-				void		HandleRTTReply(RTTStruct *inMessage);
-				void		HandleRTTQuery(PEndpointRef inEndpoint, RTTStruct *inMessage);
-
-				void		HandleThruputReply();
-				void		HandleThruputQuery(PEndpointRef inEndpoint, ThruputStruct *inMessage);
+				void		IdleLink(NSpPlayerID inTo);
+				void		HandleRTTPing(TRTTPingMessage *inPing, NMUInt32 inTimeReceived);
+				void		HandleThruputMessage(TThruputMessage *inMessage, NMUInt32 inTimeReceived);
+		inline	NMUInt32	GetRTT(void) {return (mRTT + 4) >> 3;}
+		inline	NMUInt32	GetRTTJitter(void) {return (mRTTVar + 2) >> 2;}
+		inline	NMUInt32	GetThruput(void) {return (mAckThruput > mProbeThruput) ? mAckThruput : mProbeThruput;}
 				
 				NMUInt32 GetBacklog( void );
+				NMErr		Flush(void);
 				NMBoolean	FindPendingJoin(void *inCookie);
 				CEndpoint	*Clone(void *inCookie);
 				void		Veto(void *inCookie, NSpMessageHeader *inMessage);
@@ -181,13 +189,22 @@
 				NMErr	HandleUnbindComplete(EPCookie *inCookie);
 				NMErr	HandleConnectComplete(EPCookie *inCookie);		
 				NMErr	HandleGoData(PEndpointRef inEP);
-				NMErr	PostponeSend(SendInfo *inInfo, NSpMessageHeader *inData, NMUInt32 inBytesSent = 0, NMBoolean inAddToTail = true);
+				NMErr	PostponeSend(SendInfo *inInfo, NSpMessageHeader *inData, NMUInt32 inBytesSent = 0, NMUInt8 *inBody = NULL);
+				NMBoolean	AppendQ(SendInfo *inInfo, const NMIOVec *inVectors, NMUInt32 inCount, NMBoolean inForce);
 				NMErr	RunQ(SendInfo *inInfo);
+				NMErr	CoalesceSend(NMIOVec *inVectors, NMUInt32 inCount, NMUInt32 inLength);
+				NMErr	FlushCoalesced(void);
 
 		
 				NMErr	DoReceiveStream(PEndpointRef inEndpoint, EPCookie *inCookie);
 				NMErr	DoReceiveDatagram(PEndpointRef inEndpoint, EPCookie *inCookie);
 				ERObject	*ExchangeForBiggerER(ERObject *inERObject);
+				NMBoolean	HandleLinkMessage(ERObject *inERObject);
+				void		SendRTTPing(NSpPlayerID inTo, NMUInt32 inNow);
+				void		SendThruputProbe(NSpPlayerID inTo);
+				void		SendThruputReply(void);
+				void		UpdateRTT(NMUInt32 inSample);
+				void		UpdateThruput(NMUInt32 *ioEstimate, NMUInt32 inSample);
 		virtual CEndpoint	*MakeCopy(EPCookie *inReliableCookie) = 0;
 		
 				
@@ -222,12 +239,36 @@
 		NMBoolean			bClone;
 		NMBoolean			bInitiatedDisconnect;
 
-		NMUInt32			mRTT;
-		NMUInt32			mThruput;
+		NMUInt32			mRTT;			//	smoothed round trip, milliseconds * 8
+		NMUInt32			mRTTVar;		//	round trip variation (jitter), milliseconds * 4
+		NMBoolean			bHaveRTT;
+		NMUInt32			mNextPingTime;
+		NMBoolean			bEchoPending;
+		NMUInt32			mEchoStamp;
+		NMUInt32			mEchoReceived;
+
+		NMUInt32			mBytesReceived;	//	from the peer, reported back to it in our pings
+		NMUInt32			mAckBytes;		//	the peer's last report of bytes received from us
+		NMUInt32			mAckStamp;
+		NMBoolean			bHaveAck;
+		NMUInt32			mAckThruput;	//	bytes per second, as acknowledged by the peer
+		NMUInt32			mProbeThruput;	//	bytes per second, as measured by probe bursts
+		NMUInt32			mNextProbeTime;
+		NMUInt32			mProbeStart;
+		NMUInt32			mProbeBytes;
+		NMBoolean			bProbing;
+		NMBoolean			bProbeReplyPending;	//	our verdict on the peer's burst, sent from IdleLink
+		NMUInt32			mProbeReplyRate;
+		NSpPlayerID			mProbeReplyTo;
 		
 		NMUInt32			mMaxRTT;
 		NMUInt32			mMinThruput;
 
+		NMBoolean			bCoalesce;		//	kNSpGameFlag_CoalesceSends was given for the game
+		NMUInt8				*mCoalesceBuffer;
+		NMUInt32			mCoalesceLen;
+		NMUInt32			mCoalesceStart;
+
 		NMUInt32			mReceiversStamp;
 		NMUInt32			mLastSentMessageTimeStamp;
 		//UnsignedWide		mReceiveWait; // It is not used...
@@ -252,6 +293,7 @@
 
 
 	extern NMUInt32	gEndpointConnectTimeout;
+	extern NMUInt32	gSendBacklogSize;
 	extern NMUInt32	gTimeout;
 
 
@@ -58,7 +58,7 @@ NSpGame::NSpGame(
 	mAsyncMessageHandler = NULL;
 	mAsyncMessageContext = NULL;
 	mFreeQLen = mMessageQLen = mCookieQLen = 0;
-	mPendingMessages = NULL;
+	mBorrowedList.Init();
 
 	//	Initialize the player count
 	mGameInfo.maxPlayers = (inMaxPlayers == 0) ? 0xFFFFFFFF : inMaxPlayers;
@@ -89,11 +89,11 @@ NSpGame::NSpGame(
 	mTimeStampDifferential = 0;
 
 	//	Allocate our queues
-	mEventQ = new NMLIFO();
+	mEventQ = new NMFIFO();
 	op_assert(mEventQ);
 	mEventQ->Init();
 
-	mSystemEventQ = new NMLIFO();
+	mSystemEventQ = new NMFIFO();
 	op_assert(mSystemEventQ);
 	mSystemEventQ->Init();
 
@@ -105,6 +105,10 @@ NSpGame::NSpGame(
 	mFreeQ = new NMLIFO();
 	op_assert(mFreeQ);
 	mFreeQ->Init();
+
+	//	Anything bigger than a standard message comes from the size-class pool
+	mMessagePool = new NSpMessagePool(gStandardMessageSize + 1, gMessagePoolCeiling);
+	op_assert(mMessagePool);
 	
 	ERObject	*item;
 	NSpMessageHeader *message;
@@ -144,6 +148,13 @@ NSpGame::NSpGame(
 	mGroupListIter = new NSp_InterruptSafeListIterator(*mGroupList);
 	op_assert(mGroupListIter);
 
+	//	Index both lists by id, so routing doesn't walk them
+	mPlayerIndex = new NSpIDTable();
+	op_assert(mPlayerIndex);
+
+	mGroupIndex = new NSpIDTable();
+	op_assert(mGroupIndex);
+
 	mGameState = kRunning;
 
 	mGameInfo.maxPlayers = 0;
@@ -161,6 +172,11 @@ NSpGame::NSpGame(
 
 NSpGame::~NSpGame()
 {
+	//	Messages still on loan go back now; the app can't return them to a game
+	//	that no longer exists
+	while (false == mBorrowedList.IsEmpty())
+		ReleaseERObject((ERObject *) mBorrowedList.RemoveFirst());
+
 	if (mEventQ)
 		delete mEventQ;
 
@@ -170,6 +186,9 @@ NSpGame::~NSpGame()
 	if (mFreeQ)
 		delete mFreeQ;
 
+	if (mMessagePool)
+		delete mMessagePool;
+
 	if (mPlayerListIter)
 		delete mPlayerListIter;
 
@@ -181,6 +200,12 @@ NSpGame::~NSpGame()
 
 	if (mGroupList)
 		delete mGroupList;
+
+	if (mPlayerIndex)
+		delete mPlayerIndex;
+
+	if (mGroupIndex)
+		delete mGroupIndex;
 }
 
 #if defined(__MWERKS__)	
@@ -197,6 +222,7 @@ NSpGame::GetFreeERObject(NMUInt32 inSize)
 	ERObject 			*item = NULL;
 	NSpMessageHeader	*message = NULL;
 	NMSInt32			i = 0;
+	NMUInt32			capacity;
 	NMErr 				status = kNMNoError;
 
 	if (inSize <= gStandardMessageSize)
@@ -233,13 +259,13 @@ NSpGame::GetFreeERObject(NMUInt32 inSize)
 			goto error;
 		}
 
-		message = (NSpMessageHeader *) InterruptSafe_alloc(inSize);
+		message = mMessagePool->Alloc(inSize, &capacity);
 		if (message == NULL){
 			status = kNSpMemAllocationErr;
 			goto error;
 		}
 
-		item->SetNetMessage(message, inSize);
+		item->SetNetMessage(message, capacity);
 	}
 
 	error:
@@ -316,12 +342,33 @@ NSpMessageHeader	*message;
 	else
 	{
 		message = inObject->RemoveNetMessage();
-		InterruptSafe_free(message);
+		mMessagePool->Free(message);
 		mCookieQ->Enqueue(inObject);
 		mCookieQLen++;
 	}
 }
 
+//----------------------------------------------------------------------------------------
+// NSpGame::FindBorrowedLink
+// Returns the link that points at the ERObject lending inMessage, so the caller can
+// unlink it, or NULL if the message isn't on loan.
+//----------------------------------------------------------------------------------------
+
+NMLink **
+NSpGame::FindBorrowedLink(NSpMessageHeader *inMessage)
+{
+NMLink	**link;
+
+	//	Only the app thread touches this list, and apps hold few messages at once
+	for (link = &mBorrowedList.fHead; *link != NULL; link = &(*link)->fNext)
+	{
+		if (((ERObject *) *link)->PeekNetMessage() == inMessage)
+			return (link);
+	}
+
+	return (NULL);
+}
+
 //----------------------------------------------------------------------------------------
 // NSpGame::GetNewDataBuffer
 //----------------------------------------------------------------------------------------
@@ -353,10 +400,10 @@ NSpGame::FreeNetMessage(NSpMessageHeader *inMessage)
 {
 ERObject	*theObject;
 
-	//	If it's a big message, we alloced it, so just free it
+	//	If it's a big message, it came from the pool, so give it back
 	if (inMessage->messageLen > gStandardMessageSize)
 	{
-		InterruptSafe_free(inMessage);
+		mMessagePool->Free(inMessage);
 		return;
 	}
 
@@ -583,6 +630,11 @@ NSpGame::AddPlayer(NSpPlayerInfo *inInfo, CEndpoint *inEndpoint)
 	machine_move_data(inInfo, theListItem->info, infoSize);
 	theListItem->id = inInfo->id;
 
+	if (!mPlayerIndex->Add(theListItem->id, theListItem)){
+		status = kNSpMemAllocationErr;
+		goto error;
+	}
+
 	mPlayerList->Append(theListItem);
 
 	mGameInfo.currentPlayers++;
@@ -611,42 +663,23 @@ error:
 PlayerListItem *
 NSpGame::GetPlayerListItem(NSpPlayerID inPlayerID)
 {
-	NSp_InterruptSafeListIterator	iter(*mPlayerList);
-	NSp_InterruptSafeListMember	*theItem;
-	PlayerListItem				*thePlayer = NULL;
-	NMBoolean					found = false;
-	NMErr						status = kNMNoError;
-
 	if (inPlayerID < 1)
 		return (NULL);
 
-	//Try_
-	{
-		//	First find the player in the list
-		while (!found && iter.Next(&theItem) )
-		{
-			thePlayer = (PlayerListItem *)theItem;
-
-			if (thePlayer->id == inPlayerID)
-			{
-				found = true;
-			}
-		}
+	return ((PlayerListItem *) mPlayerIndex->Find(inPlayerID));
+}
 
-		if (!found)
-			return 	(NULL);
-		else
-			return (thePlayer);
-	}
-	//Catch_(code)
-	error:
-	if (status)
-	{
-		NMErr code = status;
-		(void) code;
+//----------------------------------------------------------------------------------------
+// NSpGame::GetGroupListItem
+//----------------------------------------------------------------------------------------
 
+GroupListItem *
+NSpGame::GetGroupListItem(NSpGroupID inGroupID)
+{
+	if (inGroupID > -1)
 		return (NULL);
-	}
+
+	return ((GroupListItem *) mGroupIndex->Find(inGroupID));
 }
 
 //----------------------------------------------------------------------------------------
@@ -1143,30 +1176,26 @@ NSpGame::ReleaseGroups(NSpGroupID *inGroups)
 NMBoolean
 NSpGame::HandleCreateGroupMessage(TCreateGroupMessage *inMessage)
 {
-NSp_InterruptSafeListIterator	iter(*mGroupList);
-NSp_InterruptSafeListMember	*theItem;
-GroupListItem				*theGroup;
-NMBoolean					found = false;
 GroupListItem				*groupEntry;
 
+	//	The group already exists, just ignore the message and move on
+	if (NULL != GetGroupListItem(inMessage->id))
+		return (true);
+
 	groupEntry = new GroupListItem;
 
 	if (NULL == groupEntry)
 		return (false);
 
-	//	find the group in the list
-	while ((false == found) && iter.Next(&theItem))
-	{
-		theGroup = (GroupListItem *)theItem;
-
-		//	The group already exists, just ignore the message and move on
-		if (theGroup->id == inMessage->id)
-			return (true);
-	}
-
 	groupEntry->id = inMessage->id;
 	groupEntry->playerCount = 0;
 
+	if (!mGroupIndex->Add(groupEntry->id, groupEntry))
+	{
+		delete groupEntry;
+		return (false);
+	}
+
 	mGroupList->Append(groupEntry);
 
 	mGameInfo.currentGroups++;
@@ -1238,20 +1267,30 @@ NMBoolean					bDeleteAll = false;
 	if (mGameInfo.currentGroups < 1)
 		return (kNSpNoGroupsErr);
 
-	//	find the group in the list
-	while (iter.Next(&theItem))
+	if (false == bDeleteAll)
 	{
-		theGroup = (GroupListItem *)theItem;
+		theGroup = GetGroupListItem(inID);
 
-		if (bDeleteAll || theGroup->id == inID)
+		if (NULL != theGroup)
 		{
-			mGroupList->Remove(theItem);
+			mGroupIndex->Remove(inID);
+			mGroupList->Remove(theGroup);
 			delete theGroup;
 			mGameInfo.currentGroups--;
-
-			if (false == bDeleteAll)
-				break;
 		}
+
+		return (kNMNoError);
+	}
+
+	mGroupIndex->RemoveAll();
+
+	while (iter.Next(&theItem))
+	{
+		theGroup = (GroupListItem *)theItem;
+
+		mGroupList->Remove(theItem);
+		delete theGroup;
+		mGameInfo.currentGroups--;
 	}
 
 	return (kNMNoError);
@@ -1422,7 +1461,6 @@ NSpGame::HandleRemovePlayerFromGroupMessage(TRemovePlayerFromGroupMessage *inMes
 NMErr
 NSpGame::DoSelfSend(NSpMessageHeader *inHeader, void *inBody, NSpFlags inFlags, NMBoolean inCopy)
 {
-UNUSED_PARAMETER(inBody);
 UNUSED_PARAMETER(inFlags);
 UNUSED_PARAMETER(inCopy);
 
@@ -1434,9 +1472,18 @@ UNUSED_PARAMETER(inCopy);
 	if (NULL == theERObject)
 		return (kNSpFreeQExhaustedErr);
 
-	//	Message headers and their data are now contiguous in memory, so
-	//	we can copy them with one move...
-	machine_move_data(inHeader, theERObject->PeekNetMessage(), inHeader->messageLen);
+	//	Message headers and their data are usually contiguous in memory, so
+	//	we can copy them with one move... unless the body was passed separately.
+	if ((inBody == NULL) || (inBody == (NMUInt8 *) inHeader + sizeof(NSpMessageHeader)))
+	{
+		machine_move_data(inHeader, theERObject->PeekNetMessage(), inHeader->messageLen);
+	}
+	else
+	{
+		machine_move_data(inHeader, theERObject->PeekNetMessage(), sizeof(NSpMessageHeader));
+		machine_move_data(inBody, (NMUInt8 *) theERObject->PeekNetMessage() + sizeof(NSpMessageHeader),
+							inHeader->messageLen - sizeof(NSpMessageHeader));
+	}
 
 	//	Set the when
 	theERObject->PeekNetMessage()->when = ::GetTimestampMilliseconds() + mTimeStampDifferential;
@@ -1490,40 +1537,20 @@ NSpGame::ServiceSystemQueue(void)
 	if (mSystemEventQ->IsEmpty())
 		return;
 	
-	// Grab the private message list from the private event queue...
-	
-	theERObject = (ERObject *) mSystemEventQ->StealList();
-	
 	DEBUG_PRINT("Servicing the private message queue...");
 	
-	// Note:  The previous call clears the system event queue automically,
-	// so it is immediately ready to accept new system events at interrupt time.
-	// Now that we have a handle to a linked list of messages that have
-	// built up since the last time this function was called, and it is
-	// currently NOT interrupt time, we can walk through the messages and
-	// handle them...
+	// Note:  The system event queue is a lock-free FIFO, so the notifier can
+	// keep adding system events while we drain it here.  It is currently NOT
+	// interrupt time, so we can pull the messages off in the order they
+	// arrived and handle them...
 	
-	if (theERObject == NULL) // <-- Shouldn't be possible, but just in case...
-		return;
-	else
-		::NewReverse(&theERObject);
-		
-	while(theERObject != NULL)
+	while ((theERObject = (ERObject *) mSystemEventQ->Dequeue()) != NULL)
 	{
-		// Before messing with the current ERObject, capture the pointer
-		// to the next ERObject...
-		
-		ERObject *nextERObject = (ERObject *) theERObject->fNext;
-		
 		// Handle the current ERObject the way that they used to be handled at
 		// interrupt time...
 		
 		this->HandleEvent(theERObject, theERObject->GetEndpoint() , theERObject->GetCookie());
-	
-		theERObject = nextERObject;
 	}
-	
-	
 }
 
 //----------------------------------------------------------------------------------------
@@ -1531,25 +1558,16 @@ NSpGame::ServiceSystemQueue(void)
 //----------------------------------------------------------------------------------------
 
 NMBoolean
-NSpGame::NSpMessage_Get(NSpMessageHeader **outMessage)
+NSpGame::NSpMessage_Get(NSpMessageHeader **outMessage, NMBoolean inBorrow)
 {
 	ERObject			*theERObject = NULL;
 	NSpMessageHeader	*theMessage = NULL;
 	NMErr				status = kNMNoError;
 
-	//	If there aren't already messages in our list, dump the q
-	if (!mPendingMessages)
-	{
-		if (mEventQ->IsEmpty())
-			return false;
-
-		mPendingMessages = (ERObject *) mEventQ->StealList();
-		::NewReverse(&mPendingMessages);
-		
-	}
-
-	theERObject = mPendingMessages;
-	mPendingMessages = (ERObject *) mPendingMessages->fNext;
+	//	The event q is FIFO, so the oldest message comes off first
+	theERObject = (ERObject *) mEventQ->Dequeue();
+	if (theERObject == NULL)
+		return false;
 
 	mMessageQLen--;
 
@@ -1559,6 +1577,17 @@ NSpGame::NSpMessage_Get(NSpMessageHeader **outMessage)
 		goto error;
 	}
 
+	//	A borrowed message stays in its ERObject; the whole thing goes back to
+	//	the free q when the app returns its last reference
+	if (inBorrow)
+	{
+		theERObject->SetRefCount(1);
+		mBorrowedList.AddFirst(theERObject);
+		*outMessage = theMessage;
+
+		return (true);
+	}
+
 	//	This eats out the nice creme filling and leaves only the cookie
 	theMessage = theERObject->RemoveNetMessage();
 	*outMessage = theMessage;
@@ -1581,28 +1610,40 @@ error:
 // NSpGame::GetRTT
 //----------------------------------------------------------------------------------------
 
-NMUInt32
-NSpGame::GetRTT(NSpPlayerID inPlayer)
+NMSInt32
+NSpGame::GetRTT(NSpPlayerID inPlayer, NMBoolean inJitter)
 {
-UNUSED_PARAMETER(inPlayer);
+CEndpoint	*endpoint;
 
-	DEBUG_PRINT("GetRTT not implemented");
+	if (inPlayer == mPlayerID)
+		return (0);
 
-	return 0;
+	endpoint = GetPeerEndpoint(inPlayer);
+
+	if (NULL == endpoint)
+		return (kNSpInvalidPlayerIDErr);
+
+	return (inJitter ? endpoint->GetRTTJitter() : endpoint->GetRTT());
 }
 
 //----------------------------------------------------------------------------------------
 // NSpGame::GetThruput
 //----------------------------------------------------------------------------------------
 
-NMUInt32
+NMSInt32
 NSpGame::GetThruput(NSpPlayerID inPlayer)
 {
-UNUSED_PARAMETER(inPlayer);
+CEndpoint	*endpoint;
 
-	DEBUG_PRINT("GetThruput not implemented");
+	if (inPlayer == mPlayerID)
+		return (0);
 
-	return 0;
+	endpoint = GetPeerEndpoint(inPlayer);
+
+	if (NULL == endpoint)
+		return (kNSpInvalidPlayerIDErr);
+
+	return (endpoint->GetThruput());
 }
 
 //----------------------------------------------------------------------------------------
@@ -1663,6 +1704,57 @@ NSpGame::GetQState(NMUInt32 *outFreeQ, NMUInt32 *outCookieQ, NMUInt32 *outMessag
 	*outMessageQ = mMessageQLen;
 }
 
+//----------------------------------------------------------------------------------------
+// NSpGame::RetainBorrowedMessage
+//----------------------------------------------------------------------------------------
+
+NMErr
+NSpGame::RetainBorrowedMessage(NSpMessageHeader *inMessage)
+{
+	NMLink	**link = FindBorrowedLink(inMessage);
+
+	if (NULL == link)
+		return (kNSpInvalidParameterErr);
+
+	((ERObject *) *link)->AddRef();
+
+	return (kNMNoError);
+}
+
+//----------------------------------------------------------------------------------------
+// NSpGame::ReturnBorrowedMessage
+//----------------------------------------------------------------------------------------
+
+NMErr
+NSpGame::ReturnBorrowedMessage(NSpMessageHeader *inMessage)
+{
+	NMLink		**link = FindBorrowedLink(inMessage);
+	ERObject	*theERObject;
+
+	if (NULL == link)
+		return (kNSpInvalidParameterErr);
+
+	theERObject = (ERObject *) *link;
+
+	if (0 == theERObject->DropRef())
+	{
+		*link = theERObject->fNext;
+		ReleaseERObject(theERObject);
+	}
+
+	return (kNMNoError);
+}
+
+//----------------------------------------------------------------------------------------
+// NSpGame::GetPoolStats
+//----------------------------------------------------------------------------------------
+
+void
+NSpGame::GetPoolStats(NSpMessagePoolStats *outStats)
+{
+	mMessagePool->GetStats(outStats);
+}
+
 
 //----------------------------------------------------------------------------------------
 // NSpGame::IsSystemEvent
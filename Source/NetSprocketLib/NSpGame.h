@@ -50,6 +50,7 @@
 
 	extern NMUInt32	gStandardMessageSize;
 	extern NMUInt32	gQElements;
+	extern NMUInt32	gMessagePoolCeiling;
 //extern NMUInt32	gBufferSize;
 
 //	------------------------------	Public Types
@@ -89,6 +90,7 @@
 				void		FreeDataBuffer(NMUInt8 *inBuf);
 
 				void		FreeNetMessage(NSpMessageHeader *inMessage);
+				NMLink		**FindBorrowedLink(NSpMessageHeader *inMessage);
 		
 	//	Methods for iterating through players and getting info
 		inline	NMUInt32	GetPlayerCount(void) { return mGameInfo.currentPlayers;}
@@ -97,8 +99,8 @@
 				void		NSpPlayer_ReleaseInfo(NSpPlayerInfoPtr inInfo);
 				NMErr	NSpPlayer_GetEnumeration(NSpPlayerEnumerationPtr *outPlayers);
 				void		NSpPlayer_ReleaseEnumeration(NSpPlayerEnumerationPtr inPlayers);		
-				NMUInt32	GetRTT(NSpPlayerID inPlayer);
-				NMUInt32	GetThruput(NSpPlayerID inPlayer);
+				NMSInt32	GetRTT(NSpPlayerID inPlayer, NMBoolean inJitter = false);
+				NMSInt32	GetThruput(NSpPlayerID inPlayer);
 				
 	//	Group management
 		virtual	NMErr	NSpGroup_Create(NSpGroupID *outGroupID);
@@ -121,18 +123,23 @@
 		
 		//ecf - allows idling op endpoints
 		virtual void		IdleEndpoints(void) = 0;
+		virtual NMErr		Flush(void) = 0;
+		virtual CEndpoint	*GetPeerEndpoint(NSpPlayerID inPlayer) = 0;
 		virtual NMErr	SendTo(NSpPlayerID inTo, NMSInt32 inWhat, void *inData, NMUInt32 inLen, NSpFlags inFlags) = 0;
 		virtual	void		HandleEvent(ERObject *inERObject, CEndpoint *inEndpoint, void *inCookie) = 0;
 		virtual	void		HandleNewEvent(ERObject *inERObject, CEndpoint *inEndpoint, void *inCookie) = 0;
 		virtual NMBoolean		IsSystemEvent(ERObject *inERObject);
 		virtual NMErr	PrepareForDeletion(NSpFlags inFlags) = 0;
-				NMBoolean	NSpMessage_Get(NSpMessageHeader **outMessage);
+				NMBoolean	NSpMessage_Get(NSpMessageHeader **outMessage, NMBoolean inBorrow = false);
+				NMErr		RetainBorrowedMessage(NSpMessageHeader *inMessage);
+				NMErr		ReturnBorrowedMessage(NSpMessageHeader *inMessage);
 		virtual	NMErr	HandleEndpointDisconnected(CEndpoint *inEndpoint) = 0;
 				void	ServiceSystemQueue(void);
 	//	Accessors
 		inline 	NSpPlayerID	NSpPlayer_GetMyID(void) { return mPlayerID;}
 		inline 	NMSInt32	GetTimeStampDifferential(void) {return mTimeStampDifferential;}
 		inline	NSpGameInfo *GetGameInfo() {return &mGameInfo;}
+		inline	NSpFlags	GetFlags(void) {return mFlags;}
 		inline	void		SetGameInfo(const NSpGameInfo *inInfo) { mGameInfo = *inInfo;}
 
 		inline  NSpGamePrivate *GetGameOwner() {return mOwner;}
@@ -145,11 +152,13 @@
 				void		InstallCallbackHandler(NSpCallbackProcPtr	inCallbackHandler,
 									void *inCallbackContext);
 				void		GetQState(NMUInt32 *outFreeQ, NMUInt32 *outCookieQ, NMUInt32 *outMessageQ);
+				void		GetPoolStats(NSpMessagePoolStats *outStats);
 	protected:
 	//	Methods for handling the player list
 		virtual	NMBoolean	AddPlayer(NSpPlayerInfo *inInfo, CEndpoint *inEndpoint);
 		virtual	NMBoolean	RemovePlayer(NSpPlayerID inPlayer, NMBoolean inDisconnect) = 0;
 				PlayerListItem *GetPlayerListItem(NSpPlayerID inPlayerID);
+				GroupListItem *GetGroupListItem(NSpGroupID inGroupID);
 				NMErr	DoSelfSend(NSpMessageHeader *inMessage, void *inBody, NSpFlags inFlags, NMBoolean inCopy = true);
 				void		HandleEventForSelf(ERObject *inERObject, CEndpoint *inEndpoint);
 				NMBoolean	HandlePlayerLeft(NSpPlayerLeftMessage *inMessage);
@@ -169,14 +178,17 @@
 		NSp_InterruptSafeList			*mGroupList;
 		NSp_InterruptSafeListIterator	*mPlayerListIter;
 		NSp_InterruptSafeListIterator	*mGroupListIter;
+		NSpIDTable						*mPlayerIndex;
+		NSpIDTable						*mGroupIndex;
 		
 		NSpPlayerID						mPlayerID;
 		
-		NMLIFO							*mEventQ;
-		NMLIFO							*mSystemEventQ;
+		NMFIFO							*mEventQ;
+		NMFIFO							*mSystemEventQ;
 		NMLIFO							*mFreeQ;
 		NMLIFO							*mCookieQ;
-		ERObject						*mPendingMessages;
+		NSpMessagePool					*mMessagePool;
+		NMList							mBorrowedList;
 		NMUInt32						mCookieQLen, 
 										mFreeQLen, 
 										mMessageQLen;
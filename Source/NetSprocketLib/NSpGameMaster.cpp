@@ -553,10 +553,8 @@ NSpGameMaster::RouteMessage(NSpMessageHeader *inHeader, NMUInt8 *inBody, NSpFlag
 {
 	NMErr	 						status = kNMNoError;
 	NSp_InterruptSafeListIterator	*iter = mSystemPlayerIterator;
-	NSp_InterruptSafeListIterator	*groupIter = mSystemGroupIterator;
 	NSp_InterruptSafeListMember 	*theItem;
 	PlayerListItem					*thePlayer;
-	NMBoolean						found = false;
 	NMBoolean						performSelfSend = false;
 	NSpPlayerID						fromPlayer;
 	NSpPlayerID						toPlayer;
@@ -607,53 +605,24 @@ NSpGameMaster::RouteMessage(NSpMessageHeader *inHeader, NMUInt8 *inBody, NSpFlag
 	else if (toPlayer > kNSpAllPlayers)		//	To a specific player that is not us
 	{
 		//	Find that person
-		//	How can we make this faster?
-		iter->Reset();
+		thePlayer = GetPlayerListItem(toPlayer);
 
-		while (iter->Next(&theItem))
-		{
-			thePlayer = (PlayerListItem *)theItem;
-			if (thePlayer->id == toPlayer)
-			{
-				if (thePlayer->id == mPlayerID)
-					status = DoSelfSend(inHeader, inBody, inFlags);
-				else
-					status = thePlayer->endpoint->SendMessage(inHeader, inBody, inFlags);
-				break;
-			}
-		}
+		if (NULL != thePlayer)
+			status = thePlayer->endpoint->SendMessage(inHeader, inBody, inFlags);
 	}
 	else if (toPlayer < kNSpMasterEndpointID)		//	To a group
 	{	
-		NSp_InterruptSafeListIterator 	*playerIterator = NULL;
-		GroupListItem				*theGroup = NULL;
+		GroupListItem				*theGroup;
 			
-		groupIter->Reset();
-		
-		found = false;	
-
-		//	First find the group in the list
-		while (!found && groupIter->Next(&theItem))
-		{
-			theGroup = (GroupListItem *)theItem;
-			if (theGroup->id == inHeader->to)
-			{
-				found = true;
-			}
-		}
+		//	First find the group
+		theGroup = GetGroupListItem(toPlayer);
 		
 		//	If we didn't find it, bail
-		if (!found)
+		if (NULL == theGroup)
 			return 	(kNSpInvalidGroupIDErr);
 
 		//	Now we have the group, lets iterate over the players, sending to them
-		//	Iterate through our player list
-		playerIterator = new NSp_InterruptSafeListIterator(*theGroup->players);
-		if (playerIterator == NULL){
-			op_vpause("NSpGameMaster::RouteMessage - playerIterator == NULL");
-			status = kNSpMemAllocationErr;
-			goto error;
-		}
+		NSp_InterruptSafeListIterator 	playerIterator(*theGroup->players);
 		
 #if !big_endian
 		//	Byte-swap the message for sending now, and don't do it on each call
@@ -668,7 +637,7 @@ NSpGameMaster::RouteMessage(NSpMessageHeader *inHeader, NMUInt8 *inBody, NSpFlag
 #endif
 		
 		//	Now loop through all players in the group...
-		while (playerIterator->Next(&theItem))
+		while (playerIterator.Next(&theItem))
 		{
 			thePlayer = (PlayerListItem *)((UInt32ListMember *)theItem)->GetValue();
 
@@ -698,10 +667,8 @@ NSpGameMaster::RouteMessage(NSpMessageHeader *inHeader, NMUInt8 *inBody, NSpFlag
 #endif
 			status = DoSelfSend(inHeader, inBody, inFlags);
 		}
-		delete playerIterator;
 	}
 	
-error:
 	return (status);
 }
 
@@ -713,8 +680,6 @@ NMErr
 NSpGameMaster::SendUserMessage(NSpMessageHeader *inMessage, NSpFlags inFlags)
 {
 	NMErr						status = kNMNoError;
-	NSp_InterruptSafeListIterator	*groupIter = mGroupListIter;
-	NSp_InterruptSafeListIterator	*playerIter;
 	NSp_InterruptSafeListMember	*theItem;
 	PlayerListItem				*thePlayer;
 	GroupListItem				*theGroup;
@@ -766,31 +731,21 @@ NSpGameMaster::SendUserMessage(NSpMessageHeader *inMessage, NSpFlags inFlags)
 	else if (inTo < kNSpMasterEndpointID)		//	To a group
 	{
 		//	If we're a member, send it to ourselves before sending to the host
-		groupIter->Reset();
+		theGroup = GetGroupListItem(inMessage->to);
 
-		while (groupIter->Next(&theItem))
+		if (NULL != theGroup)
 		{
-			theGroup = (GroupListItem *) theItem;
+			NSp_InterruptSafeListIterator	playerIter(*theGroup->players);
 
-			if (theGroup->id == inMessage->to)
+			while (playerIter.Next(&theItem))
 			{
-				playerIter = new NSp_InterruptSafeListIterator(*theGroup->players);
+				thePlayer = (PlayerListItem *)(((UInt32ListMember *)theItem)->GetValue());
 
-				if (playerIter == NULL)
-					break;
-				
-				while (playerIter->Next(&theItem))
+				if (thePlayer->id == mPlayerID)
 				{
-					thePlayer = (PlayerListItem *)(((UInt32ListMember *)theItem)->GetValue());
-
-					if (thePlayer->id == mPlayerID)
-					{
-						status = DoSelfSend(inMessage, inData, inFlags);
-						break;
-					}
+					status = DoSelfSend(inMessage, inData, inFlags);
+					break;
 				}
-				delete playerIter;
-				break;
 			}
 		}
 
@@ -817,9 +772,65 @@ error:
 void
 NSpGameMaster::IdleEndpoints(void)
 {
+NSp_InterruptSafeListIterator	iter(*mPlayerList);
+NSp_InterruptSafeListMember		*theItem;
+PlayerListItem					*thePlayer;
+
 	//fixme - theoretically, we should be idling all our endpoints?
 	if (mPlayersEndpoint)
 		mPlayersEndpoint->Idle();
+
+	//	Keep the round-trip and throughput estimates for each remote player fresh
+	while (iter.Next(&theItem))
+	{
+		thePlayer = (PlayerListItem *) theItem;
+
+		if (thePlayer->id != mPlayerID && NULL != thePlayer->endpoint)
+			thePlayer->endpoint->IdleLink(thePlayer->id);
+	}
+}
+
+//----------------------------------------------------------------------------------------
+// NSpGameMaster::Flush
+//----------------------------------------------------------------------------------------
+NMErr
+NSpGameMaster::Flush(void)
+{
+NSp_InterruptSafeListIterator	iter(*mPlayerList);
+NSp_InterruptSafeListMember		*theItem;
+PlayerListItem					*thePlayer;
+NMErr							status = kNMNoError;
+NMErr							err;
+
+	//	Push out anything gathered on the link to each remote player
+	while (iter.Next(&theItem))
+	{
+		thePlayer = (PlayerListItem *) theItem;
+
+		if (thePlayer->id != mPlayerID && NULL != thePlayer->endpoint)
+		{
+			err = thePlayer->endpoint->Flush();
+
+			if (kNMNoError == status)
+				status = err;
+		}
+	}
+
+	return (status);
+}
+
+//----------------------------------------------------------------------------------------
+// NSpGameMaster::GetPeerEndpoint
+//----------------------------------------------------------------------------------------
+
+CEndpoint *
+NSpGameMaster::GetPeerEndpoint(NSpPlayerID inPlayer)
+{
+PlayerListItem	*thePlayer;
+
+	thePlayer = GetPlayerListItem(inPlayer);
+
+	return ((NULL != thePlayer) ? thePlayer->endpoint : NULL);
 }
 
 
@@ -831,10 +842,8 @@ NMErr
 NSpGameMaster::SendTo(NSpPlayerID inTo, NMSInt32 inWhat, void *inData, NMUInt32 inLen, NSpFlags inFlags)
 {
 	NMErr							status = kNMNoError;
-	NSpMessageHeader				*headerPtr;
-	NMUInt8							*dataPtr = NULL;
-	NSp_InterruptSafeListIterator	*groupIter = mGroupListIter;
-	NSp_InterruptSafeListIterator	*playerIter;
+	NSpMessageHeader				header;
+	NSpMessageHeader				*headerPtr = &header;
 	NSp_InterruptSafeListMember		*theItem;
 	PlayerListItem					*thePlayer;
 	GroupListItem					*theGroup;
@@ -847,16 +856,8 @@ NSpGameMaster::SendTo(NSpPlayerID inTo, NMSInt32 inWhat, void *inData, NMUInt32
 	if (bHeadlessServer)
 		return (kNSpSendFailedErr);
 	
-	dataPtr = new NMUInt8[inLen + sizeof(NSpMessageHeader)];	//### $Brian new [] vs. new()
-	
-	if (dataPtr == NULL)
-		return (kNSpSendFailedErr);
-
-	headerPtr = (NSpMessageHeader *) dataPtr;
-	
-	if (headerPtr == NULL)
-		return (kNSpSendFailedErr);
-		
+	//	The header lives on the stack and the body stays where the caller put it;
+	//	SendMessage() and DoSelfSend() put the two together as they go out.
 	NSpClearMessageHeader(headerPtr);
 			
 	headerPtr->from = mPlayerID;
@@ -865,8 +866,6 @@ NSpGameMaster::SendTo(NSpPlayerID inTo, NMSInt32 inWhat, void *inData, NMUInt32
 	headerPtr->id = mNextMessageID++;
 	headerPtr->what = inWhat;
 	headerPtr->messageLen = inLen + sizeof(NSpMessageHeader);
-	
-	machine_move_data(inData, ((NMUInt8 *) headerPtr) + sizeof(NSpMessageHeader), inLen);
 
 	if (inTo == kNSpAllPlayers)			//	To all
 	{
@@ -892,31 +891,21 @@ NSpGameMaster::SendTo(NSpPlayerID inTo, NMSInt32 inWhat, void *inData, NMUInt32
 	else if (inTo < kNSpMasterEndpointID)		//	To a group
 	{
 		//	If we're a member, send it to ourselves before sending to the host
-		groupIter->Reset();
+		theGroup = GetGroupListItem(inTo);
 
-		while (groupIter->Next(&theItem))
+		if (NULL != theGroup)
 		{
-			theGroup = (GroupListItem *) theItem;
+			NSp_InterruptSafeListIterator	playerIter(*theGroup->players);
 
-			if (theGroup->id == inTo)
+			while (playerIter.Next(&theItem))
 			{
-				playerIter = new NSp_InterruptSafeListIterator(*theGroup->players);
+				thePlayer = (PlayerListItem *)(((UInt32ListMember *)theItem)->GetValue());
 
-				if (playerIter == NULL)
-					break;
-				
-				while (playerIter->Next(&theItem))
+				if (thePlayer->id == mPlayerID)
 				{
-					thePlayer = (PlayerListItem *)(((UInt32ListMember *)theItem)->GetValue());
-
-					if (thePlayer->id == mPlayerID)
-					{
-						status = DoSelfSend(headerPtr, inData, inFlags);
-						break;
-					}
+					status = DoSelfSend(headerPtr, inData, inFlags);
+					break;
 				}
-				delete playerIter;
-				break;
 			}
 		}
 
@@ -924,10 +913,6 @@ NSpGameMaster::SendTo(NSpPlayerID inTo, NMSInt32 inWhat, void *inData, NMUInt32
 		status = mPlayersEndpoint->SendMessage(headerPtr, (NMUInt8 *) inData, inFlags);
 	}
 
-error:
-	if (dataPtr != NULL)
-		delete[] dataPtr;	//### $Brian delete [] vs. delete
-
 	return (status);
 }
 
@@ -1546,6 +1531,7 @@ NMBoolean					found = false;
 
 		if (removeAll || thePlayer->id == inPlayer)
 		{
+			mPlayerIndex->Remove(thePlayer->id);
 			mPlayerList->Remove(theItem);
 			
 			if (thePlayer->endpoint)
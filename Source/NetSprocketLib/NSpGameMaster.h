@@ -78,6 +78,8 @@
 					NMErr		InstallJoinRequestHandler(NSpJoinRequestHandlerProcPtr inHandler, void *inContext);
 		virtual	NMErr		HandleEndpointDisconnected(CEndpoint *inEndpoint);
 		virtual	void		IdleEndpoints(void);
+		virtual	NMErr		Flush(void);
+		virtual	CEndpoint	*GetPeerEndpoint(NSpPlayerID inPlayer);
 		
 	//	Methods for sending data
 		virtual NMErr		SendUserMessage(NSpMessageHeader *inMessage, NSpFlags inFlags);
@@ -80,7 +80,7 @@ NMErr NSpGamePrivate::PrepareForDeletion(NSpFlags inFlags)
 // NSpGamePrivate::NSpMessage_Get
 //----------------------------------------------------------------------------------------
 
-NMBoolean NSpGamePrivate::NSpMessage_Get(NSpMessageHeader **outMessage)
+NMBoolean NSpGamePrivate::NSpMessage_Get(NSpMessageHeader **outMessage, NMBoolean inBorrow)
 {
 	NMBoolean	gotEvent = false;
 	
@@ -92,7 +92,7 @@ NMBoolean NSpGamePrivate::NSpMessage_Get(NSpMessageHeader **outMessage)
 		// process them, and put them in the user's queue when appropriate...
 		mMaster->ServiceSystemQueue();
 		// Now get the user's message...
-		gotEvent = mMaster->NSpMessage_Get(outMessage);
+		gotEvent = mMaster->NSpMessage_Get(outMessage, inBorrow);
 	}
 	else if (mSlave)
 	{
@@ -102,7 +102,7 @@ NMBoolean NSpGamePrivate::NSpMessage_Get(NSpMessageHeader **outMessage)
 		// process them, and put them in the user's queue when appropriate...
 		mSlave->ServiceSystemQueue();
 		// Now get the user's message...
-		gotEvent = mSlave->NSpMessage_Get(outMessage);
+		gotEvent = mSlave->NSpMessage_Get(outMessage, inBorrow);
 	}
 	
 	return gotEvent;
@@ -51,7 +51,7 @@
 				NSpGame		*GetGameObject(void);
 				
 				NMErr	PrepareForDeletion(NSpFlags inFlags);
-				NMBoolean	NSpMessage_Get(NSpMessageHeader **outMessage);
+				NMBoolean	NSpMessage_Get(NSpMessageHeader **outMessage, NMBoolean inBorrow = false);
 
 	protected:
 		NSpGameMaster	*mMaster;
@@ -228,8 +228,6 @@ NMErr
 NSpGameSlave::SendUserMessage(NSpMessageHeader *inMessage, NSpFlags inFlags)
 {
 NMErr status;
-NSp_InterruptSafeListIterator 	groupIter(*mGroupList);
-NSp_InterruptSafeListIterator 	*playerIter;
 NSp_InterruptSafeListMember 	*theItem;
 PlayerListItem				*thePlayer;
 GroupListItem				*theGroup;
@@ -259,29 +257,19 @@ NMBoolean					swapBack = false;	//?? why here and not below?
 	}
 	else if (inMessage->to < kNSpMasterEndpointID)	//	We need to handle if its a group. In case we're a member
 	{
-		if (!bSelfSent)
+		theGroup = bSelfSent ? NULL : GetGroupListItem(inMessage->to);
+
+		if (NULL != theGroup)
 		{
-			while (groupIter.Next(&theItem))
+			NSp_InterruptSafeListIterator 	playerIter(*theGroup->players);
+
+			while (playerIter.Next(&theItem))
 			{
-				theGroup = (GroupListItem *) theItem;
-				if (theGroup->id == inMessage->to)
+				thePlayer = (PlayerListItem *)(((UInt32ListMember *)theItem)->GetValue());
+				if (thePlayer->id == mPlayerID)
 				{
-					playerIter = new NSp_InterruptSafeListIterator(*theGroup->players);
-					//ThrowIfNULL_(playerIter);
-					op_assert(playerIter);
-
-					while (playerIter->Next(&theItem))
-					{
-						thePlayer = (PlayerListItem *)(((UInt32ListMember *)theItem)->GetValue());
-						if (thePlayer->id == mPlayerID)
-						{
-							status = DoSelfSend(inMessage, (NMUInt8 *)inMessage + sizeof (NSpMessageHeader), inFlags);
-							bSelfSent = true;
-							break;
-						}
-					}
-
-					delete playerIter;
+					status = DoSelfSend(inMessage, (NMUInt8 *)inMessage + sizeof (NSpMessageHeader), inFlags);
+					bSelfSent = true;
 					break;
 				}
 			}
@@ -319,7 +307,25 @@ NSpGameSlave::IdleEndpoints(void)
 {
 	//fixme - theoretically, we should be idling all our endpoints?
 	if (mEndpoint)
+	{
 		mEndpoint->Idle();
+		mEndpoint->IdleLink(kNSpMasterEndpointID);
+	}
+}
+
+//----------------------------------------------------------------------------------------
+// NSpGameSlave::GetPeerEndpoint
+//----------------------------------------------------------------------------------------
+//	Everything we send goes through the host, so the round trip and throughput to
+//	any player are measured on our connection to the host.
+
+CEndpoint *
+NSpGameSlave::GetPeerEndpoint(NSpPlayerID inPlayer)
+{
+	if (kNSpMasterEndpointID != inPlayer && NULL == GetPlayerListItem(inPlayer))
+		return (NULL);
+
+	return (mEndpoint);
 }
 
 //----------------------------------------------------------------------------------------
@@ -330,11 +336,8 @@ NMErr
 NSpGameSlave::SendTo(NSpPlayerID inTo, NMSInt32 inWhat, void *inData, NMUInt32 inLen, NSpFlags inFlags)
 {
 NMErr status;
-//NSpMessageHeader header;
-NSpMessageHeader				*headerPtr = NULL;
-NMUInt8							*dataPtr;
-NSp_InterruptSafeListIterator 	groupIter(*mGroupList);
-NSp_InterruptSafeListIterator 	*playerIter;
+NSpMessageHeader				header;
+NSpMessageHeader				*headerPtr = &header;
 NSp_InterruptSafeListMember 	*theItem;
 PlayerListItem					*thePlayer;
 GroupListItem					*theGroup;
@@ -344,13 +347,8 @@ NMBoolean						bSelfSent = false;
 	if (mGameState == kStopped)
 		return kNSpGameTerminatedErr;
 
-	dataPtr = new NMUInt8[inLen + sizeof(NSpMessageHeader)];
-	
-	if (dataPtr == NULL)
-		return (kNSpSendFailedErr);
-
-	headerPtr = (NSpMessageHeader *) dataPtr;
-			
+	//	The header lives on the stack and the body stays where the caller put it;
+	//	SendMessage() and DoSelfSend() put the two together as they go out.
 	NSpClearMessageHeader(headerPtr);
 			
 	headerPtr->from = mPlayerID;
@@ -359,9 +357,6 @@ NMBoolean						bSelfSent = false;
 	headerPtr->id = mNextMessageID++;
 	headerPtr->what = inWhat;
 	headerPtr->messageLen = inLen + sizeof(NSpMessageHeader);
-	
-	machine_move_data(inData, dataPtr + sizeof(NSpMessageHeader), inLen);
-
 
 	if (inFlags & kNSpSendFlag_SelfSend)
 	{
@@ -378,29 +373,19 @@ NMBoolean						bSelfSent = false;
 	}
 	else if (inTo < kNSpMasterEndpointID)	// We need to handle if its a group. In case we're a member
 	{
-		if (!bSelfSent)
+		theGroup = bSelfSent ? NULL : GetGroupListItem(inTo);
+
+		if (NULL != theGroup)
 		{
-			while (groupIter.Next(&theItem))
+			NSp_InterruptSafeListIterator 	playerIter(*theGroup->players);
+
+			while (playerIter.Next(&theItem))
 			{
-				theGroup = (GroupListItem *) theItem;
-				if (theGroup->id == inTo)
+				thePlayer = (PlayerListItem *)(((UInt32ListMember *)theItem)->GetValue());
+				if (thePlayer->id == mPlayerID)
 				{
-					playerIter = new NSp_InterruptSafeListIterator(*theGroup->players);
-					//ThrowIfNULL_(playerIter);
-					op_assert(playerIter);
-
-					while (playerIter->Next(&theItem))
-					{
-						thePlayer = (PlayerListItem *)(((UInt32ListMember *)theItem)->GetValue());
-						if (thePlayer->id == mPlayerID)
-						{
-							status = DoSelfSend(headerPtr, inData, inFlags);
-							bSelfSent = true;
-							break;
-						}
-					}
-
-					delete playerIter;
+					status = DoSelfSend(headerPtr, inData, inFlags);
+					bSelfSent = true;
 					break;
 				}
 			}
@@ -414,9 +399,6 @@ NMBoolean						bSelfSent = false;
 		status = mEndpoint->SendMessage(headerPtr, (NMUInt8 *) inData, inFlags);
 	}
 
-	if (dataPtr != NULL)
-		delete dataPtr;
-
 	return status;
 }
 
@@ -678,6 +660,19 @@ NSpGameSlave::GetBacklog( void )
  return mEndpoint->GetBacklog();
 }
 
+//----------------------------------------------------------------------------------------
+// NSpGameSlave::Flush
+//----------------------------------------------------------------------------------------
+
+NMErr
+NSpGameSlave::Flush(void)
+{
+	if (NULL == mEndpoint)
+		return (kNMNoError);
+
+	return (mEndpoint->Flush());
+}
+
 //----------------------------------------------------------------------------------------
 // NSpGameSlave::PrepareForDeletion
 //----------------------------------------------------------------------------------------
@@ -860,6 +855,8 @@ NMBoolean					found = false;
 		thePlayer = (PlayerListItem *)theItem;
 		if (removeAll || thePlayer->id == inPlayer)
 		{
+			mPlayerIndex->Remove(thePlayer->id);
+
 			if (mPlayerList->Remove(theItem))
 			{
 				delete thePlayer;
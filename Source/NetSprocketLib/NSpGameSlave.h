@@ -60,6 +60,8 @@
 		
 		virtual	NMErr	HandleEndpointDisconnected(CEndpoint *inEndpoint);
 		virtual void	IdleEndpoints(void);
+		virtual NMErr	Flush(void);
+		virtual CEndpoint	*GetPeerEndpoint(NSpPlayerID inPlayer);
 
 	protected:
 		virtual	NMBoolean	RemovePlayer(NSpPlayerID inPlayer, NMBoolean inDisconnect);
@@ -135,95 +135,734 @@ NMBoolean						found = false;
 	return (true);
 }
 
+//	Marks a slot whose entry was removed; probing continues past it
+#define kIDTableTombstone	((NSp_InterruptSafeListMember *) -1)
+#define kIDTableMinSize		16
+
+static inline NMUInt32
+id_table_hash(NMSInt32 inID)
+{
+NMUInt32	h = (NMUInt32) inID * 2654435761UL;
+
+	return (h ^ (h >> 16));
+}
+
 //----------------------------------------------------------------------------------------
-// SendQItem::SendQItem 
+// NSpIDTable::NSpIDTable 
 //----------------------------------------------------------------------------------------
 
-SendQItem::SendQItem(void *inData, NMUInt32 inBytesSent)
+NSpIDTable::NSpIDTable()
 {
-	void	*savedData = NULL;
-	NMUInt32	tempMessageLength;
-	NMUInt32	messageLength;
-	NMUInt32	leftToSend;
-	
-	
-	
-	//	Initialize everything to something boring, just in case.
-	
-	mData = NULL;
-	
-	mTotalSent = 0;
-	
-	mMessageLength = 0;
+	mTable = NULL;
+	mCount = 0;
+	mUsed = 0;
+	mReaders = 0;
+	mGeneration = 0;
+}
 
+//----------------------------------------------------------------------------------------
+// NSpIDTable::~NSpIDTable 
+//----------------------------------------------------------------------------------------
 
-	//	Now fill them in right.
-	
-	//	If this is a non-Macintosh platform, then every path to this point
-	//	has byte-swapped the header.  So we need to byte-swap the variable
-	//	"messageLength" again if we want to use the right value, which we
-	//	do.  
-	//
-	//	To be sure that this works properly, I believe that tempMessageLength
-	//	must always maintain the same data type as does NSpMessageHeader.messageLen.
-	//	Perhaps we should define a type NSpMessageLenType and use that to define
-	//	both variables to ensure future consistency?
-	//
-	//	(CRT, July 7, 2000)
-	
-	tempMessageLength = ((NSpMessageHeader *)inData)->messageLen;
-	
-#if !big_endian
-	tempMessageLength = SWAP4(tempMessageLength);
-#endif
-	
-	messageLength = tempMessageLength;
-		
-	leftToSend = messageLength - inBytesSent;
-			
-	savedData = (void *) InterruptSafe_alloc(leftToSend);
-	//ThrowIfNULL_(savedData);
-	op_assert(savedData);
-						
-	machine_move_data((char *)inData + inBytesSent, savedData, leftToSend);
-	
-	mTotalSent = 0;
-	
-	mMessageLength = leftToSend;
-	
-	mData = savedData;			
+NSpIDTable::~NSpIDTable()
+{
+Table	*table, *next;
+
+	for (table = mTable; table != NULL; table = next)
+	{
+		next = table->retired;
+		InterruptSafe_free(table);
+	}
+}
+
+//----------------------------------------------------------------------------------------
+// NSpIDTable::Resize 
+//----------------------------------------------------------------------------------------
+
+NMBoolean
+NSpIDTable::Resize(NMUInt32 inCapacity)
+{
+Table		*table;
+Slot		*slot;
+NMUInt32	size, i, j;
+
+	size = sizeof (Table) + (inCapacity - 1) * sizeof (Slot);
+	table = (Table *) InterruptSafe_alloc(size);
+
+	if (NULL == table)
+		return (false);
+
+	machine_mem_zero(table, size);
+	table->mask = inCapacity - 1;
+	table->retired = mTable;
+
+	//	Rehash the live entries; tombstones are dropped
+	if (NULL != mTable)
+	{
+		for (i = 0; i <= mTable->mask; i++)
+		{
+			slot = &mTable->slots[i];
+
+			if (NULL == slot->item || kIDTableTombstone == slot->item)
+				continue;
+
+			for (j = id_table_hash(slot->id) & table->mask; NULL != table->slots[j].item; j = (j + 1) & table->mask)
+				;
+
+			table->slots[j] = *slot;
+		}
+	}
+
+	//	Publish the fully built table in one store
+	mTable = table;
+	mUsed = mCount;
+
+	return (true);
+}
+
+//----------------------------------------------------------------------------------------
+// NSpIDTable::Rehash 
+//----------------------------------------------------------------------------------------
+//	Drops the tombstones without a new table.  Every entry is put back at the
+//	first free slot from its home; walking each run from the slot after an empty
+//	one means nothing is ever moved past a slot it could have taken.
+
+void
+NSpIDTable::Rehash(void)
+{
+Slot		slot;
+NMUInt32	start, n, i, j;
+
+	NMAtomicAdd32(&mGeneration, 1);
+
+	for (i = 0; i <= mTable->mask; i++)
+	{
+		if (kIDTableTombstone == mTable->slots[i].item)
+			mTable->slots[i].item = NULL;
+	}
+
+	//	The load is held to one half, so there is always an empty slot
+	for (start = 0; NULL != mTable->slots[start].item; start++)
+		;
+
+	for (n = 1; n <= mTable->mask; n++)
+	{
+		i = (start + n) & mTable->mask;
+
+		if (NULL == mTable->slots[i].item)
+			continue;
+
+		slot = mTable->slots[i];
+		mTable->slots[i].item = NULL;
+
+		for (j = id_table_hash(slot.id) & mTable->mask; NULL != mTable->slots[j].item; j = (j + 1) & mTable->mask)
+			;
+
+		mTable->slots[j] = slot;
+	}
+
+	mUsed = mCount;
+
+	NMAtomicAdd32(&mGeneration, 1);
+}
+
+//----------------------------------------------------------------------------------------
+// NSpIDTable::ReleaseRetired 
+//----------------------------------------------------------------------------------------
+//	A lookup picks up mTable after it counts itself in, so once the count reads
+//	zero nobody can still be looking at a table that has been replaced.
+
+void
+NSpIDTable::ReleaseRetired(void)
+{
+Table	*table, *next;
+
+	if (NULL == mTable || NULL == mTable->retired || 0 != NMAtomicAdd32(&mReaders, 0))
+		return;
+
+	table = mTable->retired;
+	mTable->retired = NULL;
+
+	for (; table != NULL; table = next)
+	{
+		next = table->retired;
+		InterruptSafe_free(table);
+	}
+}
+
+//----------------------------------------------------------------------------------------
+// NSpIDTable::Find 
+//----------------------------------------------------------------------------------------
+
+NSp_InterruptSafeListMember *
+NSpIDTable::Find(NMSInt32 inID)
+{
+Table						*table;
+NSp_InterruptSafeListMember	*item, *found;
+NMSInt32					generation;
+NMUInt32					i;
+
+	NMAtomicAdd32(&mReaders, 1);
+
+	do
+	{
+		//	Wait out a rebuild, and go around again if one overlapped us
+		while ((generation = NMAtomicAdd32(&mGeneration, 0)) & 1)
+			;
+
+		table = mTable;
+		found = NULL;
+
+		if (NULL == table)
+			break;
+
+		for (i = id_table_hash(inID) & table->mask; ; i = (i + 1) & table->mask)
+		{
+			item = table->slots[i].item;
+
+			if (NULL == item)
+				break;
+
+			if (kIDTableTombstone != item && table->slots[i].id == inID)
+			{
+				found = item;
+				break;
+			}
+		}
+	} while (generation != NMAtomicAdd32(&mGeneration, 0));
+
+	NMAtomicAdd32(&mReaders, -1);
+
+	return (found);
+}
+
+//----------------------------------------------------------------------------------------
+// NSpIDTable::Add 
+//----------------------------------------------------------------------------------------
+
+NMBoolean
+NSpIDTable::Add(NMSInt32 inID, NSp_InterruptSafeListMember *inItem)
+{
+NSp_InterruptSafeListMember	*item;
+NMUInt32					capacity, i;
+Slot						*slot;
+
+	if (NULL == inItem)
+		return (false);
+
+	machine_wait_for_lock(&mWriteLock);
+
+	if (NULL != Find(inID))
+	{
+		machine_clear_lock(&mWriteLock);
+		return (false);
+	}
+
+	//	Keep the load (including tombstones) at or under one half
+	if (NULL == mTable || (mUsed + 1) * 2 > mTable->mask + 1)
+	{
+		ReleaseRetired();
+
+		capacity = kIDTableMinSize;
+
+		while ((mCount + 1) * 4 > capacity)
+			capacity <<= 1;
+
+		//	Mostly tombstones; the live entries still fit, so just sweep them out
+		if (NULL != mTable && capacity <= mTable->mask + 1)
+		{
+			Rehash();
+		}
+		else if (!Resize(capacity))
+		{
+			machine_clear_lock(&mWriteLock);
+			return (false);
+		}
+	}
+
+	for (i = id_table_hash(inID) & mTable->mask; ; i = (i + 1) & mTable->mask)
+	{
+		item = mTable->slots[i].item;
+
+		if (NULL == item || kIDTableTombstone == item)
+			break;
+	}
+
+	slot = &mTable->slots[i];
+
+	if (NULL == item)
+		mUsed++;
+
+	//	Set the id before the item so a concurrent Find never matches a stale id
+	slot->id = inID;
+	slot->item = inItem;
+	mCount++;
+
+	machine_clear_lock(&mWriteLock);
+
+	return (true);
+}
+
+//----------------------------------------------------------------------------------------
+// NSpIDTable::Remove 
+//----------------------------------------------------------------------------------------
+
+NMBoolean
+NSpIDTable::Remove(NMSInt32 inID)
+{
+NSp_InterruptSafeListMember	*item;
+NMUInt32					i;
+NMBoolean					found = false;
+
+	machine_wait_for_lock(&mWriteLock);
+
+	if (NULL != mTable)
+	{
+		for (i = id_table_hash(inID) & mTable->mask; ; i = (i + 1) & mTable->mask)
+		{
+			item = mTable->slots[i].item;
+
+			if (NULL == item)
+				break;
+
+			if (kIDTableTombstone != item && mTable->slots[i].id == inID)
+			{
+				mTable->slots[i].item = kIDTableTombstone;
+				mCount--;
+				found = true;
+				break;
+			}
+		}
+	}
+
+	machine_clear_lock(&mWriteLock);
+
+	return (found);
+}
+
+//----------------------------------------------------------------------------------------
+// NSpIDTable::RemoveAll 
+//----------------------------------------------------------------------------------------
+
+void
+NSpIDTable::RemoveAll(void)
+{
+NMUInt32	i;
+
+	machine_wait_for_lock(&mWriteLock);
+
+	//	Tombstone rather than clear, so a concurrent probe isn't cut short
+	if (NULL != mTable)
+	{
+		for (i = 0; i <= mTable->mask; i++)
+		{
+			if (NULL != mTable->slots[i].item)
+				mTable->slots[i].item = kIDTableTombstone;
+		}
+
+		mCount = 0;
+	}
+
+	machine_clear_lock(&mWriteLock);
+}
+
+//	Keep the message that follows a block prefix 16-byte aligned
+#define kBlockPrefixSize	((sizeof (Block) + 15) & ~15)
+
+#define BlockToMessage(b)	((NSpMessageHeader *) ((NMUInt8 *) (b) + kBlockPrefixSize))
+#define MessageToBlock(m)	((Block *) ((NMUInt8 *) (m) - kBlockPrefixSize))
+
+//----------------------------------------------------------------------------------------
+// NSpMessagePool::NSpMessagePool 
+//----------------------------------------------------------------------------------------
+
+NSpMessagePool::NSpMessagePool(NMUInt32 inMinSize, NMUInt32 inCeiling)
+{
+NMUInt32	size;
+
+	mClassCount = 0;
+	mOversizeAllocs = 0;
+
+	//	The smallest class is the first power of two that holds inMinSize
+	for (size = 16; size < inMinSize; size <<= 1)
+		;
+
+	while (size <= inCeiling && mClassCount < kNSpMessagePoolMaxClasses)
+	{
+		SizeClass	*sizeClass = &mClasses[mClassCount++];
+
+		sizeClass->freeList.Init();
+		sizeClass->blockSize = size;
+		sizeClass->blocks = 0;
+		sizeClass->freeBlocks = 0;
+		sizeClass->hits = 0;
+		sizeClass->misses = 0;
+
+		size <<= 1;
+	}
+}
+
+//----------------------------------------------------------------------------------------
+// NSpMessagePool::~NSpMessagePool 
+//----------------------------------------------------------------------------------------
+
+NSpMessagePool::~NSpMessagePool()
+{
+NMLink		*block;
+NMUInt32	i;
+
+	//	Blocks still out with the app or an endpoint are not ours to free
+	for (i = 0; i < mClassCount; i++)
+	{
+		while ((block = mClasses[i].freeList.Dequeue()) != NULL)
+			InterruptSafe_free(block);
+	}
+}
+
+//----------------------------------------------------------------------------------------
+// NSpMessagePool::Alloc 
+//----------------------------------------------------------------------------------------
+
+NSpMessageHeader *
+NSpMessagePool::Alloc(NMUInt32 inSize, NMUInt32 *outCapacity)
+{
+SizeClass	*sizeClass;
+Block		*block;
+NMUInt32	i;
+
+	for (i = 0; i < mClassCount; i++)
+	{
+		if (inSize <= mClasses[i].blockSize)
+			break;
+	}
+
+	if (i == mClassCount)
+	{
+		block = (Block *) InterruptSafe_alloc(kBlockPrefixSize + inSize);
+		if (NULL == block)
+			return (NULL);
+
+		block->sizeClass = kOversizeClass;
+		NMAtomicAdd32(&mOversizeAllocs, 1);
+
+		*outCapacity = inSize;
+		return (BlockToMessage(block));
+	}
 
+	sizeClass = &mClasses[i];
+	block = (Block *) sizeClass->freeList.Dequeue();
+
+	if (NULL != block)
+	{
+		NMAtomicAdd32(&sizeClass->freeBlocks, -1);
+		NMAtomicAdd32(&sizeClass->hits, 1);
+	}
+	else
+	{
+		block = (Block *) InterruptSafe_alloc(kBlockPrefixSize + sizeClass->blockSize);
+		if (NULL == block)
+			return (NULL);
+
+		block->sizeClass = i;
+		NMAtomicAdd32(&sizeClass->blocks, 1);
+		NMAtomicAdd32(&sizeClass->misses, 1);
+	}
+
+	*outCapacity = sizeClass->blockSize;
+	return (BlockToMessage(block));
 }
 
 //----------------------------------------------------------------------------------------
-// SendQItem::AdvanceBuffPtr 
+// NSpMessagePool::Free 
 //----------------------------------------------------------------------------------------
 
 void
-SendQItem::AdvanceBuffPtr(NMUInt32 inBytes)
+NSpMessagePool::Free(NSpMessageHeader *inMessage)
 {
-	mTotalSent += inBytes;
+Block	*block;
+
+	if (NULL == inMessage)
+		return;
+
+	block = MessageToBlock(inMessage);
+
+	if (kOversizeClass == block->sizeClass)
+	{
+		InterruptSafe_free(block);
+		return;
+	}
+
+	op_assert(block->sizeClass < mClassCount);
+
+	//	Count it first, so an Alloc that takes it straight back can't drive the
+	//	count below zero
+	NMAtomicAdd32(&mClasses[block->sizeClass].freeBlocks, 1);
+	mClasses[block->sizeClass].freeList.Enqueue(block);
 }
 
+//----------------------------------------------------------------------------------------
+// NSpMessagePool::GetStats 
+//----------------------------------------------------------------------------------------
+
+void
+NSpMessagePool::GetStats(NSpMessagePoolStats *outStats)
+{
+NMUInt32	i;
+
+	machine_mem_zero(outStats, sizeof (NSpMessagePoolStats));
+
+	outStats->classCount = mClassCount;
+	outStats->oversizeAllocs = mOversizeAllocs;
+
+	for (i = 0; i < mClassCount; i++)
+	{
+		outStats->classes[i].blockSize = mClasses[i].blockSize;
+		outStats->classes[i].blocks = mClasses[i].blocks;
+		outStats->classes[i].freeBlocks = mClasses[i].freeBlocks;
+		outStats->classes[i].hits = mClasses[i].hits;
+		outStats->classes[i].misses = mClasses[i].misses;
+	}
+}
+
+//----------------------------------------------------------------------------------------
+// NSpSendRing::NSpSendRing 
+//----------------------------------------------------------------------------------------
+
+NSpSendRing::NSpSendRing(NMUInt32 inCapacity)
+{
+	//	The buffer itself isn't allocated until something is postponed
+	mBuffer = NULL;
+	mCapacity = Align(inCapacity);
+	mHead = mTail = 0;
+	mUsed = 0;
+	mCount = 0;
+	mHeadSent = 0;
+}
+
+//----------------------------------------------------------------------------------------
+// NSpSendRing::~NSpSendRing 
+//----------------------------------------------------------------------------------------
+
+NSpSendRing::~NSpSendRing()
+{
+	if (mBuffer)
+		InterruptSafe_free(mBuffer);
+}
+
+//----------------------------------------------------------------------------------------
+// NSpSendRing::NextRecord 
+//----------------------------------------------------------------------------------------
+
 NMUInt32
-SendQItem::BytesLeft()
+NSpSendRing::NextRecord(NMUInt32 inOffset)
 {
-	NMUInt32	bytes;
-	
-	bytes = mMessageLength - mTotalSent;
+	inOffset += RecordSize(RecordLength(inOffset));
+
+	//	No room for another prefix, or the writer left a marker: it wrapped
+	if ((mCapacity - inOffset < kRecordPrefix) || (kWrapMarker == RecordLength(inOffset)))
+		inOffset = 0;
 
-	return (bytes);
+	return (inOffset);
 }
 
 //----------------------------------------------------------------------------------------
-// SendQItem::~SendQItem 
+// NSpSendRing::PopRecord 
 //----------------------------------------------------------------------------------------
 
-SendQItem::~SendQItem()
+void
+NSpSendRing::PopRecord(void)
 {
-		
-	if (mData)
-		InterruptSafe_free(mData);
-	
+NMUInt32	next;
+
+	mHeadSent = 0;
+
+	if (0 == --mCount)
+	{
+		mHead = mTail = 0;
+		mUsed = 0;
+		return;
+	}
+
+	next = NextRecord(mHead);
+
+	//	Hand back the slack the writer skipped when it wrapped
+	if (next < mHead)
+		mUsed -= mCapacity - mHead;
+	else
+		mUsed -= next - mHead;
+
+	mHead = next;
+}
+
+//----------------------------------------------------------------------------------------
+// NSpSendRing::Grow 
+//----------------------------------------------------------------------------------------
+
+NMBoolean
+NSpSendRing::Grow(NMUInt32 inCapacity)
+{
+NMUInt8		*buffer;
+NMUInt32	offset, size, tail, i;
+
+	inCapacity = Align(inCapacity);
+
+	buffer = (NMUInt8 *) InterruptSafe_alloc(inCapacity);
+	if (NULL == buffer)
+		return (false);
+
+	//	Lay the queued records out from the front of the new buffer
+	tail = 0;
+	for (i = 0, offset = mHead; i < mCount; i++, offset = NextRecord(offset))
+	{
+		size = RecordSize(RecordLength(offset));
+		machine_move_data(mBuffer + offset, buffer + tail, size);
+		tail += size;
+	}
+
+	if (mBuffer)
+		InterruptSafe_free(mBuffer);
+
+	mBuffer = buffer;
+	mCapacity = inCapacity;
+	mHead = 0;
+	mTail = tail;
+	mUsed = tail;
+
+	return (true);
+}
+
+//----------------------------------------------------------------------------------------
+// NSpSendRing::Reserve 
+// Makes inRecordSize contiguous bytes available at mTail, wrapping if need be.
+//----------------------------------------------------------------------------------------
+
+NMBoolean
+NSpSendRing::Reserve(NMUInt32 inRecordSize)
+{
+NMUInt32	atEnd;
+
+	if (NULL == mBuffer)
+	{
+		mBuffer = (NMUInt8 *) InterruptSafe_alloc(mCapacity);
+		if (NULL == mBuffer)
+			return (false);
+	}
+
+	if ((0 == mCount) || (mTail > mHead))
+	{
+		atEnd = mCapacity - mTail;
+
+		if (inRecordSize <= atEnd)
+			return (true);
+
+		//	Wrap to the front, if the oldest record has moved far enough along
+		if ((mCount > 0) && (inRecordSize <= mHead))
+		{
+			if (atEnd >= kRecordPrefix)
+				*(NMUInt32 *) (mBuffer + mTail) = kWrapMarker;
+
+			mUsed += atEnd;
+			mTail = 0;
+
+			return (true);
+		}
+
+		return (false);
+	}
+
+	//	Already wrapped; the gap runs up to the oldest record
+	return (inRecordSize <= mHead - mTail);
+}
+
+//----------------------------------------------------------------------------------------
+// NSpSendRing::Append 
+//----------------------------------------------------------------------------------------
+
+NMBoolean
+NSpSendRing::Append(const NMIOVec *inVectors, NMUInt32 inCount, NMBoolean inForce)
+{
+NMUInt32	length = 0;
+NMUInt32	size, offset, i;
+
+	for (i = 0; i < inCount; i++)
+		length += inVectors[i].length;
+
+	size = RecordSize(length);
+
+	if (0 == mCount)
+		mHead = mTail = 0;
+
+	if (false == Reserve(size))
+	{
+		if (!inForce || !Grow(mUsed + size > mCapacity * 2 ? mUsed + size : mCapacity * 2))
+			return (false);
+
+		if (false == Reserve(size))
+			return (false);
+	}
+
+	*(NMUInt32 *) (mBuffer + mTail) = length;
+
+	for (i = 0, offset = mTail + kRecordPrefix; i < inCount; i++)
+	{
+		machine_move_data(inVectors[i].data, mBuffer + offset, inVectors[i].length);
+		offset += inVectors[i].length;
+	}
+
+	mTail += size;
+	mUsed += size;
+	mCount++;
+
+	return (true);
+}
+
+//----------------------------------------------------------------------------------------
+// NSpSendRing::Peek 
+// Fills in up to inMax vectors with the unsent part of the oldest records.
+//----------------------------------------------------------------------------------------
+
+NMUInt32
+NSpSendRing::Peek(NMIOVec *outVectors, NMUInt32 inMax)
+{
+NMUInt32	i, offset;
+
+	for (i = 0, offset = mHead; (i < mCount) && (i < inMax); i++, offset = NextRecord(offset))
+	{
+		outVectors[i].data = mBuffer + offset + kRecordPrefix;
+		outVectors[i].length = RecordLength(offset);
+	}
+
+	if (i > 0)
+	{
+		outVectors[0].data = (NMUInt8 *) outVectors[0].data + mHeadSent;
+		outVectors[0].length -= mHeadSent;
+	}
+
+	return (i);
+}
+
+//----------------------------------------------------------------------------------------
+// NSpSendRing::Consume 
+// Retires inBytes from the front, popping each record once all of it has gone.
+//----------------------------------------------------------------------------------------
+
+void
+NSpSendRing::Consume(NMUInt32 inBytes)
+{
+NMUInt32	left;
+
+	while ((inBytes > 0) && (mCount > 0))
+	{
+		left = RecordLength(mHead) - mHeadSent;
+
+		if (inBytes < left)
+		{
+			mHeadSent += inBytes;
+			return;
+		}
+
+		inBytes -= left;
+		PopRecord();
+	}
 }
 
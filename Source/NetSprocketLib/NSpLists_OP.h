@@ -71,18 +71,140 @@
 		NMUInt32	mValue;
 	};
 
-	class SendQItem : public NMLink
+	//	Maps a player or group id to its list member so lookups don't have to walk
+	//	the list.  Open addressing over a power-of-two table; a table that is
+	//	outgrown is retired rather than freed, so a lookup racing a resize still
+	//	reads valid memory.  Retired tables are released once no lookup is in
+	//	flight.  When tombstones rather than live entries fill the table it is
+	//	rebuilt in place, and lookups that overlap the rebuild go around again.
+	//	Players leave on the notifier and join on the app thread, so changes to
+	//	the table are made one at a time under mWriteLock; lookups don't take it.
+	class NSpIDTable
 	{
 	public:
-		SendQItem(void *inData, NMUInt32 inBytesSent);
-		~SendQItem();
-		
-		void	AdvanceBuffPtr(NMUInt32 inBytes);
-		NMUInt32	BytesLeft();
-		
-		void			*mData;
-		NMUInt32 		mMessageLength;
-		NMUInt32		mTotalSent;
+		NSpIDTable();
+		~NSpIDTable();
+
+		NMBoolean	Add(NMSInt32 inID, NSp_InterruptSafeListMember *inItem);
+		NMBoolean	Remove(NMSInt32 inID);
+		void		RemoveAll(void);
+		NSp_InterruptSafeListMember	*Find(NMSInt32 inID);
+
+		inline NMUInt32	Count(void) {return mCount;}
+
+	protected:
+		struct Slot
+		{
+			NMSInt32					id;
+			NSp_InterruptSafeListMember	*item;
+		};
+
+		struct Table
+		{
+			NMUInt32	mask;
+			Table		*retired;
+			Slot		slots[1];
+		};
+
+		NMBoolean	Resize(NMUInt32 inCapacity);
+		void		Rehash(void);
+		void		ReleaseRetired(void);
+
+		Table		*mTable;
+		NMUInt32	mCount;
+		NMUInt32	mUsed;		// live entries plus tombstones
+		volatile NMSInt32	mReaders;		// lookups in flight
+		volatile NMSInt32	mGeneration;	// odd while a rebuild is under way
+		machine_lock	mWriteLock;
+	};
+
+	//	Backs messages bigger than gStandardMessageSize.  Requests are rounded up
+	//	to a power-of-two size class and freed blocks go back on that class's
+	//	list, so once the lists have filled a game stops touching the heap.
+	//	Each block carries a small prefix naming its class; anything above the
+	//	ceiling gets a one-off allocation with an oversize prefix instead.
+	class NSpMessagePool
+	{
+	public:
+		NSpMessagePool(NMUInt32 inMinSize, NMUInt32 inCeiling);
+		~NSpMessagePool();
+
+		NSpMessageHeader	*Alloc(NMUInt32 inSize, NMUInt32 *outCapacity);
+		void				Free(NSpMessageHeader *inMessage);
+		void				GetStats(NSpMessagePoolStats *outStats);
+
+	protected:
+		enum
+		{
+			kOversizeClass = 0xFFFFFFFF
+		};
+
+		class Block : public NMLink
+		{
+		public:
+			NMUInt32	sizeClass;
+		};
+
+		//	Notifier threads and the app thread both allocate and free, so the
+		//	counts are only changed with atomic adds
+		struct SizeClass
+		{
+			NMLIFO		freeList;
+			NMUInt32	blockSize;
+			volatile NMSInt32	blocks;
+			volatile NMSInt32	freeBlocks;
+			volatile NMSInt32	hits;
+			volatile NMSInt32	misses;
+		};
+
+		SizeClass	mClasses[kNSpMessagePoolMaxClasses];
+		NMUInt32	mClassCount;
+		volatile NMSInt32	mOversizeAllocs;
+	};
+
+	//	Backlog of postponed sends, kept as length-prefixed records in one
+	//	contiguous ring so queueing is a copy with no allocation or list walk.
+	//	A record never straddles the end of the buffer; if it won't fit there the
+	//	writer wraps to the front.  The ring is bounded by its capacity, except
+	//	that a forced append (the tail of a half-sent stream message, which can't
+	//	be dropped) grows it.  Not thread-safe; callers hold the SendInfo's QLock.
+	class NSpSendRing
+	{
+	public:
+		NSpSendRing(NMUInt32 inCapacity);
+		~NSpSendRing();
+
+		NMBoolean	Append(const NMIOVec *inVectors, NMUInt32 inCount, NMBoolean inForce = false);
+		NMUInt32	Peek(NMIOVec *outVectors, NMUInt32 inMax);
+		void		Consume(NMUInt32 inBytes);
+
+		inline NMBoolean	IsEmpty(void) {return (0 == mCount);}
+		inline NMUInt32		Count(void) {return mCount;}
+
+	protected:
+		enum
+		{
+			kRecordPrefix = sizeof (NMUInt32),
+			kWrapMarker = 0xFFFFFFFF
+		};
+
+		NMBoolean	Reserve(NMUInt32 inRecordSize);
+		NMBoolean	Grow(NMUInt32 inCapacity);
+		NMUInt32	NextRecord(NMUInt32 inOffset);
+		void		PopRecord(void);
+
+		inline NMUInt32	RecordLength(NMUInt32 inOffset) {return *(NMUInt32 *) (mBuffer + inOffset);}
+		//	Records start on a prefix boundary so every length is read aligned
+		inline NMUInt32	Align(NMUInt32 inBytes) {return (inBytes + kRecordPrefix - 1) & ~(kRecordPrefix - 1);}
+		inline NMUInt32	RecordSize(NMUInt32 inLength) {return Align(kRecordPrefix + inLength);}
+
+		NMUInt8		*mBuffer;
+		NMUInt32	mCapacity;
+		NMUInt32	mHead;		// offset of the oldest record
+		NMUInt32	mTail;		// offset the next record is written at
+		NMUInt32	mUsed;		// bytes taken, including prefixes, padding and wrap slack
+		NMUInt32	mCount;		// records queued
+		NMUInt32	mHeadSent;	// bytes of the oldest record already sent
 	};
 
 #endif // __NSPLISTS__
@@ -76,6 +76,8 @@ enum
 
 static NMNumVersion		gVersion;
 NMUInt32				gEndpointConnectTimeout = 0;
+NMUInt32				gMessagePoolCeiling = kNSpDefaultMessagePoolCeiling;
+NMUInt32				gSendBacklogSize = kNSpDefaultSendBacklogSize;
 
 // These globals are initialized on a per-library-connection basis
 
@@ -1027,6 +1029,26 @@ NSpGame_GetInfo(NSpGameReference inGame, NSpGameInfo  *ioInfo)
 	return (kNMNoError);
 }
 
+//----------------------------------------------------------------------------------------
+// NSpGame_Flush
+//----------------------------------------------------------------------------------------
+
+NMErr
+NSpGame_Flush(NSpGameReference inGame)
+{
+	NSpGamePrivate	*theGame = (NSpGamePrivate *)inGame;
+	NSpGame			*game;
+	
+	op_vassert_return(NULL != inGame, "NSpGame_Flush: inGame == NULL", kNSpInvalidGameRefErr);
+
+	game = theGame->GetGameObject();
+
+	if (NULL == game)
+		return (kNSpInvalidGameRefErr);
+		
+	return (game->Flush());
+}
+
 #if defined(__MWERKS__)
 #pragma mark === Messaging ===
 #endif
@@ -1139,6 +1161,58 @@ NSpMessage_Get(NSpGameReference inGame)
 	return (theMessage);
 }
 
+//----------------------------------------------------------------------------------------
+// NSpMessage_GetBorrowed
+//----------------------------------------------------------------------------------------
+
+NSpMessageHeader *
+NSpMessage_GetBorrowed(NSpGameReference inGame)
+{
+	NSpGamePrivate		*theGame = (NSpGamePrivate *)inGame;
+	NSpMessageHeader	*theMessage = NULL;
+	
+	op_vassert_return(NULL != inGame, "NSpMessage_GetBorrowed: inGame == NULL", NULL);
+
+	if (false == theGame->NSpMessage_Get(&theMessage, true))
+		theMessage = NULL;
+
+#ifdef OP_API_NETWORK_OT
+		UpkeepOTMemoryReserve();
+#endif
+	
+	return (theMessage);
+}
+
+//----------------------------------------------------------------------------------------
+// NSpMessage_Retain
+//----------------------------------------------------------------------------------------
+
+NMErr
+NSpMessage_Retain(NSpGameReference inGame, NSpMessageHeader *inMessage)
+{
+	NSpGamePrivate	*theGame = (NSpGamePrivate *)inGame;
+
+	op_vassert_return(NULL != inGame, "NSpMessage_Retain: inGame == NULL", kNSpInvalidGameRefErr);
+	op_vassert_return(NULL != inMessage, "NSpMessage_Retain: inMessage == NULL", kNSpInvalidParameterErr);
+
+	return ((theGame->GetGameObject())->RetainBorrowedMessage(inMessage));
+}
+
+//----------------------------------------------------------------------------------------
+// NSpMessage_Return
+//----------------------------------------------------------------------------------------
+
+NMErr
+NSpMessage_Return(NSpGameReference inGame, NSpMessageHeader *inMessage)
+{
+	NSpGamePrivate	*theGame = (NSpGamePrivate *)inGame;
+
+	op_vassert_return(NULL != inGame, "NSpMessage_Return: inGame == NULL", kNSpInvalidGameRefErr);
+	op_vassert_return(NULL != inMessage, "NSpMessage_Return: inMessage == NULL", kNSpInvalidParameterErr);
+
+	return ((theGame->GetGameObject())->ReturnBorrowedMessage(inMessage));
+}
+
 //----------------------------------------------------------------------------------------
 // NSpMessage_GetBacklog
 //----------------------------------------------------------------------------------------
@@ -1147,9 +1221,31 @@ NMUInt32
 NSpMessage_GetBacklog( NSpGameReference inGame )
 {
 	NSpGamePrivate	*theGame = (NSpGamePrivate *)inGame;
-	NSpGameMaster *game = theGame->GetMaster();
 
-	return game->GetBacklog();
+	op_vassert_return(NULL != inGame, "NSpMessage_GetBacklog: inGame == NULL", 0);
+
+	//	A joiner has no master object; its backlog is on the link to the host
+	if (theGame->GetMaster())
+		return theGame->GetMaster()->GetBacklog();
+
+	return theGame->GetSlave()->GetBacklog();
+}
+
+//----------------------------------------------------------------------------------------
+// NSpMessage_GetPoolStats
+//----------------------------------------------------------------------------------------
+
+NMErr
+NSpMessage_GetPoolStats(NSpGameReference inGame, NSpMessagePoolStats *outStats)
+{
+	NSpGamePrivate	*theGame = (NSpGamePrivate *)inGame;
+
+	op_vassert_return(NULL != inGame, "NSpMessage_GetPoolStats: inGame == NULL", kNSpInvalidGameRefErr);
+	op_vassert_return(NULL != outStats, "NSpMessage_GetPoolStats: outStats == NULL", kNSpInvalidParameterErr);
+
+	(theGame->GetGameObject())->GetPoolStats(outStats);
+
+	return (kNMNoError);
 }
 
 //----------------------------------------------------------------------------------------
@@ -1273,15 +1369,37 @@ NSpPlayer_ReleaseEnumeration(NSpGameReference inGame, NSpPlayerEnumerationPtr in
 NMSInt32
 NSpPlayer_GetRoundTripTime(NSpGameReference inGame, NSpPlayerID inPlayer)
 {
-	UNUSED_PARAMETER(inPlayer);
-
-//NSpGamePrivate	*theGame = (NSpGamePrivate *)inGame;
+NSpGamePrivate	*theGame = (NSpGamePrivate *)inGame;
+NSpGame			*game;
 	
 	op_vassert_return(NULL != inGame, "NSpPlayer_GetRoundTripTime: inGame == NULL", kNSpInvalidGameRefErr);
 
-	return (kNSpFeatureNotImplementedErr);
+	game = theGame->GetGameObject();
+
+	if (NULL == game)
+		return (kNSpInvalidGameRefErr);
+
+	return (game->GetRTT(inPlayer));
+}
+
+//----------------------------------------------------------------------------------------
+// NSpPlayer_GetRoundTripJitter
+//----------------------------------------------------------------------------------------
+
+NMSInt32
+NSpPlayer_GetRoundTripJitter(NSpGameReference inGame, NSpPlayerID inPlayer)
+{
+NSpGamePrivate	*theGame = (NSpGamePrivate *)inGame;
+NSpGame			*game;
 	
-//	return theGame->GetRTT(inPlayer);
+	op_vassert_return(NULL != inGame, "NSpPlayer_GetRoundTripJitter: inGame == NULL", kNSpInvalidGameRefErr);
+
+	game = theGame->GetGameObject();
+
+	if (NULL == game)
+		return (kNSpInvalidGameRefErr);
+
+	return (game->GetRTT(inPlayer, true));
 }
 
 //----------------------------------------------------------------------------------------
@@ -1291,16 +1409,17 @@ NSpPlayer_GetRoundTripTime(NSpGameReference inGame, NSpPlayerID inPlayer)
 NMSInt32
 NSpPlayer_GetThruput(NSpGameReference inGame, NSpPlayerID inPlayer)
 {
-	UNUSED_PARAMETER(inPlayer);
-
-//NMErr	 	err = kNMNoError;
-//NSpGamePrivate	*theGame = (NSpGamePrivate *)inGame;
+NSpGamePrivate	*theGame = (NSpGamePrivate *)inGame;
+NSpGame			*game;
 	
 	op_vassert_return(NULL != inGame, "NSpPlayer_GetThruput: inGame == NULL", kNSpInvalidGameRefErr);
 
-	return (kNSpFeatureNotImplementedErr);
+	game = theGame->GetGameObject();
+
+	if (NULL == game)
+		return (kNSpInvalidGameRefErr);
 
-//	return theGame->GetThruput(inPlayer);
+	return (game->GetThruput(inPlayer));
 }
 
 //----------------------------------------------------------------------------------------
@@ -1533,6 +1652,28 @@ NSpSetConnectTimeout(NMUInt32 inSeconds)
 	gEndpointConnectTimeout = inSeconds;
 }
 
+//----------------------------------------------------------------------------------------
+// NSpSetMessagePoolCeiling
+//----------------------------------------------------------------------------------------
+
+void
+NSpSetMessagePoolCeiling(NMUInt32 inMaxMessageSize)
+{
+	//	Only games created after this call pick up the new ceiling
+	gMessagePoolCeiling = inMaxMessageSize;
+}
+
+//----------------------------------------------------------------------------------------
+// NSpSetSendBacklogSize
+//----------------------------------------------------------------------------------------
+
+void
+NSpSetSendBacklogSize(NMUInt32 inBytes)
+{
+	//	Only endpoints created after this call pick up the new size
+	gSendBacklogSize = inBytes;
+}
+
 //----------------------------------------------------------------------------------------
 // NSpClearMessageHeader
 //----------------------------------------------------------------------------------------
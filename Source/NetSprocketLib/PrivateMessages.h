@@ -90,6 +90,23 @@
 	typedef NSpMessageHeader	TPauseGameMessage;
 	typedef NSpMessageHeader	TResumeGameMessage;
 
+	//	Pings carry the sender's clock, plus an echo of the last ping received from
+	//	the peer and how long it was held, so each side's ping doubles as the other's reply.
+	//	bytesReceived is the running count of bytes the sender has received from the peer.
+	typedef struct TRTTPingMessage
+	{
+		NSpMessageHeader	header;
+		NMUInt32			flags;
+		NMUInt32			stamp;
+		NMUInt32			echoStamp;
+		NMUInt32			echoDelay;
+		NMUInt32			bytesReceived;
+	} TRTTPingMessage;
+
+	enum { kRTTHasEcho = 0x00000001};
+
+	//	For kThruputPing, count is the probe's place in its burst; for
+	//	kThruputPingReply, it is the rate the burst arrived at, in bytes per second.
 	typedef struct TThruputMessage
 	{
 		NSpMessageHeader	header;
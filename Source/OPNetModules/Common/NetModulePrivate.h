@@ -85,6 +85,11 @@
 		kNMLeaveNotifier,
 
 		kNMGetIdentifier,
+
+		/* Optional vectored data functions (may be NULL) */
+		kNMSendDatagramv,
+		kNMSendv,
+		kNMSendDatagrams,
         
 		NUMBER_OF_MODULE_FUNCTIONS
 	};
@@ -136,7 +141,11 @@
 			"NMEnterNotifier",
 			"NMLeaveNotifier",
 			
-			"NMGetIdentifier"
+			"NMGetIdentifier",
+
+			"NMSendDatagramv",
+			"NMSendv",
+			"NMSendDatagrams"
 		};
 
 		#define NUMBER_OF_MODULES_TO_LOAD (sizeof (module_names) / sizeof (module_names[0]))
@@ -186,6 +195,9 @@ extern "C" {
 	typedef NMErr		(*NMReceiveDatagramPtr)(NMEndpointRef inEndpoint, unsigned char * outData, NMUInt32 *outSize, NMFlags *outFlags);
 	typedef NMErr		(*NMSendPtr)(NMEndpointRef inEndpoint, void *inData, NMUInt32 inSize, NMFlags inFlags);
 	typedef NMErr		(*NMReceivePtr)(NMEndpointRef inEndpoint, void *outData, NMUInt32 *ioSize, NMFlags *outFlags);
+	typedef NMErr		(*NMSendDatagramvPtr)(NMEndpointRef inEndpoint, const NMIOVec *inVectors, NMUInt32 inCount, NMFlags inFlags);
+	typedef NMErr		(*NMSendvPtr)(NMEndpointRef inEndpoint, const NMIOVec *inVectors, NMUInt32 inCount, NMFlags inFlags);
+	typedef NMErr		(*NMSendDatagramsPtr)(NMEndpointRef inEndpoint, const NMIOVec *inPackets, NMUInt32 inCount, NMUInt32 *outSent, NMFlags inFlags);
 
 	/* Enter/Leave Notifier Functions */
 	typedef NMErr		(*NMEnterNotifierPtr)(NMEndpointRef inEndpoint, NMEndpointMode endpointMode);
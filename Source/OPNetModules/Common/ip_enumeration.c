@@ -171,3 +171,63 @@ IPEnumerationResponsePacket	*packet = (IPEnumerationResponsePacket *) buffer;
 
 	return (buffer + sizeof (IPEnumerationResponsePacket));
 }
+
+//----------------------------------------------------------------------------------------
+// append_ip_enumeration_extension
+//----------------------------------------------------------------------------------------
+
+/* adds an IPEnumerationResponseExtension (in network order) to a response of length bytes, */
+/* after any custom data, and returns the new length */
+NMSInt32
+append_ip_enumeration_extension(char *buffer, NMSInt32 length, NMUInt32 hostKey)
+{
+IPEnumerationResponseExtension	extension;
+
+	extension.extensionCode = kReplyExtensionFlag;
+	extension.extensionVersion = kReplyExtensionVersion;
+	extension.hostKey = hostKey;
+	extension.reserved = 0;
+
+#if (little_endian)
+	extension.extensionCode = SWAP4(extension.extensionCode);
+	extension.extensionVersion = SWAP4(extension.extensionVersion);
+	extension.hostKey = SWAP4(extension.hostKey);
+#endif
+
+	/* it needn't land on an aligned boundary, so we copy it in whole */
+	machine_copy_data((char *) &extension, buffer + length, sizeof (IPEnumerationResponseExtension));
+
+	return length + sizeof (IPEnumerationResponseExtension);
+}
+
+//----------------------------------------------------------------------------------------
+// get_ip_enumeration_host_key
+//----------------------------------------------------------------------------------------
+
+/* looks past the custom data of a (byteswapped) response of length bytes for an extension, */
+/* returning true and its hostKey if there is one */
+NMBoolean
+get_ip_enumeration_host_key(char *buffer, NMSInt32 length, NMUInt32 *hostKey)
+{
+IPEnumerationResponsePacket		*packet = (IPEnumerationResponsePacket *) buffer;
+IPEnumerationResponseExtension	extension;
+NMUInt32						offset = sizeof (IPEnumerationResponsePacket) + packet->customEnumDataLen;
+
+	if ((length < 0) || (packet->customEnumDataLen > (NMUInt32) length)
+		|| (offset + sizeof (IPEnumerationResponseExtension) > (NMUInt32) length))
+		return false;
+
+	machine_copy_data(buffer + offset, (char *) &extension, sizeof (IPEnumerationResponseExtension));
+
+#if (little_endian)
+	extension.extensionCode = SWAP4(extension.extensionCode);
+	extension.extensionVersion = SWAP4(extension.extensionVersion);
+	extension.hostKey = SWAP4(extension.hostKey);
+#endif
+
+	if ((extension.extensionCode != kReplyExtensionFlag) || (extension.extensionVersion < 1))
+		return false;
+
+	*hostKey = extension.hostKey;
+	return true;
+}
@@ -35,7 +35,9 @@
 		kReplyFlag      = 0xAFBFCFDF,
 		kQuerySize      = 512,
 		kMaxGameNameLen = 31, 
-		kNMEnumDataLen  = 1024		//dair, increase data size from 256
+		kNMEnumDataLen  = 1024,		//dair, increase data size from 256
+		kReplyExtensionFlag    = 0xDFCFBFAF,
+		kReplyExtensionVersion = 1
 	};
 
 	typedef struct IPEnumerationResponsePacket
@@ -50,6 +52,17 @@
 		NMUInt32	customEnumDataLen;
 	} IPEnumerationResponsePacket;
 
+	//newer hosts follow the custom data with this, which older clients never look past.
+	//the host field above only holds an IPv4 address, so clients that find this use hostKey to
+	//tell hosts apart instead - and to spot one host answering over both IPv4 and IPv6
+	typedef struct IPEnumerationResponseExtension
+	{
+		NMUInt32	extensionCode;		//kReplyExtensionFlag
+		NMUInt32	extensionVersion;	//kReplyExtensionVersion; later versions may be longer
+		NMUInt32	hostKey;			//the same in every answer a host gives
+		NMUInt32	reserved;
+	} IPEnumerationResponseExtension;
+
 //	------------------------------	Public Functions
 
 
@@ -73,6 +86,10 @@ extern "C" {
 		
 	extern void *     extract_enumeration_data_from_ip_response(char *buffer);
 
+	extern NMSInt32   append_ip_enumeration_extension(char *buffer, NMSInt32 length, NMUInt32 hostKey);
+
+	extern NMBoolean  get_ip_enumeration_host_key(char *buffer, NMSInt32 length, NMUInt32 *hostKey);
+
 #ifdef __cplusplus
 }
 #endif
@@ -221,6 +221,27 @@ extern "C" {
 								NMUInt32 *			ioSize,
 								NMFlags *			outFlags);
 
+	/* Optional vectored data functions */
+
+		OP_DEFINE_API_C(NMErr)
+		NMSendDatagramv		(	NMEndpointRef 		inEndpoint, 
+								const NMIOVec *		inVectors, 
+								NMUInt32			inCount, 
+								NMFlags				inFlags);
+
+		OP_DEFINE_API_C(NMErr)
+		NMSendv				(	NMEndpointRef 		inEndpoint, 
+								const NMIOVec *		inVectors, 
+								NMUInt32			inCount,
+								NMFlags 			inFlags);
+
+		OP_DEFINE_API_C(NMErr)
+		NMSendDatagrams		(	NMEndpointRef 		inEndpoint, 
+								const NMIOVec *		inPackets, 
+								NMUInt32			inCount,
+								NMUInt32 *			outSent,
+								NMFlags 			inFlags);
+
 	/* Dialog functions */
 
 		OP_DEFINE_API_C(void)
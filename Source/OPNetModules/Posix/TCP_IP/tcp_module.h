@@ -35,16 +35,19 @@
 	#endif
 	
 #ifdef OP_API_NETWORK_WINSOCK
-	#include <winsock.h>
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
 #elif defined(OP_API_NETWORK_SOCKETS)
 	#include <sys/types.h>
 	#include <sys/socket.h>
+	#include <sys/uio.h>
 	#include <netinet/in.h>
 	#include <netinet/tcp.h>
 	#include <arpa/inet.h>
 	#include <netdb.h>
 	#include <unistd.h>
 	#include <errno.h>
+	#include <pthread.h>
 #endif
 
 	#include "NetModulePrivate.h"
@@ -84,9 +87,89 @@
 	// without a worker thread, message retrieval is dependant on NMIdle() calls
 	#define USE_WORKER_THREAD 1
 
+	// on linux we watch endpoint sockets with an edge-triggered epoll() set instead of
+	// rebuilding select() sets on every pass; build with -DUSE_EPOLL=0 to use select() anyway
+	#ifndef USE_EPOLL
+		#if defined(OP_API_NETWORK_SOCKETS) && (defined(linux) || defined(__linux__))
+			#define USE_EPOLL 1
+		#else
+			#define USE_EPOLL 0
+		#endif
+	#endif
+
+	#if (USE_EPOLL)
+		#include <sys/epoll.h>
+	#endif
+
+	// on linux datagrams are read with recvmmsg() and written with sendmmsg() a batch at a time
+	// instead of one syscall apiece; build with -DUSE_MMSG=0 to use recv()/send() anyway
+	#ifndef USE_MMSG
+		#if defined(OP_API_NETWORK_SOCKETS) && (defined(linux) || defined(__linux__))
+			#define USE_MMSG 1
+		#else
+			#define USE_MMSG 0
+		#endif
+	#endif
+
+	// endpoints are split between a pool of worker threads, one by default.
+	// set this environment variable to a larger count before loading the module to use more
+	#define kWorkerShardCountVariable "OPENPLAY_TCP_WORKERS"
+	#define MAXIMUM_WORKER_SHARDS (16)
+
+	// callbacks are held off per endpoint and mode by ProtocolEnterNotifier(). the locks live in a table
+	// of this many per mode, picked by endpoint address, so they outlive endpoints closed from a callback
+	#define NOTIFIER_LOCK_STRIPES (64)
+
+	// closed endpoints (and their receive buffers) are kept for reuse rather than freed, so a burst of
+	// joiners doesn't go through the allocator. this many are made up front - set the environment
+	// variable to change it - and up to the maximum are kept, however many are made
+	#define kEndpointPoolSizeVariable "OPENPLAY_TCP_ENDPOINT_POOL"
+	#define DEFAULT_ENDPOINT_POOL_SIZE (16)
+	#define MAXIMUM_ENDPOINT_POOL_SIZE (256)
+
+	// stream data is pulled off the socket this much at a time, and handed out from there by NMReceive
+	#define STREAM_RECEIVE_BUFFER_SIZE (16 * 1024)
+
+	// vectored sends with more pieces than this are gathered into one buffer instead
+	#define MAXIMUM_SEND_VECTORS (16)
+
+	// datagrams are read (and batched sends written) up to this many per syscall. each one read gets a
+	// slot this big - well past the maxPacketSize we advertise - and anything that doesn't fit is dropped
+	#define DATAGRAM_BATCH_SIZE (16)
+	#define DATAGRAM_SLOT_SIZE (8 * 1024)
+
+	// long enough for any IPv6 address in text, scope and all
+	#define kMaxAddressStringLength (64)
+
 	#define kIPConfigAddress  "IPaddr"
 	#define kIPConfigPort     "IPport"
 
+	// stream and socket buffer tuning; see NMSocketOptions
+	#define kIPConfigNoDelay        "IPnodelay"
+	#define kIPConfigCork           "IPcork"
+	#define kIPConfigSendBuffer     "IPsndbuf"
+	#define kIPConfigReceiveBuffer  "IPrcvbuf"
+
+	// with this set, NMOpen returns as soon as the sockets are made and reports the outcome with kNMOpenComplete
+	#define kIPConfigAsyncOpen      "IPasync"
+
+	// with this set, the first worker thread reads enumeration replies, sends the requests and calls back with
+	// kNMEnumAdd/kNMEnumDelete itself - NMIdleEnumeration has nothing left to do. it looks at its enumerations
+	// this often, and makes all the callbacks it has news for at once
+	#define kIPConfigBackgroundEnumeration "IPbgenum"
+	#define ENUMERATION_POLL_INTERVAL_MSEC (50)
+
+	// how long an open has to complete, and how often the worker checks on opens that have gone quiet
+	#define OPEN_TIMEOUT_TICKS (10 * MACHINE_TICKS_PER_SECOND)
+	#define OPEN_CHECK_INTERVAL_MSEC (250)
+
+	// host names are looked up on up to this many resolver threads for asynchronous opens, and the
+	// answers (found or not) are remembered this long, in a cache of this many names
+	#define MAXIMUM_RESOLVER_THREADS (4)
+	#define RESOLVER_CACHE_SIZE (32)
+	#define RESOLVER_TTL_TICKS (60 * MACHINE_TICKS_PER_SECOND)
+	#define RESOLVER_NEGATIVE_TTL_TICKS (5 * MACHINE_TICKS_PER_SECOND)
+
 	#ifndef INVALID_SOCKET
 		#define INVALID_SOCKET (-1)
 	#endif
@@ -122,12 +205,30 @@
 
 	
 	/* passthrough functions */
+	/* the socket option selectors take a pointer to a long holding the new value, and apply it to the */
+	/* endpoint's open sockets right away as well as to any it opens later */
 	enum {
-	  _pass_through_set_debug_proc = 0x64656267  /* hex for "debg" */
+	  _pass_through_set_debug_proc = 0x64656267,  /* hex for "debg" */
+	  _pass_through_set_no_delay = 0x6e646c79,  /* hex for "ndly" - nonzero turns off Nagle's algorithm */
+	  _pass_through_set_cork = 0x636f726b,  /* hex for "cork" - nonzero holds back partial segments; zero sends them */
+	  _pass_through_set_send_buffer = 0x73627566,  /* hex for "sbuf" - SO_SNDBUF in bytes, zero for the system default */
+	  _pass_through_set_receive_buffer = 0x72627566  /* hex for "rbuf" - SO_RCVBUF in bytes, zero for the system default */
+	};
+
+	//socket options applied to every socket an endpoint opens or accepts.
+	//they come from the config string, are inherited by accepted endpoints, and can be changed by passthrough.
+	//latency-sensitive endpoints want noDelay (the default); bulk endpoints may prefer cork and bigger buffers
+	struct NMSocketOptions {
+		NMBoolean noDelay; //TCP_NODELAY on the stream socket
+		NMBoolean cork; //TCP_CORK (TCP_NOPUSH on BSD) on the stream socket, where there is one
+		long sendBufferSize; //SO_SNDBUF, or zero to leave the system default alone
+		long receiveBufferSize; //SO_RCVBUF, or zero to leave the system default alone
 	};
 
 	typedef int (*status_proc_ptr)(const char *format, ...);
 
+	struct NMWorkerShard;
+
 	struct 	NMEndpointPriv {
 		NMEndpointRef next; //we're in a linked list
 		NMEndpointRef parent; //if we were spawned from a host endpoint
@@ -141,13 +242,13 @@
 		long connectionMode;
 		NMBoolean		advertising;
 		NMBoolean 		netSprocketMode;	
-		sockaddr_in remoteAddress; //in netsprocket mode we need to store the address for datagram sending	
+		struct sockaddr_storage remoteAddress; //in netsprocket mode we need to store the address for datagram sending	
 		long valid_endpoints;
 		NMEndpointCallbackFunction *callback;
 		void *user_context;
 		NMBoolean dynamically_assign_remote_udp_port;
 		char name[kMaxGameNameLen+1];
-		long host;
+		long host; //our IPv4 address (host order) if we have one
 		word port;
 #ifdef OP_API_NETWORK_SOCKETS
 		int sockets[NUMBER_OF_SOCKETS];
@@ -158,10 +259,77 @@
 #endif		
 		NMBoolean flowBlocked[NUMBER_OF_SOCKETS];
 		NMBoolean newDataCallbackSent[NUMBER_OF_SOCKETS];
+		long deferredEvents[NUMBER_OF_SOCKETS]; //socket events that came in while they had the notifier, for next pass
+		struct NMSocketOptions socketOptions;
 		status_proc_ptr status_proc;
 		NMBoolean active;
 		NMBoolean listener;
+		NMBoolean opening; //NMOpen hasn't seen us complete yet; the worker clears this once we have, one way or the other
+		NMBoolean asyncOpen; //the worker finishes us off and calls back with kNMOpenComplete, rather than NMOpen waiting
+		NMUInt32 openDeadline; //machine_tick_count() at which opening gives up
+		char *resolveName; //while set, our host name is with the resolver and we have no sockets yet
+		unsigned short resolvePort; //(network order) the port to go with it
 		NMErr opening_error;
+		struct NMWorkerShard *shard; //the worker that watches our sockets and calls us back
+		char *receiveBuffer; //stream data we've read from the socket but not yet handed out
+		unsigned long receiveOffset;
+		unsigned long receiveCount;
+		NMBoolean receivePending; //theres buffered stream data or datagrams we need to tell them about
+#if (USE_MMSG)
+		char *datagramBuffer; //DATAGRAM_BATCH_SIZE slots of datagrams read in one go but not yet handed out
+		unsigned long datagramLength[DATAGRAM_BATCH_SIZE];
+		int datagramSlot[DATAGRAM_BATCH_SIZE]; //which slot each waiting datagram is in, in arrival order
+		int datagramNext;
+		int datagramCount;
+#endif
+	};
+
+	//each worker owns a shard of the endpoints, along with everything needed to wait on them.
+	//an endpoint stays on the shard it was opened on, so its callbacks always come from the same thread
+	struct NMWorkerShard {
+		NMEndpointPriv *endpointList;
+		NMUInt32 endpointListState;
+		long endpointCount;
+		NMBoolean receivePending; //one of our endpoints has receivePending set
+		machine_lock *endpointListLock; //dont access the list without locking it!
+		machine_lock *endpointWaitingListLock;
+		NMBoolean eventsDeferred; //one of our endpoints has deferredEvents (or an open or death) waiting on its notifier
+		int wakeSocket;
+		int wakeHostSocket;
+		long openingCount; //endpoints on the list with opening set
+	#ifdef OP_API_NETWORK_SOCKETS
+		pthread_mutex_t openLock;
+		pthread_cond_t openProgress; //broadcast whenever a synchronous open completes
+	#elif defined(OP_API_NETWORK_WINSOCK)
+		HANDLE openProgress;
+	#endif
+#if (USE_EPOLL)
+		int eventSet; //every endpoint socket is added to this once, rather than being handed to select() on every pass
+#endif
+#if (USE_WORKER_THREAD)
+		NMBoolean workerThreadAlive;
+		NMBoolean dieWorkerThread;
+	#ifdef OP_API_NETWORK_SOCKETS
+		pthread_t	worker_thread;
+	#elif defined(OP_API_NETWORK_WINSOCK)
+		DWORD	worker_thread;
+		HANDLE	worker_thread_handle;
+	#endif
+#endif
+	};
+
+	//one of the notifier lock stripes. the thread holding it can take it again - they may send from a
+	//callback, and sending can enter the notifier we're calling them back under (or another endpoint's
+	//that shares its stripe) - so we note who has it and how many times
+	struct NMNotifierLock {
+		machine_lock lock;
+		volatile NMBoolean held;
+		long depth;
+	#ifdef OP_API_NETWORK_SOCKETS
+		pthread_t owner;
+	#elif defined(OP_API_NETWORK_WINSOCK)
+		DWORD owner;
+	#endif
 	};
 
 	enum {
@@ -175,14 +343,25 @@
 	};
 
 	struct available_game_data {
-		long host;
+		long host; //the id we give it - its IPv4 address, or the key it gives if it has one
 		word port;
 		word flags;
+		struct sockaddr_storage address; //where the answer came from (the port is in network order here)
 		long ticks_at_last_response;
 		char name[kMaxGameNameLen+1];
+		struct available_game_data *hash_next; //in its bucket of the config's game table
+		struct available_game_data *wheel_next; //in the slot of the timer wheel it's due to be dropped in
+		struct available_game_data *wheel_prev;
+		short wheel_slot;
+		struct available_game_data *new_next; //heard from but not yet announced with kNMEnumAdd
 	};
 
-	#define MAXIMUM_GAMES_ALLOWED_BETWEEN_IDLE (10)
+	// games being enumerated are kept in a table hashed by host (doubled whenever it gets as full as it is big)
+	// and aged by a timer wheel - a ring of slots each covering this many ticks, that must between them span
+	// more than TICKS_BEFORE_GAME_DROPPED. each idle only looks at the slots due since the last one
+	#define INITIAL_GAME_TABLE_SIZE (64)
+	#define GAME_WHEEL_SLOTS (16)
+	#define GAME_WHEEL_SLOT_TICKS (TICKS_BEFORE_GAME_DROPPED / 8)
 
 	struct NMProtocolConfigPriv {
 		NMUInt32 cookie;
@@ -191,21 +370,30 @@
 		NMSInt32 gameID;
 		long connectionMode;
 		NMBoolean netSprocketMode;
+		NMBoolean asyncOpen;
 		char host_name[256];
-	        struct sockaddr_in hostAddr;		/* remote host name */
+	        struct sockaddr_storage hostAddr;	/* remote host name (IPv4 or IPv6) */
+		struct NMSocketOptions socketOptions;
 		char name[kMaxGameNameLen + 1];
 		char buffer[MAXIMUM_CONFIG_LENGTH];
 
 	  /* Enumeration Data follows */
-		struct available_game_data *games;
-		short game_count;
+		struct available_game_data **game_table; //game_table_size buckets (a power of two)
+		long game_table_size;
+		long game_count;
+		struct available_game_data *game_wheel[GAME_WHEEL_SLOTS];
+		NMUInt32 game_wheel_ticks; //when we last turned the wheel
+		struct available_game_data *new_games; //not yet announced, oldest first
+		struct available_game_data *new_games_tail;
+		NMBoolean backgroundEnumeration; //the worker looks after our enumeration, rather than NMIdleEnumeration
+		NMBoolean announcing; //we're calling back about games, so they must be left alone if the enumeration ends
+		struct NMProtocolConfigPriv *enumeration_next; //on the worker's list, if enumerating in the background
 		NMEnumerationCallbackPtr callback;
 		void *user_context;
 		int enumeration_socket;
+		int enumeration_family; //AF_INET6 if it's dual-stack
 		NMBoolean enumerating;
 		NMBoolean activeEnumeration;
-		struct available_game_data new_games[MAXIMUM_GAMES_ALLOWED_BETWEEN_IDLE];
-		short new_game_count;
 		NMUInt32 ticks_at_last_enumeration_request;
 	};
 
@@ -223,10 +411,33 @@
 	#endif
 	void killWorkerThread(void);
 #endif
+
+void killResolverThreads(void);
 	
-int createWakeSocket(void);
-void disposeWakeSocket(void);
-void sendWakeMessage(void);
+int createWorkerShards(void);
+void disposeWorkerShards(void);
+
+int createEndpointPool(void);
+void disposeEndpointPool(void);
+
+int createBackgroundEnumerations(void);
+void disposeBackgroundEnumerations(void);
+void processBackgroundEnumerations(void);
+NMBoolean backgroundEnumerationsActive(void);
+NMBoolean onEnumerationWorker(void);
+void watchEnumerationSocket(int socket, NMBoolean watch);
+#if (!USE_EPOLL)
+	long watchBackgroundEnumerations(fd_set *input_set, long nfds);
+#endif
+
+int createWakeSocket(NMWorkerShard *shard);
+void disposeWakeSocket(NMWorkerShard *shard);
+void sendWakeMessage(NMWorkerShard *shard);
+
+#if (USE_EPOLL)
+	int createEventSet(NMWorkerShard *shard);
+	void disposeEventSet(NMWorkerShard *shard);
+#endif
 	
 #ifdef OP_API_NETWORK_WINSOCK
 	void initWinsock(void);
@@ -234,13 +445,21 @@ void sendWakeMessage(void);
 #endif
 
 	void SetNonBlockingMode(int fd);
+
+	// addresses can be IPv4 or IPv6 - sockets are made dual-stack where we can, so IPv6 ones take IPv4 too
+	int open_socket(int family, int type);
+	int passive_socket_family(void);
+	void any_sockaddr(struct sockaddr_storage *address, int family, unsigned short port);
+	unsigned short sockaddr_port(const struct sockaddr_storage *address);
+	void set_sockaddr_port(struct sockaddr_storage *address, unsigned short port);
+	posix_size_type sockaddr_length(const struct sockaddr_storage *address);
+	NMUInt32 sockaddr_ipv4_host(const struct sockaddr_storage *address);
+	void sockaddr_to_string(const struct sockaddr_storage *address, char *text, long length);
+	NMUInt32 enumeration_host_key(void);
 	
 	
 // --------------------------------  Globals
-	extern NMUInt32 endpointListState;
-	extern NMEndpointPriv *endpointList;
-	extern machine_lock *endpointListLock;
-	extern machine_lock *endpointWaitingListLock;
-	extern machine_lock *notifierLock;
+	extern NMWorkerShard *workerShards;
+	extern long workerShardCount;
 	extern NMSInt32	module_inited;
 #endif  // __TCP_MODULE__
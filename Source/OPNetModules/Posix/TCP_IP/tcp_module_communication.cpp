@@ -33,6 +33,7 @@
 
 #include <signal.h>
 #include <fcntl.h>
+#include <time.h>
 
 #include "Openplay.h"
 #include "OPUtils.h"
@@ -57,29 +58,80 @@
 
 //since we are multithreaded, we have to use a mutual-exclusion locks for certain items
 
-//for locking callbacks -
-#define TRY_ENTER_NOTIFIER() machine_acquire_lock(notifierLock)
-#define ENTER_NOTIFIER() while (machine_acquire_lock(notifierLock) == false) {}
-#define LEAVE_NOTIFIER() machine_clear_lock(notifierLock)
-
-//locks the endpoint list - you must lock this when adding or removing endpoints, and increment endpointListState whenever you change it (while locked of course)
-#define TRY_LOCK_ENDPOINT_LIST() machine_acquire_lock(endpointListLock)
-#define TRY_LOCK_ENDPOINT_WAITING_LIST() machine_acquire_lock(endpointWaitingListLock)
-#define LOCK_ENDPOINT_LIST() {while (machine_acquire_lock(endpointListLock) == false) {}}
-#define LOCK_ENDPOINT_WAITING_LIST() {while (machine_acquire_lock(endpointWaitingListLock) == false) {}}
-#define UNLOCK_ENDPOINT_LIST() {machine_clear_lock(endpointListLock);}
-#define UNLOCK_ENDPOINT_WAITING_LIST() {machine_clear_lock(endpointWaitingListLock);}
+//for locking callbacks - each endpoint and mode (socket type) has its own notifier lock, and
+//we never call the user back about a socket without holding its endpoint's lock for that type.
+//(we only use the endpoint's address to find it, so its fine to leave one after the endpoint is gone)
+#define NOTIFIER_LOCK(e, t) (&notifierLocks[((((size_t) (e)) / sizeof(NMEndpointPriv)) % NOTIFIER_LOCK_STRIPES) * NUMBER_OF_SOCKETS + (t)])
+#define TRY_ENTER_NOTIFIER(l) _enter_notifier(l, false)
+#define ENTER_NOTIFIER(l) _enter_notifier(l, true)
+#define LEAVE_NOTIFIER(l) _leave_notifier(l)
+
+//locks a shard's endpoint list - you must lock this when adding or removing endpoints, and increment its endpointListState whenever you change it (while locked of course)
+#define TRY_LOCK_ENDPOINT_LIST(s) machine_acquire_lock((s)->endpointListLock)
+#define TRY_LOCK_ENDPOINT_WAITING_LIST(s) machine_acquire_lock((s)->endpointWaitingListLock)
+#define LOCK_ENDPOINT_LIST(s) {machine_wait_for_lock((s)->endpointListLock);}
+#define LOCK_ENDPOINT_WAITING_LIST(s) {machine_wait_for_lock((s)->endpointWaitingListLock);}
+#define UNLOCK_ENDPOINT_LIST(s) {machine_clear_lock((s)->endpointListLock);}
+#define UNLOCK_ENDPOINT_WAITING_LIST(s) {machine_clear_lock((s)->endpointWaitingListLock);}
 
 #define MARK_ENDPOINT_AS_VALID(e, t) ((e)->valid_endpoints |= (1<<(t)))
 
+//what processEndPointSocket() is told about a socket
+enum {
+	_socket_readable = 0x01,
+	_socket_writable = 0x02,
+	_socket_exception = 0x04
+};
+
+#if (USE_EPOLL)
+	#define MAXIMUM_EVENTS_PER_WAIT 64
+
+	//epoll hands us back a 64 bit cookie for each socket - we store the endpoint pointer
+	//with the socket type tucked into its low bit (endpoints come from calloc so the bit is free)
+	//a cookie of zero is our wake socket, and one a background enumeration's socket (only on the first shard)
+	#define ENUMERATION_EVENT_DATA ((uint64_t) 1)
+	#define EVENT_DATA_FOR_SOCKET(e, t) (((uint64_t) (unsigned long) (e)) | (uint64_t) (t))
+	#define ENDPOINT_FOR_EVENT_DATA(d) ((NMEndpointPriv *) (unsigned long) ((d) & ~((uint64_t) 1)))
+	#define SOCKET_TYPE_FOR_EVENT_DATA(d) ((long) ((d) & 1))
+#endif
+
 //	------------------------------	Private Functions
 static NMBoolean 	internally_handle_read_data(NMEndpointRef endpoint, NMSInt16 type);
-NMBoolean processEndpoints(NMBoolean block);
-void processEndPointSocket(NMEndpointPriv *theEndPoint, long socketType, fd_set *input_set, fd_set *output_set, fd_set *exc_set);
+NMBoolean processEndpoints(NMWorkerShard *shard, NMBoolean block);
+void processEndPointSocket(NMEndpointPriv *theEndPoint, long socketType, long socketEvents);
+static void _start_endpoint_dying(NMEndpointPriv *theEndPoint);
+static NMBoolean _lock_endpoint_list_for_processing(NMWorkerShard *shard, NMBoolean block);
+static NMWorkerShard *_choose_worker_shard(void);
+static void _note_buffered_data(NMEndpointPriv *endpoint);
+static void _deliver_buffered_data(NMWorkerShard *shard);
+static long _buffered_datagram_count(NMEndpointRef endpoint);
+static void _note_open_progress(NMWorkerShard *shard);
+static NMBoolean _try_enter_endpoint_notifiers(NMEndpointPriv *endpoint);
+static void _leave_endpoint_notifiers(NMEndpointPriv *endpoint, NMWorkerShard *shard);
+static NMBoolean _enter_notifier(NMNotifierLock *notifier, NMBoolean block);
+static void _leave_notifier(NMNotifierLock *notifier);
+static void _leave_socket_notifier(NMWorkerShard *shard, NMNotifierLock *notifier);
+static void _wake_deferred_shards(NMWorkerShard *except);
+static void _defer_endpoint_events(NMEndpointPriv *endpoint, long socketType, long socketEvents);
+static void _deliver_deferred_events(NMWorkerShard *shard);
+static void _finish_open(NMEndpointRef Endpoint);
+static NMEndpointPriv *_get_pooled_endpoint(void);
+static void _release_pooled_endpoint(NMEndpointPriv *endpoint);
+static NMErr _create_endpoint_sockets(NMEndpointRef new_endpoint, struct sockaddr_storage *hostInfo, NMBoolean Active);
+static NMBoolean _handle_enumeration_request(NMEndpointRef endpoint, char *packet, NMSInt32 length, struct sockaddr_storage *remote_address);
+#if (USE_WORKER_THREAD)
+	static NMBoolean _on_worker_thread(NMWorkerShard *shard);
+#endif
 void receive_udp_port(NMEndpointRef endpoint);
 static NMBoolean internally_handled_datagram(NMEndpointRef endpoint);
 static long socketReadResult(NMEndpointRef endpoint,int socketType);
 
+#if (USE_EPOLL)
+	static void _register_endpoint_sockets(NMEndpointRef endpoint);
+	static void _unregister_endpoint_sockets(NMEndpointRef endpoint);
+	static void _rearm_endpoint_socket(NMEndpointRef endpoint, int socketType);
+#endif
+
 
 //  ------------------------------  Private Variables
 
@@ -87,24 +139,308 @@ static long socketReadResult(NMEndpointRef endpoint,int socketType);
 	NMBoolean	winSockRunning = false;
 #endif
 
-static int wakeSocket;
-static int wakeHostSocket;
+//for notifier locks (see NOTIFIER_LOCK)
+static NMNotifierLock *notifierLocks = NULL;
 
-//for notifier locks
-static long notifierLockCount = 0;
+//closed endpoints waiting to be reused, oldest first (linked through their next field)
+static machine_lock *endpointPoolLock = NULL;
+static NMEndpointPriv *endpointPool = NULL;
+static NMEndpointPriv *endpointPoolTail = NULL;
+static long endpointPoolCount = 0;
 
-/*stuff for our worker thread*/
-#if (USE_WORKER_THREAD)
-	NMBoolean workerThreadAlive = false;
-	NMBoolean dieWorkerThread = false;
-	
+//  ------------------------------  Resolver
+
+//host names are looked up with getaddrinfo() - synchronous opens do it themselves, while asynchronous ones
+//hand the name to a resolver thread so the open can go on without it (and so several can be in flight at once).
+//either way the answer is cached for a while, so opening many endpoints to one host doesn't ask every time.
+enum {
+	_resolve_empty = 0,		//slot is unused
+	_resolve_queued,		//waiting for a resolver thread
+	_resolve_looking_up,	//a resolver thread has it
+	_resolve_done			//found (or not), good until it expires
+};
+
+typedef struct NMResolverEntry
+{
+	char name[256];
+	long state;
+	NMBoolean found;
+	struct sockaddr_storage address; //(with no port)
+	NMUInt32 expires;
+} NMResolverEntry;
+
+static NMResolverEntry resolverCache[RESOLVER_CACHE_SIZE];
+static long resolverThreadCount = 0;
+static long resolverIdleCount = 0; //threads waiting for work
+static NMBoolean dieResolverThreads = false;
+
+#ifdef OP_API_NETWORK_SOCKETS
+	static pthread_mutex_t resolverLock = PTHREAD_MUTEX_INITIALIZER;
+	static pthread_cond_t resolverWork = PTHREAD_COND_INITIALIZER;
+	static pthread_t resolverThreads[MAXIMUM_RESOLVER_THREADS];
+
+	#define LOCK_RESOLVER() pthread_mutex_lock(&resolverLock)
+	#define UNLOCK_RESOLVER() pthread_mutex_unlock(&resolverLock)
+	#define WAIT_FOR_RESOLVER_WORK() pthread_cond_wait(&resolverWork, &resolverLock)
+	#define SIGNAL_RESOLVER_WORK() pthread_cond_signal(&resolverWork)
+#elif defined(OP_API_NETWORK_WINSOCK)
+	static machine_lock resolverLock;
+	static HANDLE resolverWork = NULL;
+	static HANDLE resolverThreads[MAXIMUM_RESOLVER_THREADS];
+
+	#define LOCK_RESOLVER() machine_wait_for_lock(&resolverLock)
+	#define UNLOCK_RESOLVER() machine_clear_lock(&resolverLock)
+	#define WAIT_FOR_RESOLVER_WORK() {UNLOCK_RESOLVER(); WaitForSingleObject(resolverWork, INFINITE); LOCK_RESOLVER();}
+	#define SIGNAL_RESOLVER_WORK() SetEvent(resolverWork)
+#endif
+
+/* 
+ * Static Function: _query_resolver
+ *--------------------------------------------------------------------
+ * Parameters:
+ *  [IN]  host = name to look up
+ *  [IN]  numeric = only take numeric addresses - never asks a server
+ *  [OUT] address = its address (IPv4 or IPv6), with no port
+ *
+ * Returns:
+ *   0 = failed to get an address for name
+ *   1 = successfully got an address for name
+ *
+ * Description:
+ *   Asks the system resolver, blocking for as long as that takes.
+ *   We take the first answer, so its idea of which family to prefer
+ *   is ours too.  Safe to call from any thread.
+ *
+ *--------------------------------------------------------------------
+ */
+
+static int _query_resolver(const char *host, NMBoolean numeric, struct sockaddr_storage *address)
+{
+	int gotAddr = 0;
+	struct addrinfo hints;
+	struct addrinfo *result = NULL;
+
+	machine_mem_zero(&hints, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if (numeric)
+		hints.ai_flags = AI_NUMERICHOST;
+
+	if ((getaddrinfo(host, NULL, &hints, &result) == 0) && (result) && (result->ai_addrlen <= sizeof(*address)))
+	{
+		machine_mem_zero(address, sizeof(*address));
+		machine_copy_data((char *) result->ai_addr, (char *) address, result->ai_addrlen);
+		gotAddr = 1;
+	}
+	if (result)
+		freeaddrinfo(result);
+
+	return gotAddr;
+} /* _query_resolver */
+
+//finds the cache slot for this name, or one we can take for it (an unused one, or else the one done
+//soonest to expire) - or NULL if every slot is busy with a lookup. must be called with the resolver locked.
+static NMResolverEntry *_find_resolver_entry(const char *host, NMBoolean claim)
+{
+	NMResolverEntry *spare = NULL;
+	long index;
+
+	for (index = 0; index < RESOLVER_CACHE_SIZE; index++)
+	{
+		NMResolverEntry *entry = &resolverCache[index];
+
+		if (entry->state == _resolve_empty)
+		{
+			if (!spare || (spare->state != _resolve_empty))
+				spare = entry;
+			continue;
+		}
+		if (strcmp(entry->name, host) == 0)
+			return entry;
+		if ((entry->state == _resolve_done) && (!spare
+			|| ((spare->state == _resolve_done) && ((NMSInt32) (entry->expires - spare->expires) < 0))))
+			spare = entry;
+	}
+
+	if ((!claim) || (!spare))
+		return NULL;
+
+	strncpy(spare->name, host, sizeof(spare->name) - 1);
+	spare->name[sizeof(spare->name) - 1] = 0;
+	spare->state = _resolve_empty;
+	return spare;
+}
+
+//remembers what a lookup came back with. must be called with the resolver locked.
+static void _store_resolver_answer(const char *host, int found, const struct sockaddr_storage *address)
+{
+	NMResolverEntry *entry = _find_resolver_entry(host, true);
+
+	if (!entry)
+		return; //we'll just have to ask again next time
+
+	entry->state = _resolve_done;
+	entry->found = found;
+	entry->address = *address;
+	entry->expires = machine_tick_count() + (found ? RESOLVER_TTL_TICKS : RESOLVER_NEGATIVE_TTL_TICKS);
+}
+
+// the main function for our resolver threads, which look up the names asynchronous opens are waiting on
+#ifdef OP_API_NETWORK_SOCKETS
+	static void* resolver_thread_func(void *arg)
+#elif defined(OP_API_NETWORK_WINSOCK)
+	static DWORD WINAPI resolver_thread_func(LPVOID arg)
+#endif
+{
+	LOCK_RESOLVER();
+	while (!dieResolverThreads)
+	{
+		NMResolverEntry *entry = NULL;
+		char host[256];
+		struct sockaddr_storage address;
+		int found;
+		long index;
+
+		for (index = 0; index < RESOLVER_CACHE_SIZE; index++)
+		{
+			if (resolverCache[index].state == _resolve_queued)
+			{
+				entry = &resolverCache[index];
+				break;
+			}
+		}
+		if (!entry)
+		{
+			resolverIdleCount++;
+			WAIT_FOR_RESOLVER_WORK();
+			resolverIdleCount--;
+			continue;
+		}
+
+		entry->state = _resolve_looking_up;
+		strcpy(host, entry->name);
+		UNLOCK_RESOLVER();
+
+		DEBUG_PRINT("resolver looking up %s",host);
+		found = _query_resolver(host, false, &address);
+
+		LOCK_RESOLVER();
+		_store_resolver_answer(host, found, &address);
+		UNLOCK_RESOLVER();
+
+		//whoever is waiting on this will find it on their next pass
+		for (index = 0; index < workerShardCount; index++)
+		{
+			if (workerShards[index].openingCount > 0)
+				sendWakeMessage(&workerShards[index]);
+		}
+
+		LOCK_RESOLVER();
+	}
+	UNLOCK_RESOLVER();
+
+	return NULL;
+}
+
+/* 
+ * Static Function: _resolve_host
+ *--------------------------------------------------------------------
+ * Parameters:
+ *  [IN]  host = name to look up
+ *  [IN]  wait = whether we may block on the system resolver
+ *  [OUT] address = its address, with no port
+ *
+ * Returns:
+ *   0 = failed to get IP address for name
+ *   1 = successfully got IP address for name
+ *  -1 = not known yet; a resolver thread is looking it up (only if !wait)
+ *
+ * Description:
+ *   Answers from the cache if it can, otherwise looks the name up -
+ *   right here, or on a resolver thread if we're not to wait.
+ *
+ *--------------------------------------------------------------------
+ */
+
+static int _resolve_host(const char *host, NMBoolean wait, struct sockaddr_storage *address)
+{
+	NMResolverEntry *entry;
+	int found;
+
+	LOCK_RESOLVER();
+	entry = _find_resolver_entry(host, !wait);
+	if ((entry) && (entry->state == _resolve_done) && ((NMSInt32) (machine_tick_count() - entry->expires) < 0))
+	{
+		found = entry->found;
+		*address = entry->address;
+		UNLOCK_RESOLVER();
+		return found;
+	}
+
+	if (!wait)
+	{
+		//if every slot is busy, we'll try again on the next pass
+		if ((entry) && (entry->state != _resolve_queued) && (entry->state != _resolve_looking_up))
+		{
+			entry->state = _resolve_queued;
+			if ((resolverIdleCount == 0) && (resolverThreadCount < MAXIMUM_RESOLVER_THREADS))
+			{
+				#ifdef OP_API_NETWORK_SOCKETS
+					if (pthread_create(&resolverThreads[resolverThreadCount], NULL, resolver_thread_func, NULL) == 0)
+						resolverThreadCount++;
+				#elif defined(OP_API_NETWORK_WINSOCK)
+					DWORD threadID;
+
+					if (!resolverWork)
+						resolverWork = CreateEvent(NULL, FALSE, FALSE, NULL);
+					resolverThreads[resolverThreadCount] = CreateThread(NULL, 0, resolver_thread_func, NULL, 0, &threadID);
+					if (resolverThreads[resolverThreadCount] != NULL)
+						resolverThreadCount++;
+				#endif
+			}
+			SIGNAL_RESOLVER_WORK();
+		}
+		UNLOCK_RESOLVER();
+		return -1;
+	}
+	UNLOCK_RESOLVER();
+
+	found = _query_resolver(host, false, address);
+
+	LOCK_RESOLVER();
+	_store_resolver_answer(host, found, address);
+	UNLOCK_RESOLVER();
+
+	return found;
+} /* _resolve_host */
+
+//stops the resolver threads (waiting out any lookups they're in the middle of)
+void killResolverThreads(void)
+{
+	long index;
+
+	LOCK_RESOLVER();
+	dieResolverThreads = true;
 	#ifdef OP_API_NETWORK_SOCKETS
-		pthread_t	worker_thread;
-	#elif defined(OP_API_NETWORK_WINSOCK)
-		DWORD	worker_thread;
-		HANDLE	worker_thread_handle;
+		pthread_cond_broadcast(&resolverWork);
 	#endif
-#endif
+	UNLOCK_RESOLVER();
+
+	for (index = 0; index < resolverThreadCount; index++)
+	{
+		//as with the worker threads, on windows we can't wait for them during DllMain()
+		#ifdef OP_API_NETWORK_SOCKETS
+			pthread_join(resolverThreads[index], NULL);
+		#elif defined(OP_API_NETWORK_WINSOCK)
+			TerminateThread(resolverThreads[index], 0);
+			CloseHandle(resolverThreads[index]);
+		#endif
+	}
+	resolverThreadCount = 0;
+	resolverIdleCount = 0;
+	dieResolverThreads = false;
+	machine_mem_zero(resolverCache, sizeof(resolverCache));
+}
 
 /* 
  * Static Function: _lookup_machine
@@ -113,10 +449,12 @@ static long notifierLockCount = 0;
  *  [IN]  machine = name of machine to resolve
  *  [IN]  default_port = port number to include in final address
  *  [IN/OUT]  hostAddr = structure to contain resolved information  
+ *  [IN]  wait = whether we may block on the system resolver
  *
  * Returns:
  *   0 = failed to get IP address for name
  *   1 = successfully got IP address for name
+ *  -1 = still being looked up (only if !wait) - ask again later
  *
  * Description:
  *   Function to lookup the IP address of a specified machine name.
@@ -125,14 +463,14 @@ static long notifierLockCount = 0;
  *--------------------------------------------------------------------
  */
 
-static int _lookup_machine(char *machine, unsigned short default_port, struct sockaddr_in *hostAddr)
+static int _lookup_machine(char *machine, unsigned short default_port, struct sockaddr_storage *hostAddr, NMBoolean wait)
 {
   int  gotAddr = 0;
   char trimmedHost[256];
   char *colon_pos;              /* pointer to rightmost colon in name */
+  char *host = trimmedHost;
   unsigned short  needPort;     /* port we need */
-  struct hostent  *hostInfo;
-  unsigned long	  hostIPAddr;
+  struct sockaddr_storage address;
 
 	DEBUG_ENTRY_EXIT("_lookup_machine");
 
@@ -145,13 +483,32 @@ static int _lookup_machine(char *machine, unsigned short default_port, struct so
    * This does nothing in the context of OpenPlay, since we always specify the port
    * number separately. This will let you paste in a host name with a colon and
    * safely ignore it.
+   * IPv6 numbers are full of colons, so one only has a port after it if it's
+   * in brackets ("[::1]:80").
    */
   needPort = default_port;
 
-  strcpy(trimmedHost, machine);
+  strncpy(trimmedHost, machine, sizeof(trimmedHost) - 1);
+  trimmedHost[sizeof(trimmedHost) - 1] = 0;
 
-  /* find first colon */
-  colon_pos = strchr(trimmedHost, ':');
+  if (trimmedHost[0] == '[')
+  {
+    host++;
+    colon_pos = strchr(host, ']');
+    if (colon_pos)
+    {
+      *colon_pos++ = 0;
+      if (*colon_pos != ':')
+        colon_pos = NULL;
+    }
+  }
+  else
+  {
+    /* find first colon - unless there's more than one */
+    colon_pos = strchr(trimmedHost, ':');
+    if (colon_pos && strchr(colon_pos + 1, ':'))
+      colon_pos = NULL;
+  }
 
   /* everything after that is the port number, if we found it */
   if (colon_pos)
@@ -160,33 +517,86 @@ static int _lookup_machine(char *machine, unsigned short default_port, struct so
     needPort = htons((short) atoi(colon_pos));
   }
   
-  hostInfo = gethostbyname(trimmedHost);
-
-  if (hostInfo)
-  {
-    /* Got an ip address by resolving name */
-    hostIPAddr = *(unsigned long *) (hostInfo->h_addr_list[0]);
-
-    gotAddr = 1;
-  }
-  else if (INADDR_NONE != (hostIPAddr = inet_addr(trimmedHost)))
+  /* numbers don't need looking up */
+  if (_query_resolver(host, true, &address))
     gotAddr = 1;
+  else
+    gotAddr = _resolve_host(host, wait, &address);
 
-  if (gotAddr)
+  if (gotAddr == 1)
   {
-    hostAddr->sin_family = AF_INET;
-    hostAddr->sin_port = needPort;
-    hostAddr->sin_addr.s_addr = hostIPAddr;
+    *hostAddr = address;
+    set_sockaddr_port(hostAddr, needPort);
   }
 
   return gotAddr;
 } /* _lookup_machine */
 
+/* 
+ * Static Function: _apply_socket_options
+ *--------------------------------------------------------------------
+ * Parameters:
+ *  [IN] Endpoint = endpoint whose socketOptions to apply
+ *  [IN] index    = which of its sockets to apply them to
+ *
+ * Returns:
+ *  none
+ *
+ * Description:
+ *   Sets the buffer sizes on either socket, and Nagle/corking on the
+ *   stream socket.  Failures are only logged - the socket still works,
+ *   it just isn't tuned.
+ *
+ *--------------------------------------------------------------------
+ */
+
+static void _apply_socket_options(NMEndpointRef Endpoint, int index)
+{
+	int status;
+	int opt;
+
+	DEBUG_ENTRY_EXIT("_apply_socket_options");
+
+	if (Endpoint->sockets[index] == INVALID_SOCKET)
+		return;
+
+	if (index == _stream_socket)
+	{
+		opt = Endpoint->socketOptions.noDelay ? 1 : 0;
+		status = setsockopt(Endpoint->sockets[index], IPPROTO_TCP, TCP_NODELAY, (char*)&opt, sizeof(opt));
+		DEBUG_NETWORK_API("setsockopt for no delay", status);
+
+		//clearing the cork is what pushes out anything it was holding, so always set it one way or the other
+		opt = Endpoint->socketOptions.cork ? 1 : 0;
+#if defined(TCP_CORK)
+		status = setsockopt(Endpoint->sockets[index], IPPROTO_TCP, TCP_CORK, (char*)&opt, sizeof(opt));
+		DEBUG_NETWORK_API("setsockopt for cork", status);
+#elif defined(TCP_NOPUSH)
+		status = setsockopt(Endpoint->sockets[index], IPPROTO_TCP, TCP_NOPUSH, (char*)&opt, sizeof(opt));
+		DEBUG_NETWORK_API("setsockopt for no push", status);
+#endif
+	}
+
+	if (Endpoint->socketOptions.sendBufferSize > 0)
+	{
+		opt = Endpoint->socketOptions.sendBufferSize;
+		status = setsockopt(Endpoint->sockets[index], SOL_SOCKET, SO_SNDBUF, (char*)&opt, sizeof(opt));
+		DEBUG_NETWORK_API("setsockopt for send buffer", status);
+	}
+
+	if (Endpoint->socketOptions.receiveBufferSize > 0)
+	{
+		opt = Endpoint->socketOptions.receiveBufferSize;
+		status = setsockopt(Endpoint->sockets[index], SOL_SOCKET, SO_RCVBUF, (char*)&opt, sizeof(opt));
+		DEBUG_NETWORK_API("setsockopt for receive buffer", status);
+	}
+}
+
 //creates a datagram and stream socket on the same port - retries if necessary until success is achieved
-static NMErr _create_sockets(int *sockets, word required_port, NMBoolean active)
+static NMErr _create_sockets(int *sockets, word required_port, NMBoolean active, int family)
 {
 	NMErr status = kNMNoError;
-	struct sockaddr_in address;
+	struct sockaddr_storage address;
 	posix_size_type size = sizeof(address);
 	int opt = true;
 
@@ -200,12 +610,10 @@ static NMErr _create_sockets(int *sockets, word required_port, NMBoolean active)
 	{
 		//make a datagram socket, bind it to any port, and try to make a stream socket on that port.
 		//if we don't get the same port, leave it bound for now and move to the next (otherwise we might get same one repeatedly)
-		datagramSockets[counter] = socket(PF_INET,SOCK_DGRAM,0);
+		datagramSockets[counter] = open_socket(family,SOCK_DGRAM);
 		op_assert(datagramSockets[counter]);
 		
-		address.sin_family = AF_INET;
-		address.sin_addr.s_addr = INADDR_ANY;
-		address.sin_port = htons(required_port);
+		any_sockaddr(&address, family, htons(required_port));
 		
 		//so we can bind to it even if its just been used
 		if (required_port)
@@ -214,34 +622,27 @@ static NMErr _create_sockets(int *sockets, word required_port, NMBoolean active)
 			DEBUG_NETWORK_API("setsockopt for reuse address", status);
 		}
 		
-		status = bind(datagramSockets[counter],(sockaddr*)&address,sizeof(address));
+		status = bind(datagramSockets[counter],(sockaddr*)&address,sockaddr_length(&address));
 		if (!status)
 		{	
 			status = getsockname(datagramSockets[counter], (sockaddr*) &address, &size);
 			if (!status)
 			{	
-				DEBUG_PRINT("bound a datagram socket to port %d; trying stream",ntohs(address.sin_port));
+				DEBUG_PRINT("bound a datagram socket to port %d; trying stream",ntohs(sockaddr_port(&address)));
 				//weve got a bound datagram socket and its port - now try making a stream socket on the same one
-				streamSocket = socket(PF_INET,SOCK_STREAM,0);
+				streamSocket = open_socket(family,SOCK_STREAM);
 				op_assert(streamSocket);
 				
 				//so we can bind to it even if its just been used
 				status = setsockopt(streamSocket, SOL_SOCKET, SO_REUSEADDR,(char*)&opt, sizeof(opt));
 				DEBUG_NETWORK_API("setsockopt for reuse address", status);
 				
-				//why is this only done when not active? just curious...
-				if (!active)
-				{
-					/* set no delay */
-					status = setsockopt(streamSocket, IPPROTO_TCP, TCP_NODELAY,(char*)&opt, sizeof(opt));
-					DEBUG_NETWORK_API("setsockopt for no delay", status);
-				}
+				//no delay and the rest of the endpoint's socket options are set by _setup_socket
 				
 				//port is already correct from our getsockname call
-				address.sin_family = AF_INET;
-				address.sin_addr.s_addr = INADDR_ANY;
+				any_sockaddr(&address, family, sockaddr_port(&address));
 				
-				status = bind(streamSocket,(sockaddr*)&address,sizeof(address));
+				status = bind(streamSocket,(sockaddr*)&address,sockaddr_length(&address));
 				if (!status)
 				{
 					DEBUG_PRINT("bind worked for stream");
@@ -303,12 +704,13 @@ static NMErr _create_sockets(int *sockets, word required_port, NMBoolean active)
 
 static NMErr _setup_socket(	NMEndpointRef 			new_endpoint, 
 							int						index,
-                            struct sockaddr_in *	hostAddr, 
+                            struct sockaddr_storage *	hostAddr, 
                             NMBoolean 				Active, 
                             int *					preparedSockets)
 {
 	int socket_types[] = {SOCK_DGRAM, SOCK_STREAM};
 	int status = kNMNoError;
+	int family;
 		
 	DEBUG_ENTRY_EXIT("_setup_socket");
 
@@ -317,48 +719,44 @@ static NMErr _setup_socket(	NMEndpointRef 			new_endpoint,
 	//              or we better be passed an address
 	op_assert((Active == 0) || (0 != hostAddr));
 
+	//we connect with whatever the address is, and listen with both if we can
+	family = Active ? hostAddr->ss_family : passive_socket_family();
+
 	//use a prepared socket, or make our own
 	if (preparedSockets)
 		new_endpoint->sockets[index] = preparedSockets[index];
 	else
-		new_endpoint->sockets[index] = socket(PF_INET, socket_types[index], 0);
+		new_endpoint->sockets[index] = open_socket(family, socket_types[index]);
 
 	if (new_endpoint->sockets[index] != INVALID_SOCKET)
 	{
 		//if it wasnt prepared, set up the socket and bind it
+		//before connect() or listen(), so the buffer sizes count toward the window we advertise
+		_apply_socket_options(new_endpoint, index);
+
 		if (preparedSockets == NULL)
 		{
-			struct sockaddr_in sin;
-			int opt = true;
+			struct sockaddr_storage sin;
 		
-			sin.sin_family = AF_INET;
-			sin.sin_addr.s_addr = INADDR_ANY;
-			sin.sin_port = htons(0);
+			any_sockaddr(&sin, family, htons(0));
 			
-			if ((Active == 0) && (index == _stream_socket))
-			{
-				/* set no delay */
-				status = setsockopt(new_endpoint->sockets[index], IPPROTO_TCP, TCP_NODELAY,(char*)&opt, sizeof(opt));
-				DEBUG_NETWORK_API("setsockopt for no delay", status);
-			}
-
 			if (index == _datagram_socket)
-				DEBUG_PRINT("binding datagram socket to port %d",ntohs(sin.sin_port));
+				DEBUG_PRINT("binding datagram socket to port %d",ntohs(sockaddr_port(&sin)));
 			else
-				DEBUG_PRINT("binding stream socket to port %d",ntohs(sin.sin_port));
-			status = bind(new_endpoint->sockets[index], (sockaddr*)&sin, sizeof(sin));
+				DEBUG_PRINT("binding stream socket to port %d",ntohs(sockaddr_port(&sin)));
+			status = bind(new_endpoint->sockets[index], (sockaddr*)&sin, sockaddr_length(&sin));
 		}
 		if (!status)
 		{
-			sockaddr_in address;
+			struct sockaddr_storage address;
 			posix_size_type size = sizeof(address);
 					
 			// get the host and port...
 			status = getsockname(new_endpoint->sockets[index], (sockaddr*) &address, &size);
 			if (!status)
 			{
-				new_endpoint->host= ntohl(address.sin_addr.s_addr);
-				new_endpoint->port= ntohs(address.sin_port);
+				new_endpoint->host= sockaddr_ipv4_host(&address);
+				new_endpoint->port= ntohs(sockaddr_port(&address));
 				
 				//*required_port = new_endpoint->port;
 				if (index == _datagram_socket)
@@ -379,7 +777,7 @@ static NMErr _setup_socket(	NMEndpointRef 			new_endpoint,
 				//(we send data to the port we connect to, but they use a random port to send us data)
 				if ((Active) && ((new_endpoint->netSprocketMode == false) || (index == _stream_socket)))
 				{
-					status = connect(new_endpoint->sockets[index], (sockaddr*)hostAddr, sizeof(*hostAddr));
+					status = connect(new_endpoint->sockets[index], (sockaddr*)hostAddr, sockaddr_length(hostAddr));
 
 					//if we get EINPROGRESS, it just means the socket can't be created immediately, but that
 					//we can select() for completion by selecting the socket for writing...
@@ -432,13 +830,16 @@ static NMErr _setup_socket(	NMEndpointRef 			new_endpoint,
  * Static Function: _create_endpoint
  *--------------------------------------------------------------------
  * Parameters:
- *  [IN] hostInfo = 
+ *  [IN] hostInfo = (NULL if create_sockets but the address is still being looked up)
  *  [IN] Callback = 
  *  [IN] Context = 
  *  [OUT] Endpoint = 
  *  [IN] Active =
  *  [IN] create_sockets = 
+ *  [IN] asyncOpen = 
  *  [IN] connectionMode = 
+ *  [IN] netSprocketMode = 
+ *  [IN] socketOptions = 
  *  [IN] version = 
  *  [IN] gameID = 
  *
@@ -453,27 +854,28 @@ static NMErr _setup_socket(	NMEndpointRef 			new_endpoint,
 
 static NMErr 
 _create_endpoint(
-	sockaddr_in *hostInfo, 
+	struct sockaddr_storage *hostInfo, 
 	NMEndpointCallbackFunction *Callback,
 	void *Context,
 	NMEndpointRef *Endpoint,
 	NMBoolean Active,
 	NMBoolean create_sockets,
+	NMBoolean asyncOpen,
 	long connectionMode,
 	NMBoolean netSprocketMode,
+	const NMSocketOptions *socketOptions,
 	unsigned long version,
 	unsigned long gameID)
 {
 	NMEndpointRef new_endpoint;
 	int index;
 	NMErr err = 0;
+	NMWorkerShard *shard;
 
 	DEBUG_ENTRY_EXIT("_create_endpoint");
 
 		
-	new_endpoint = (NMEndpointRef)calloc(1, sizeof(struct NMEndpointPriv));
-
-
+	new_endpoint = _get_pooled_endpoint();
 	if (!new_endpoint)
 		return(kNMOutOfMemoryErr);
 
@@ -484,8 +886,6 @@ _create_endpoint(
 	else
 		DEBUG_PRINT("\n\nCREATING PASSIVE ENDPOINT (0X%X)\n\n",new_endpoint);
 
-	machine_mem_zero(new_endpoint, sizeof(NMEndpointPriv));
-	
 	//both joiner and passive endpoints are passed with active == false, so we distinguish here	
 	new_endpoint->listener = false;
 	if (!Active)
@@ -500,6 +900,7 @@ _create_endpoint(
 	new_endpoint->needToDie = false;
 	new_endpoint->connectionMode = connectionMode;
 	new_endpoint->netSprocketMode= netSprocketMode;
+	new_endpoint->socketOptions = *socketOptions;
 	new_endpoint->advertising = false;
 	new_endpoint->timeout  = DEFAULT_TIMEOUT;
 	new_endpoint->callback = Callback;
@@ -514,6 +915,13 @@ _create_endpoint(
 	new_endpoint->gameID = gameID;
 	new_endpoint->active = Active;
 	new_endpoint->opening_error = 0;
+	new_endpoint->shard = _choose_worker_shard();
+
+	//endpoints we make sockets for are NMOpen's, and it needs to hear when they're done opening
+	new_endpoint->opening = create_sockets;
+	new_endpoint->resolveName = NULL;
+	new_endpoint->asyncOpen = false;
+	new_endpoint->openDeadline = machine_tick_count() + OPEN_TIMEOUT_TICKS;
 
 	for (index = 0; index < NUMBER_OF_SOCKETS; ++index)
 	{
@@ -523,46 +931,9 @@ _create_endpoint(
 	}
 	*Endpoint = new_endpoint;
 
-	if (create_sockets)
- 	{ 
- 		int preparedSockets[NUMBER_OF_SOCKETS];
-		int *preparedSocketsPtr;
- 		
-		//sometimes we need datagram and stream sockets to be on the same port
-		//netsprocket mode does because we don't send our our port number to the connected machine so it has to be predictable
-		//we also need it when hosting, because enumeration requests are sent to the datagram socket on that port
-		//therefore, we prepare the sockets first-off, since we might not be able to get two of a kind on the first try
-		if ((new_endpoint->netSprocketMode) || (new_endpoint->listener))
-		{
-			word required_port;
-			if (Active)
-				required_port = 0; //we need two of the same, but they can be any port
-			else
-				required_port = ntohs(hostInfo->sin_port);//gotta get two of a specific port
-				
-			err = _create_sockets(preparedSockets,required_port,Active);
-			preparedSocketsPtr = preparedSockets;
-		}
-		else
-		{
-			preparedSocketsPtr = NULL;
-		}
-
-		if (!err)
-		{
-			for (index = 0; !err && index < NUMBER_OF_SOCKETS; ++index)
-			{
-				if (new_endpoint->connectionMode & (1 << index))
-				{
-					struct sockaddr_in  address;
-					posix_size_type		addr_size = sizeof(address);
-
-					if (!err)
-						err = _setup_socket(new_endpoint, index, hostInfo, Active, preparedSocketsPtr);
-				}
-			}
-		}
-	}
+	//without an address, the host name is still being looked up - the worker makes our sockets once it has one
+	if ((create_sockets) && (hostInfo))
+		err = _create_endpoint_sockets(new_endpoint, hostInfo, Active);
 
 	if (err)
 	{
@@ -573,23 +944,91 @@ _create_endpoint(
 		return(err);
 	}
 
-	// now we add ourself to our list of live endpoints.
-	// the worker thread might be in the middle of a long select() call,
+	// both types of non-active endpoints have stream sockets that are already valid
+	// listener endpoints dont need to wait, and a new handed-off socket is already valid too
+	if ( create_sockets && !Active && (connectionMode & (1 << _stream_socket)) )
+		MARK_ENDPOINT_AS_VALID(new_endpoint,_stream_socket);
+
+	// only now that we can't fail - until it's handed back, nobody can be told about it
+	new_endpoint->asyncOpen = asyncOpen;
+
+	// now we add ourself to our shard's list of live endpoints.
+	// its worker thread might be in the middle of a long select() call,
 	// so we hop on the waiting list to keep the worker thread from re-acquiring the lock,
 	// then attempt to "wake up" out of the select() call to get it to relenquish its current lock,
 	// and hopefully grab the lock quickly ourselves
 
-	LOCK_ENDPOINT_WAITING_LIST();
-	sendWakeMessage();
-	LOCK_ENDPOINT_LIST();
-	new_endpoint->next = endpointList;
-	endpointList = new_endpoint;
-	endpointListState++;
-	UNLOCK_ENDPOINT_LIST();
-	UNLOCK_ENDPOINT_WAITING_LIST();
+	shard = new_endpoint->shard;
+	LOCK_ENDPOINT_WAITING_LIST(shard);
+	sendWakeMessage(shard);
+	LOCK_ENDPOINT_LIST(shard);
+	new_endpoint->next = shard->endpointList;
+	shard->endpointList = new_endpoint;
+	shard->endpointListState++;
+	shard->endpointCount++;
+	if (new_endpoint->opening)
+		shard->openingCount++;
+	UNLOCK_ENDPOINT_LIST(shard);
+	UNLOCK_ENDPOINT_WAITING_LIST(shard);
 	return(kNMNoError);
 }
 
+/* 
+ * Static Function: _create_endpoint_sockets
+ *--------------------------------------------------------------------
+ * Parameters:
+ *  [IN] new_endpoint = endpoint with no sockets yet
+ *  [IN] hostInfo = address to connect to, or listen on
+ *  [IN] Active = 
+ *
+ * Returns:
+ *  
+ *
+ * Description:
+ *   Makes the endpoint's sockets, as its connection mode calls for.
+ *
+ *--------------------------------------------------------------------
+ */
+
+static NMErr _create_endpoint_sockets(NMEndpointRef new_endpoint, struct sockaddr_storage *hostInfo, NMBoolean Active)
+{
+	int preparedSockets[NUMBER_OF_SOCKETS];
+	int *preparedSocketsPtr;
+	int index;
+	NMErr err = 0;
+
+	//sometimes we need datagram and stream sockets to be on the same port
+	//netsprocket mode does because we don't send our our port number to the connected machine so it has to be predictable
+	//we also need it when hosting, because enumeration requests are sent to the datagram socket on that port
+	//therefore, we prepare the sockets first-off, since we might not be able to get two of a kind on the first try
+	if ((new_endpoint->netSprocketMode) || (new_endpoint->listener))
+	{
+		word required_port;
+		if (Active)
+			required_port = 0; //we need two of the same, but they can be any port
+		else
+			required_port = ntohs(sockaddr_port(hostInfo));//gotta get two of a specific port
+			
+		err = _create_sockets(preparedSockets,required_port,Active,Active ? hostInfo->ss_family : passive_socket_family());
+		preparedSocketsPtr = preparedSockets;
+	}
+	else
+	{
+		preparedSocketsPtr = NULL;
+	}
+
+	if (!err)
+	{
+		for (index = 0; !err && index < NUMBER_OF_SOCKETS; ++index)
+		{
+			if (new_endpoint->connectionMode & (1 << index))
+				err = _setup_socket(new_endpoint, index, hostInfo, Active, preparedSocketsPtr);
+		}
+	}
+
+	return err;
+}
+
 /* 
  * Static Function: _send_data
  *--------------------------------------------------------------------
@@ -633,7 +1072,7 @@ static NMErr _send_data(	NMEndpointRef 		Endpoint,
 		//we're not associated with an address via connect().  Doing that would not allow us to receive datagrams from
 		//the host, since they dont come from that same port.
 		if ((socket_index == _datagram_socket) && (Endpoint->netSprocketMode) && (Endpoint->active))
-			result = sendto(Endpoint->sockets[socket_index], ((char*)Data) + offset, bytes_to_send,0,(sockaddr*)&Endpoint->remoteAddress,sizeof(Endpoint->remoteAddress));
+			result = sendto(Endpoint->sockets[socket_index], ((char*)Data) + offset, bytes_to_send,0,(sockaddr*)&Endpoint->remoteAddress,sockaddr_length(&Endpoint->remoteAddress));
 		else
 			result = send(Endpoint->sockets[socket_index], ((char*)Data) + offset, bytes_to_send, 0);
 
@@ -674,58 +1113,423 @@ static NMErr _send_data(	NMEndpointRef 		Endpoint,
 
 
 /* 
- * Static Function: _receive_data
+ * Static Function: _send_data_vectored
  *--------------------------------------------------------------------
  * Parameters:
  *  [IN] Endpoint = 
- *  [IN] the_socket = 
- *  [IN] Data = 
- *  [IN] Size = 
+ *  [IN] socket_index = 
+ *  [IN] Vectors = 
+ *  [IN] Count = 
  *  [IN] Flags =   
  *
  * Returns:
- *  
+ *   See _send_data().
  *
  * Description:
- *   Function 
+ *   Same as _send_data(), but the data comes from several buffers, which
+ *   go out in a single sendmsg() so we don't have to copy them together.
  *
  *--------------------------------------------------------------------
  */
 
-static NMErr _receive_data(NMEndpointRef inEndpoint, int which_socket, 
-                           void *ioData, unsigned long *ioSize, NMFlags *outFlags)
+static NMErr _send_data_vectored(	NMEndpointRef 		Endpoint, 
+									int					socket_index,
+									const NMIOVec *		Vectors, 
+									unsigned long 		Count, 
+									NMFlags 			Flags)
 {
-	NMErr		err = kNMNoError;
-	NMSInt32	result;
+	unsigned long Size = 0;
+	unsigned long index;
 
-	*outFlags = 0;
-	op_vassert_return((inEndpoint != NULL),"inEndpoint is NIL!",kNMParameterErr);
-    op_vassert_return(inEndpoint->cookie==kModuleID, csprintf(sz_temporary, "cookie: 0x%x != 0x%x", inEndpoint->cookie, kModuleID),kNMParameterErr); 
-	op_assert(inEndpoint->sockets[which_socket]!=INVALID_SOCKET);
+	DEBUG_ENTRY_EXIT("_send_data_vectored");
 
-	if (inEndpoint->needToDie == true)
-		return kNMNoDataErr;
-#ifdef HACKY_EAGAIN
-	SetNonBlockingMode(inEndpoint->sockets[which_socket]);
-#endif // HACKY_EAGAIN
-	result = recv(inEndpoint->sockets[which_socket], (char *)ioData, *ioSize, 0);
+	if (Endpoint->sockets[socket_index] == INVALID_SOCKET)
+	return(kNMParameterErr);
 
-	if (result == 0)
-	{
-		inEndpoint->needToDie = true;
-		return kNMNoDataErr;
-	}
-	
-	//should be more detailed here
-	if (result == -1)
+	for (index = 0; index < Count; index++)
+		Size += Vectors[index].length;
+
+#ifdef OP_API_NETWORK_SOCKETS
+	if (Count <= MAXIMUM_SEND_VECTORS)
 	{
-		if (op_errno != EWOULDBLOCK)
-			DEBUG_NETWORK_API("recv",result);
-		err= kNMNoDataErr;
-	}
-	else {				
-		*ioSize = result;
-	}
+		struct iovec iov[MAXIMUM_SEND_VECTORS];
+		struct msghdr message;
+		int result;
+		int done = 0;
+		unsigned long total_bytes_sent = 0;
+
+		memset(&message, 0, sizeof(message));
+		for (index = 0; index < Count; index++)
+		{
+			iov[index].iov_base = Vectors[index].data;
+			iov[index].iov_len = Vectors[index].length;
+		}
+		message.msg_iov = iov;
+		message.msg_iovlen = Count;
+
+		//same deal as _send_data() - active netsprocket-mode datagrams need an address on each send
+		if ((socket_index == _datagram_socket) && (Endpoint->netSprocketMode) && (Endpoint->active))
+		{
+			message.msg_name = &Endpoint->remoteAddress;
+			message.msg_namelen = sockaddr_length(&Endpoint->remoteAddress);
+		}
+
+		do
+		{
+			result = sendmsg(Endpoint->sockets[socket_index], &message, 0);
+
+			if (result == -1)
+			{
+	#ifdef HACKY_EAGAIN
+				if ( errno == EAGAIN )
+				{
+					result = 0;
+				}
+				else
+				{
+					DEBUG_NETWORK_API("sendmsg",result);
+					return(kNMInternalErr);
+				}
+	#else
+				DEBUG_NETWORK_API("sendmsg",result);
+				return(kNMInternalErr);
+	#endif // HACKY_EAGAIN
+			}
+
+			total_bytes_sent += result;
+
+			//step past whatever went out, in case we have to go around again
+			while ((result > 0) && (message.msg_iovlen > 0))
+			{
+				if ((unsigned long) result < message.msg_iov->iov_len)
+				{
+					message.msg_iov->iov_base = ((char *) message.msg_iov->iov_base) + result;
+					message.msg_iov->iov_len -= result;
+					result = 0;
+				}
+				else
+				{
+					result -= message.msg_iov->iov_len;
+					message.msg_iov++;
+					message.msg_iovlen--;
+				}
+			}
+
+			if ((Flags & kNMBlocking) && (total_bytes_sent != Size))
+				done = 0;
+			else
+				done = 1;
+
+		} while (!done);
+
+		return(total_bytes_sent);
+	}
+#endif // OP_API_NETWORK_SOCKETS
+
+	//no sendmsg() here (or too many pieces for it) - copy them together and send that
+	{
+		char *data;
+		char *dest;
+		NMErr result;
+
+		data = (char *) malloc(Size ? Size : 1);
+		if (data == NULL)
+			return(kNMOutOfMemoryErr);
+
+		dest = data;
+		for (index = 0; index < Count; index++)
+		{
+			machine_move_data(Vectors[index].data, dest, Vectors[index].length);
+			dest += Vectors[index].length;
+		}
+
+		result = _send_data(Endpoint, socket_index, data, Size, Flags);
+		free(data);
+
+		return(result);
+	}
+} /* _send_data_vectored */
+
+
+/* 
+ * Static Function: _send_datagram_batch
+ *--------------------------------------------------------------------
+ * Parameters:
+ *  [IN] Endpoint = 
+ *  [IN] Packets = 
+ *  [IN] Count = 
+ *  [OUT] Sent = 
+ *  [IN] Flags =   
+ *
+ * Returns:
+ *   An error code, or 0 - even if flow control stopped us partway
+ *   (*Sent tells how far we got).
+ *
+ * Description:
+ *   Sends each of the packets as its own datagram, a batch per sendmmsg()
+ *   where we have it.
+ *
+ *--------------------------------------------------------------------
+ */
+
+static NMErr _send_datagram_batch(	NMEndpointRef 		Endpoint, 
+									const NMIOVec *		Packets, 
+									unsigned long 		Count, 
+									unsigned long *		Sent,
+									NMFlags 			Flags)
+{
+	DEBUG_ENTRY_EXIT("_send_datagram_batch");
+
+	if (Endpoint->sockets[_datagram_socket] == INVALID_SOCKET)
+	return(kNMParameterErr);
+
+#if (USE_MMSG)
+	UNUSED_PARAMETER(Flags)
+
+	while (*Sent < Count)
+	{
+		struct mmsghdr	messages[DATAGRAM_BATCH_SIZE];
+		struct iovec	iov[DATAGRAM_BATCH_SIZE];
+		unsigned long	batch = Count - *Sent;
+		unsigned long	index;
+		int				result;
+
+		if (batch > DATAGRAM_BATCH_SIZE)
+			batch = DATAGRAM_BATCH_SIZE;
+
+		memset(messages, 0, sizeof(messages));
+		for (index = 0; index < batch; index++)
+		{
+			iov[index].iov_base = Packets[*Sent + index].data;
+			iov[index].iov_len = Packets[*Sent + index].length;
+			messages[index].msg_hdr.msg_iov = &iov[index];
+			messages[index].msg_hdr.msg_iovlen = 1;
+
+			//same deal as _send_data() - active netsprocket-mode datagrams need an address on each send
+			if ((Endpoint->netSprocketMode) && (Endpoint->active))
+			{
+				messages[index].msg_hdr.msg_name = &Endpoint->remoteAddress;
+				messages[index].msg_hdr.msg_namelen = sockaddr_length(&Endpoint->remoteAddress);
+			}
+		}
+
+		result = sendmmsg(Endpoint->sockets[_datagram_socket], messages, batch, 0);
+
+		if (result == -1)
+		{
+			if (errno == EAGAIN)
+				return 0;
+			DEBUG_NETWORK_API("sendmmsg",result);
+			return(kNMInternalErr);
+		}
+
+		*Sent += result;
+
+		//the socket filled up partway through
+		if ((unsigned long) result < batch)
+			break;
+	}
+#else
+	while (*Sent < Count)
+	{
+		NMErr result = _send_data(Endpoint, _datagram_socket, Packets[*Sent].data, Packets[*Sent].length, Flags);
+
+		if (result < 0)
+			return(result);
+		if (result != Packets[*Sent].length)
+			break;
+
+		(*Sent)++;
+	}
+#endif // USE_MMSG
+
+	return 0;
+} /* _send_datagram_batch */
+
+
+/* 
+ * Static Function: _receive_data
+ *--------------------------------------------------------------------
+ * Parameters:
+ *  [IN] Endpoint = 
+ *  [IN] the_socket = 
+ *  [IN] Data = 
+ *  [IN] Size = 
+ *  [IN] Flags =   
+ *
+ * Returns:
+ *  
+ *
+ * Description:
+ *   Function 
+ *
+ *--------------------------------------------------------------------
+ */
+
+//reads stream data, handing it out of the endpoint's receive buffer where we can.
+//we only go to the socket once the buffer is empty, and then take as much as it will hold,
+//so a message's header and body don't each cost a recv()
+static NMSInt32 _receive_stream_data(NMEndpointRef inEndpoint, void *ioData, unsigned long size)
+{
+	NMSInt32	result;
+
+	if (inEndpoint->receiveCount == 0)
+	{
+		//big reads go straight to the caller - no sense copying them through our buffer
+		if (size >= STREAM_RECEIVE_BUFFER_SIZE)
+			return recv(inEndpoint->sockets[_stream_socket], (char *)ioData, size, 0);
+
+		if (inEndpoint->receiveBuffer == NULL)
+		{
+			inEndpoint->receiveBuffer = (char *) malloc(STREAM_RECEIVE_BUFFER_SIZE);
+			if (inEndpoint->receiveBuffer == NULL)
+				return recv(inEndpoint->sockets[_stream_socket], (char *)ioData, size, 0);
+		}
+
+		result = recv(inEndpoint->sockets[_stream_socket], inEndpoint->receiveBuffer, STREAM_RECEIVE_BUFFER_SIZE, 0);
+		if (result <= 0)
+			return result;
+		inEndpoint->receiveOffset = 0;
+		inEndpoint->receiveCount = result;
+	}
+
+	if (size > inEndpoint->receiveCount)
+		size = inEndpoint->receiveCount;
+	machine_move_data(inEndpoint->receiveBuffer + inEndpoint->receiveOffset, ioData, size);
+	inEndpoint->receiveOffset += size;
+	inEndpoint->receiveCount -= size;
+
+	return size;
+}
+
+#if (USE_MMSG)
+//pulls as many datagrams as are waiting (up to a batch) off the socket with one recvmmsg().
+//enumeration requests are answered on the spot, and whatever's left is queued for NMReceiveDatagram
+static NMSInt32 _read_datagram_batch(NMEndpointRef inEndpoint)
+{
+	struct mmsghdr	messages[DATAGRAM_BATCH_SIZE];
+	struct iovec	iov[DATAGRAM_BATCH_SIZE];
+	struct sockaddr_storage	addresses[DATAGRAM_BATCH_SIZE];
+	NMSInt32		result;
+	int				index;
+
+	memset(messages, 0, sizeof(messages));
+	for (index = 0; index < DATAGRAM_BATCH_SIZE; index++)
+	{
+		iov[index].iov_base = inEndpoint->datagramBuffer + (index * DATAGRAM_SLOT_SIZE);
+		iov[index].iov_len = DATAGRAM_SLOT_SIZE;
+		messages[index].msg_hdr.msg_iov = &iov[index];
+		messages[index].msg_hdr.msg_iovlen = 1;
+		messages[index].msg_hdr.msg_name = &addresses[index];
+		messages[index].msg_hdr.msg_namelen = sizeof(addresses[index]);
+	}
+
+	result = recvmmsg(inEndpoint->sockets[_datagram_socket], messages, DATAGRAM_BATCH_SIZE, MSG_DONTWAIT, NULL);
+	if (result <= 0)
+		return result;
+
+	inEndpoint->datagramNext = 0;
+	inEndpoint->datagramCount = 0;
+	for (index = 0; index < result; index++)
+	{
+		char *packet = (char *) iov[index].iov_base;
+
+		if (messages[index].msg_hdr.msg_flags & MSG_TRUNC)
+		{
+			DEBUG_PRINT("dropping a datagram too big for our %d byte slots", DATAGRAM_SLOT_SIZE);
+			continue;
+		}
+		if (_handle_enumeration_request(inEndpoint, packet, messages[index].msg_len, &addresses[index]))
+			continue;
+
+		inEndpoint->datagramSlot[inEndpoint->datagramCount] = index;
+		inEndpoint->datagramLength[inEndpoint->datagramCount] = messages[index].msg_len;
+		inEndpoint->datagramCount++;
+	}
+
+	return result;
+}
+
+//hands out the next datagram from the endpoint's batch, reading another batch if it's empty.
+//returns what recv() would have
+static NMSInt32 _receive_datagram(NMEndpointRef inEndpoint, void *ioData, unsigned long size)
+{
+	NMSInt32	result;
+	char		*packet;
+
+	if (inEndpoint->datagramBuffer == NULL)
+	{
+		inEndpoint->datagramBuffer = (char *) malloc(DATAGRAM_BATCH_SIZE * DATAGRAM_SLOT_SIZE);
+		if (inEndpoint->datagramBuffer == NULL)
+			return recv(inEndpoint->sockets[_datagram_socket], (char *)ioData, size, 0);
+	}
+
+	//(a batch can come back empty if it was all enumeration requests)
+	while (inEndpoint->datagramCount == 0)
+	{
+		result = _read_datagram_batch(inEndpoint);
+		if (result <= 0)
+			return -1;
+	}
+
+	packet = inEndpoint->datagramBuffer + (inEndpoint->datagramSlot[inEndpoint->datagramNext] * DATAGRAM_SLOT_SIZE);
+	result = inEndpoint->datagramLength[inEndpoint->datagramNext];
+	inEndpoint->datagramNext++;
+	inEndpoint->datagramCount--;
+
+	//like recv(), whatever doesn't fit in their buffer is lost
+	if (size < (unsigned long) result)
+		result = size;
+	machine_move_data(packet, ioData, result);
+
+	return result;
+}
+#endif // USE_MMSG
+
+static NMErr _receive_data(NMEndpointRef inEndpoint, int which_socket, 
+                           void *ioData, unsigned long *ioSize, NMFlags *outFlags)
+{
+	NMErr		err = kNMNoError;
+	NMSInt32	result;
+
+	*outFlags = 0;
+	op_vassert_return((inEndpoint != NULL),"inEndpoint is NIL!",kNMParameterErr);
+    op_vassert_return(inEndpoint->cookie==kModuleID, csprintf(sz_temporary, "cookie: 0x%x != 0x%x", inEndpoint->cookie, kModuleID),kNMParameterErr); 
+	op_assert(inEndpoint->sockets[which_socket]!=INVALID_SOCKET);
+
+	if (inEndpoint->needToDie == true)
+		return kNMNoDataErr;
+
+	//(our sockets were made non-blocking when they were set up)
+	if (which_socket == _stream_socket)
+		result = _receive_stream_data(inEndpoint, ioData, *ioSize);
+	else
+	#if (USE_MMSG)
+		result = _receive_datagram(inEndpoint, ioData, *ioSize);
+	#else
+		result = recv(inEndpoint->sockets[which_socket], (char *)ioData, *ioSize, 0);
+	#endif
+
+	if (result == 0)
+	{
+		inEndpoint->needToDie = true;
+		#if (USE_EPOLL)
+			//we ate the edge that told us about this, so make sure the worker hears about it again
+			_rearm_endpoint_socket(inEndpoint, which_socket);
+		#endif
+		return kNMNoDataErr;
+	}
+	
+	//should be more detailed here
+	if (result == -1)
+	{
+		if (op_errno != EWOULDBLOCK)
+			DEBUG_NETWORK_API("recv",result);
+		err= kNMNoDataErr;
+	}
+	else {				
+		*ioSize = result;
+	}
 
 	return err;
 } /* _receive_data */
@@ -748,7 +1552,7 @@ static NMErr _receive_data(NMEndpointRef inEndpoint, int which_socket,
 
 static void _send_datagram_socket(NMEndpointRef endpoint)
 {
-	struct sockaddr_in  address;
+	struct sockaddr_storage address;
 	int    status;
 	NMErr  err;
 	posix_size_type size;
@@ -763,7 +1567,7 @@ static void _send_datagram_socket(NMEndpointRef endpoint)
 	{
 		struct udp_port_struct_from_server  port_data;
 		
-		port_data.port = address.sin_port;
+		port_data.port = sockaddr_port(&address);
 		DEBUG_PRINT("sending udp port: %d",ntohs(port_data.port));
 		
 		err = _send_data(endpoint, _stream_socket, (void *)&port_data, sizeof(port_data), 0);
@@ -825,9 +1629,7 @@ internally_handled_datagram(NMEndpointRef endpoint)
 		
 		if (is_ip_request_packet(packet, bytes_read, endpoint->gameID))
 		{
-			sockaddr	remote_address;
-			char		response_packet[512];
-			NMSInt32	bytes_to_send, result;
+			struct sockaddr_storage	remote_address;
 			posix_size_type   remote_address_size  = sizeof(remote_address);
 
 			DEBUG_PRINT("got an enumeraion-request object");
@@ -836,27 +1638,8 @@ internally_handled_datagram(NMEndpointRef endpoint)
 			bytes_read = recvfrom(endpoint->sockets[_datagram_socket], (char *) &packet, sizeof (packet),
 				0, (sockaddr*) &remote_address, &remote_address_size);
 
-			if (endpoint->advertising)
-			{
-				DEBUG_PRINT("responding");
-				// And respond to it.
-				bytes_to_send= build_ip_enumeration_response_packet(response_packet, endpoint->gameID, 
-					endpoint->version, endpoint->host, endpoint->port, endpoint->name, 0, NULL);
-				op_assert(bytes_to_send<=sizeof (response_packet));
-
-				byteswap_ip_enumeration_packet(response_packet);
-
-				// send!
-				result= sendto(endpoint->sockets[_datagram_socket], response_packet, 
-					bytes_to_send, 0, (sockaddr*) &remote_address, sizeof (remote_address));
-
-				if (result > 0)
-					op_assert(result==bytes_to_send);
-				else if (result < 0)
-					DEBUG_NETWORK_API("Sendto on enum response",result);
-			}
 			// we handled it.
-			handled_internally= true;
+			handled_internally= _handle_enumeration_request(endpoint, packet, bytes_read, &remote_address);
 		}
 
 	} 
@@ -864,6 +1647,47 @@ internally_handled_datagram(NMEndpointRef endpoint)
 	return handled_internally;
 }
 
+//----------------------------------------------------------------------------------------
+// _handle_enumeration_request
+//----------------------------------------------------------------------------------------
+
+//if the datagram is someone looking for games, answer them (if we're advertising) and return true
+static NMBoolean
+_handle_enumeration_request(NMEndpointRef endpoint, char *packet, NMSInt32 length, struct sockaddr_storage *remote_address)
+{
+	char		response_packet[512];
+	NMSInt32	bytes_to_send, result;
+
+	if ((length != kQuerySize) || (!is_ip_request_packet(packet, length, endpoint->gameID)))
+		return false;
+
+	if (endpoint->advertising)
+	{
+		DEBUG_PRINT("responding");
+		// And respond to it.
+		bytes_to_send= build_ip_enumeration_response_packet(response_packet, endpoint->gameID, 
+			endpoint->version, endpoint->host, endpoint->port, endpoint->name, 0, NULL);
+		op_assert(bytes_to_send<=sizeof (response_packet));
+
+		byteswap_ip_enumeration_packet(response_packet);
+
+		// our host field can't hold an IPv6 address, so we tell them who we are this way too
+		bytes_to_send= append_ip_enumeration_extension(response_packet, bytes_to_send, enumeration_host_key());
+		op_assert(bytes_to_send<=sizeof (response_packet));
+
+		// send!
+		result= sendto(endpoint->sockets[_datagram_socket], response_packet, 
+			bytes_to_send, 0, (sockaddr*) remote_address, sockaddr_length(remote_address));
+
+		if (result > 0)
+			op_assert(result==bytes_to_send);
+		else if (result < 0)
+			DEBUG_NETWORK_API("Sendto on enum response",result);
+	}
+
+	return true;
+}
+
 /* 
  * Function: _wait_for_open_complete
  *--------------------------------------------------------------------
@@ -871,74 +1695,112 @@ internally_handled_datagram(NMEndpointRef endpoint)
  *  [IN]  Endpoint = 
  *
  * Returns:
- *  
+ *  kNMNoError once the endpoint's sockets are connected (and it has the
+ *  remote udp port if it needs one), otherwise an error, in which case
+ *  the endpoint has been closed.
  *
  * Description:
- *   Function 
+ *   Sleeps until the worker thread reports that the endpoint is done
+ *   opening - it clears the opening flag and signals the shard's
+ *   openProgress as it does - or that it has given up on it.
  *
  *--------------------------------------------------------------------
  */
 
 static NMErr _wait_for_open_complete(NMEndpointRef Endpoint)
 {
-	int done = 0;
-	long entry_time;
-	long elapsed_time = 0;
-	long max_wait_time = 10 * MACHINE_TICKS_PER_SECOND;
+	NMWorkerShard *shard = Endpoint->shard;
+	NMUInt32 give_up_time = Endpoint->openDeadline + MACHINE_TICKS_PER_SECOND; //the worker should beat us to it
+	NMErr returnValue;
 
 	DEBUG_ENTRY_EXIT("_wait_for_open_complete");
 
-	// both types of non-active endpoints have stream sockets that are already valid
-	// listener endpoints dont need to wait, and a new handed-off socket is already valid too
-	if ( !Endpoint->active && (Endpoint->connectionMode & (1 << _stream_socket)) )
-		MARK_ENDPOINT_AS_VALID(Endpoint,_stream_socket);
-		
-	entry_time = machine_tick_count();
-
-	// wait here for stream and datagram socket confirmations - and also the remote udp port if we're not in nsp mode
-	while (!done && !Endpoint->opening_error && (elapsed_time < max_wait_time))
-	{
-		if (((Endpoint->connectionMode & Endpoint->valid_endpoints) == Endpoint->connectionMode)
-			&& (Endpoint->dynamically_assign_remote_udp_port == false))
-			done = 1;
-		
+	#if (!USE_WORKER_THREAD)
 		//if we're running without a worker thread we need to idle ourself
-		#if (!USE_WORKER_THREAD)
+		while (Endpoint->opening && ((NMSInt32) (machine_tick_count() - give_up_time) < 0))
 			NMIdle(Endpoint);
-		#endif
+	#elif defined(OP_API_NETWORK_SOCKETS)
+		pthread_mutex_lock(&shard->openLock);
+		while (Endpoint->opening && ((NMSInt32) (machine_tick_count() - give_up_time) < 0))
+		{
+			struct timeval now;
+			struct timespec until;
 
-		elapsed_time = machine_tick_count() - entry_time;
-	} 
-	if (done)
+			gettimeofday(&now, NULL);
+			until.tv_sec = now.tv_sec + 1;
+			until.tv_nsec = now.tv_usec * 1000;
+			pthread_cond_timedwait(&shard->openProgress, &shard->openLock, &until);
+		}
+		pthread_mutex_unlock(&shard->openLock);
+	#elif defined(OP_API_NETWORK_WINSOCK)
+		//several openers may share the event, so we don't count on being the one it wakes
+		while (Endpoint->opening && ((NMSInt32) (machine_tick_count() - give_up_time) < 0))
+			WaitForSingleObject(shard->openProgress, OPEN_CHECK_INTERVAL_MSEC);
+	#endif
+
+	if (!Endpoint->opening && !Endpoint->opening_error)
+	{
 		DEBUG_PRINT("_wait_for_open_complete: endpoint successfully constructed");
-		
+		return kNMNoError;
+	}
+
 	if (Endpoint->opening_error)
-		DEBUG_PRINT("_wait_for_open_complete: opening_error %d",Endpoint->opening_error);
-	if (!done)
 	{
-		NMErr returnValue;
-		if (elapsed_time >= max_wait_time)
-			DEBUG_PRINT("timed-out waiting for open complete");
-		
-		Endpoint->alive = false;
-
-		//this gets set if they close before we get a udp port
-		if (Endpoint->opening_error)
-			returnValue =  Endpoint->opening_error;
-		else
-			returnValue =  kNMOpenFailedErr;
-
-		NMClose(Endpoint, false);
-		
-		return returnValue;
+		DEBUG_PRINT("_wait_for_open_complete: opening_error %d",Endpoint->opening_error);
+		returnValue = Endpoint->opening_error;
 	}
 	else
-		return Endpoint->opening_error;
+	{
+		DEBUG_PRINT("timed-out waiting for open complete");
+		returnValue = kNMOpenFailedErr;
+	}
 
-	return(kNMNoError);
+	Endpoint->alive = false;
+	NMClose(Endpoint, false);
+
+	return returnValue;
 } /* _wait_for_open_complete */
 
 
+/* 
+ * Static Function: _finish_open
+ *--------------------------------------------------------------------
+ * Parameters:
+ *  [IN]  Endpoint = an endpoint that has just finished opening
+ *
+ * Returns:
+ *  none
+ *
+ * Description:
+ *   Brings the endpoint to life, so that its callbacks start coming.
+ *
+ *--------------------------------------------------------------------
+ */
+
+static void _finish_open(NMEndpointRef Endpoint)
+{
+	//unleash the dogs.  this lets messages start hitting the callback
+	DEBUG_PRINT("endpoint 0x%x is now alive",Endpoint);
+	Endpoint->alive = true;
+
+	#if (USE_EPOLL)
+		//data that showed up while we were opening was passed over, and won't produce another edge
+		{
+			int index;
+			for (index = 0; index < NUMBER_OF_SOCKETS; ++index)
+				_rearm_endpoint_socket(Endpoint, index);
+		}
+	#endif
+
+	//the same goes for anything that got buffered along with the remote udp port
+	if ((Endpoint->receiveCount > 0) || (_buffered_datagram_count(Endpoint) > 0))
+	{
+		_note_buffered_data(Endpoint);
+		sendWakeMessage(Endpoint->shard);
+	}
+} /* _finish_open */
+
+
 /* 
  * Function: NMOpen
  *--------------------------------------------------------------------
@@ -964,6 +1826,7 @@ NMErr NMOpen(NMConfigRef Config,
 {
 	NMErr  err;
 	int    status;
+	char   *resolveName = NULL;
 
 	DEBUG_ENTRY_EXIT("NMOpen");
 
@@ -992,26 +1855,59 @@ NMErr NMOpen(NMConfigRef Config,
 	{
 		if (Config->host_name[0])
 		{
-			struct sockaddr_in host_info;
+			struct sockaddr_storage host_info;
 
-			status = _lookup_machine(Config->host_name, Config->hostAddr.sin_port, &host_info);
+			//an asynchronous open doesn't wait on the resolver - if the name isn't known yet, the worker picks it up from here
+			status = _lookup_machine(Config->host_name, sockaddr_port(&Config->hostAddr), &host_info, !Config->asyncOpen);
 
-			if (status)
-				memcpy(&(Config->hostAddr), &host_info, sizeof(struct sockaddr_in));
-			else
+			if (status == 1)
+				Config->hostAddr = host_info;
+			else if (status == 0)
 				return(kNMAddressNotFound);
+			else
+			{
+				resolveName = (char *) malloc(strlen(Config->host_name) + 1);
+				if (!resolveName)
+					return(kNMOutOfMemoryErr);
+				strcpy(resolveName, Config->host_name);
+			}
 		}
 	}
 
-	err = _create_endpoint(&(Config->hostAddr), Callback, Context, Endpoint,
-		Active, true, Config->connectionMode, Config->netSprocketMode,
-		Config->version, Config->gameID);
+	err = _create_endpoint(resolveName ? NULL : &(Config->hostAddr), Callback, Context, Endpoint,
+		Active, true, Config->asyncOpen, Config->connectionMode, Config->netSprocketMode,
+		&Config->socketOptions, Config->version, Config->gameID);
 
-	if (!err)
+	if (err)
+	{
+		if (resolveName)
+			free(resolveName);
+	}
+	else
 	{
 		/* copy the name */
 		strcpy((*Endpoint)->name, Config->name);
 
+		#if (USE_EPOLL)
+			_register_endpoint_sockets(*Endpoint);
+		#endif
+
+		//an asynchronous open is the worker's to finish - have it take a look right away
+		if (Config->asyncOpen)
+		{
+			NMWorkerShard *shard = (*Endpoint)->shard;
+
+			//(this is the only thing it can't see without us)
+			LOCK_ENDPOINT_WAITING_LIST(shard);
+			sendWakeMessage(shard);
+			LOCK_ENDPOINT_LIST(shard);
+			(*Endpoint)->resolveName = resolveName;
+			(*Endpoint)->resolvePort = sockaddr_port(&Config->hostAddr);
+			UNLOCK_ENDPOINT_LIST(shard);
+			UNLOCK_ENDPOINT_WAITING_LIST(shard);
+			return(kNMNoError);
+		}
+
 		err = _wait_for_open_complete(*Endpoint);
 	}
 
@@ -1022,9 +1918,7 @@ NMErr NMOpen(NMConfigRef Config,
 		return(err);
 	}
 
-	//unleash the dogs.  this lets messages start hitting the callback
-	DEBUG_PRINT("endpoint 0x%x is now alive",*Endpoint);
-	(*Endpoint)->alive = true;
+	_finish_open(*Endpoint);
 
 	return(kNMNoError);
 } /* NMOpen */
@@ -1051,6 +1945,7 @@ NMErr NMClose(NMEndpointRef Endpoint, NMBoolean Orderly)
 	int index;
 	int status;
 	struct linger linger_option;
+	NMWorkerShard *shard;
 
 	DEBUG_ENTRY_EXIT("NMClose");
 
@@ -1076,17 +1971,24 @@ NMErr NMClose(NMEndpointRef Endpoint, NMBoolean Orderly)
 
 	DEBUG_PRINT("Searching for theEndpoint in NMClose");
 
+	// the worker thread might be in the middle of a long wait for events,
+	// so we get on the waiting list and wake it up, just as when adding an endpoint
+	shard = Endpoint->shard;
+	LOCK_ENDPOINT_WAITING_LIST(shard);
+	sendWakeMessage(shard);
+	LOCK_ENDPOINT_LIST(shard);
+
 	//search for this endpoint on the list, and if its there, remove it
 	{
 		NMBoolean found = false;
 		NMEndpointPriv *theEndpoint;
 
-		theEndpoint = endpointList;
+		theEndpoint = shard->endpointList;
 
 		if (theEndpoint == Endpoint) //we're first on the list
 		{
 			found = true;
-			endpointList = Endpoint->next;
+			shard->endpointList = Endpoint->next;
 		}
 		else while (theEndpoint != NULL)
 		{
@@ -1099,11 +2001,26 @@ NMErr NMClose(NMEndpointRef Endpoint, NMBoolean Orderly)
 			theEndpoint = theEndpoint->next;
 		}
 		if (found)
-			endpointListState++;
+		{
+			shard->endpointListState++;
+			shard->endpointCount--;
+			if (Endpoint->opening)
+			{
+				Endpoint->opening = false;
+				shard->openingCount--;
+			}
+		}
 	}
 
     	DEBUG_PRINT("Done searching for theEndpoint in NMClose");
 
+	#if (USE_EPOLL)
+		_unregister_endpoint_sockets(Endpoint);
+	#endif
+
+	UNLOCK_ENDPOINT_LIST(shard);
+	UNLOCK_ENDPOINT_WAITING_LIST(shard);
+
 	for (index = 0; index < NUMBER_OF_SOCKETS; ++index)
 	{
 		if (Endpoint->sockets[index] != INVALID_SOCKET)
@@ -1125,7 +2042,8 @@ NMErr NMClose(NMEndpointRef Endpoint, NMBoolean Orderly)
 	} /* for (index) */
 
 	// notify that it is closed, if necessary
-	if (Endpoint->alive)
+	// (an asynchronously opened endpoint was handed out before it was alive, so it always needs to hear)
+	if ((Endpoint->alive) || (Endpoint->asyncOpen))
 	{
 		Endpoint->alive = false;
     	DEBUG_PRINT("Notifying about closure in NMClose...");
@@ -1135,9 +2053,13 @@ NMErr NMClose(NMEndpointRef Endpoint, NMBoolean Orderly)
 	Endpoint->cookie = PENDPOINT_BAD_COOKIE;
 
 
+	if (Endpoint->resolveName)
+		free(Endpoint->resolveName);
+
 	/* FIX ME - why free the endpoint pointer here ? */
+	//(it goes back in the pool, receive buffers and all)
 	DEBUG_PRINT("Freeing the Endpoint in NMClose...");
-	free(Endpoint);
+	_release_pooled_endpoint(Endpoint);
 
 	return(kNMNoError);
 } /* NMClose */
@@ -1183,15 +2105,15 @@ NMAcceptConnection(
 
     // create all the data...
     
-    err = _create_endpoint(0, inCallback, inContext, &new_endpoint, false, false, inEndpoint->connectionMode,
-			  inEndpoint->netSprocketMode, inEndpoint->version, inEndpoint->gameID);
+    err = _create_endpoint(0, inCallback, inContext, &new_endpoint, false, false, false, inEndpoint->connectionMode,
+			  inEndpoint->netSprocketMode, &inEndpoint->socketOptions, inEndpoint->version, inEndpoint->gameID);
 
 	if (! err)
 	{
 		new_endpoint->parent = inEndpoint;
 		
    		// create the sockets..
-		sockaddr_in	remote_address;
+		struct sockaddr_storage	remote_address;
 		posix_size_type	remote_length  = sizeof(remote_address);
 
  		// make the accept call...
@@ -1199,13 +2121,24 @@ NMAcceptConnection(
 		new_endpoint->sockets[_stream_socket]= accept(inEndpoint->sockets[_stream_socket], (sockaddr*) &remote_address, 
 													   &remote_length);
 
-		DEBUG_PRINT("the remote address is %d",ntohs(remote_address.sin_port));
+		#if (USE_EPOLL)
+			//there may be more connections waiting behind this one
+			_rearm_endpoint_socket(inEndpoint, _stream_socket);
+		#endif
+
+		DEBUG_PRINT("the remote address is %d",ntohs(sockaddr_port(&remote_address)));
 		if (new_endpoint->sockets[_stream_socket] != INVALID_SOCKET)
 		{
-			sockaddr_in	address;
+			struct sockaddr_storage	address;
 			NMUInt16	required_port;
 			posix_size_type     size  = sizeof(address);
 
+			//accepted sockets don't inherit non-blocking mode from the listener everywhere
+			SetNonBlockingMode(new_endpoint->sockets[_stream_socket]);
+
+			//nor socket options, so set ours (copied from the listener) explicitly
+			_apply_socket_options(new_endpoint, _stream_socket);
+
 			err = getpeername(new_endpoint->sockets[_stream_socket], (sockaddr*) &address, &size);
 
 	  		if (!err)
@@ -1240,6 +2173,10 @@ NMAcceptConnection(
 			strcpy(new_endpoint->name, inEndpoint->name);
 			new_endpoint->status_proc= inEndpoint->status_proc;
 
+			#if (USE_EPOLL)
+				_register_endpoint_sockets(new_endpoint);
+			#endif
+
 			// if we are uber, send our datagram port..
 			if ( ((new_endpoint->connectionMode & _uber_connection) == _uber_connection) && 
 					(!new_endpoint->netSprocketMode) )
@@ -1288,7 +2225,7 @@ NMAcceptConnection(
 NMErr NMRejectConnection(NMEndpointRef Endpoint, void *Cookie)
 {
 	int    closing_socket;
-	struct sockaddr_in remote_address;
+	struct sockaddr_storage remote_address;
 	posix_size_type remote_length = sizeof(remote_address);
 	
 	DEBUG_ENTRY_EXIT("NMRejectConnection");
@@ -1308,6 +2245,11 @@ NMErr NMRejectConnection(NMEndpointRef Endpoint, void *Cookie)
 	DEBUG_PRINT("calling accept()");
 	closing_socket = accept(Endpoint->sockets[_stream_socket], 
 		(sockaddr*)&remote_address, &remote_length);
+
+	#if (USE_EPOLL)
+		//there may be more connections waiting behind this one
+		_rearm_endpoint_socket(Endpoint, _stream_socket);
+	#endif
 	
 	if (closing_socket != INVALID_SOCKET)
 	{
@@ -1442,15 +2384,13 @@ NMGetIdentifier(NMEndpointRef inEndpoint,  char * outIdStr, NMSInt16 inMaxLen)
 		return(kNMInternalErr);
 	
     the_socket = inEndpoint->sockets[_stream_socket];
-    sockaddr_in   remote_address;
-    int			remote_length = sizeof(remote_address);
+    struct sockaddr_storage   remote_address;
+    posix_size_type	remote_length = sizeof(remote_address);
     char result[256];
     
     getpeername(the_socket, (sockaddr*)&remote_address, &remote_length);
     
-    in_addr addr = remote_address.sin_addr;
-
-    sprintf(result, "%s", inet_ntoa(addr));
+    sockaddr_to_string(&remote_address, result, sizeof(result));
 	
     strncpy(outIdStr, result, inMaxLen - 1);
     outIdStr[inMaxLen - 1] = 0;
@@ -1495,8 +2435,12 @@ NMErr NMIdle(NMEndpointRef Endpoint)
 		//while something new is coming in, keep chugging.
 		//stop after 10, however, so we dont get stuck in a loop if something
 		//goes wrong at least..
-		long counter = 0;
-		while ((processEndpoints(false) == true) && (counter < 10)) { counter++; }
+		long index;
+		for (index = 0; index < workerShardCount; index++)
+		{
+			long counter = 0;
+			while ((processEndpoints(&workerShards[index], false) == true) && (counter < 10)) { counter++; }
+		}
 	#endif
 		
   	return(kNMNoError);
@@ -1540,6 +2484,31 @@ NMErr NMFunctionPassThrough(NMEndpointRef Endpoint, unsigned long Selector, void
 			Endpoint->status_proc = (status_proc_ptr) ParamBlock;
 			break;
 
+		case _pass_through_set_no_delay:
+		case _pass_through_set_cork:
+		case _pass_through_set_send_buffer:
+		case _pass_through_set_receive_buffer:
+		{
+			long value = *(long *) ParamBlock;
+			int index;
+
+			if (value < 0)
+				return(kNMParameterErr);
+
+			if (Selector == _pass_through_set_no_delay)
+				Endpoint->socketOptions.noDelay = (value != 0);
+			else if (Selector == _pass_through_set_cork)
+				Endpoint->socketOptions.cork = (value != 0);
+			else if (Selector == _pass_through_set_send_buffer)
+				Endpoint->socketOptions.sendBufferSize = value;
+			else
+				Endpoint->socketOptions.receiveBufferSize = value;
+
+			for (index = 0; index < NUMBER_OF_SOCKETS; ++index)
+				_apply_socket_options(Endpoint, index);
+			break;
+		}
+
 		default:
 			return(kNMUnknownPassThrough);
 			break;
@@ -1593,6 +2562,10 @@ NMErr NMSendDatagram(NMEndpointRef Endpoint, NMUInt8 *Data, unsigned long Size,
 		if (result != Size)
 		{
 			Endpoint->flowBlocked[_datagram_socket] = true; //let em know when they can go again
+			#if (USE_EPOLL)
+				//the socket may have drained before we set the flag - if so, this gets us a fresh edge
+				_rearm_endpoint_socket(Endpoint, _datagram_socket);
+			#endif
 			return kNMFlowErr;
 		}
 		return 0;
@@ -1600,6 +2573,118 @@ NMErr NMSendDatagram(NMEndpointRef Endpoint, NMUInt8 *Data, unsigned long Size,
 } /* NMSendDatagram */
 
 
+/* 
+ * Function: NMSendDatagramv
+ *--------------------------------------------------------------------
+ * Parameters:
+ *  [IN] Endpoint = 
+ *  [IN] Vectors = 
+ *  [IN] Count = 
+ *  [IN] Flags = 
+ *
+ * Returns:
+ *   See NMSendDatagram().
+ *
+ * Description:
+ *   Function to send one datagram made up of several buffers.
+ *
+ *--------------------------------------------------------------------
+ */
+
+NMErr NMSendDatagramv(NMEndpointRef Endpoint, const NMIOVec *Vectors, unsigned long Count, NMFlags Flags)
+{
+	DEBUG_ENTRY_EXIT("NMSendDatagramv");
+
+	if (module_inited < 1)
+		return kNMInternalErr;
+
+	long result;
+	unsigned long Size = 0;
+	unsigned long index;
+
+	if (!Endpoint || (!Vectors && Count))
+		return(kNMParameterErr);
+
+	if (Endpoint->cookie != kModuleID)
+		return(kNMInternalErr);
+
+	for (index = 0; index < Count; index++)
+		Size += Vectors[index].length;
+
+	result = _send_data_vectored(Endpoint, _datagram_socket, Vectors, Count, Flags);
+
+	//same as NMSendDatagram() - errors go back as is, a short send is a flow control error
+	if (result < 0)
+		return(result);
+	else
+	{
+		if ((unsigned long) result != Size)
+		{
+			Endpoint->flowBlocked[_datagram_socket] = true; //let em know when they can go again
+			#if (USE_EPOLL)
+				_rearm_endpoint_socket(Endpoint, _datagram_socket);
+			#endif
+			return kNMFlowErr;
+		}
+		return 0;
+	}
+} /* NMSendDatagramv */
+
+
+/* 
+ * Function: NMSendDatagrams
+ *--------------------------------------------------------------------
+ * Parameters:
+ *  [IN] Endpoint = 
+ *  [IN] Packets = 
+ *  [IN] Count = 
+ *  [OUT] Sent = 
+ *  [IN] Flags = 
+ *
+ * Returns:
+ *   kNMFlowErr if flow control stopped us before all of them went out,
+ *   otherwise see NMSendDatagram().
+ *
+ * Description:
+ *   Function to send several datagrams at once, each entry being one datagram.
+ *   They go out in order, and *Sent says how many made it.
+ *
+ *--------------------------------------------------------------------
+ */
+
+NMErr NMSendDatagrams(NMEndpointRef Endpoint, const NMIOVec *Packets, unsigned long Count, unsigned long *Sent, NMFlags Flags)
+{
+	DEBUG_ENTRY_EXIT("NMSendDatagrams");
+
+	if (module_inited < 1)
+		return kNMInternalErr;
+
+	long result;
+
+	if (!Endpoint || !Sent || (!Packets && Count))
+		return(kNMParameterErr);
+
+	if (Endpoint->cookie != kModuleID)
+		return(kNMInternalErr);
+
+	*Sent = 0;
+	result = _send_datagram_batch(Endpoint, Packets, Count, Sent, Flags);
+
+	if (result < 0)
+		return(result);
+
+	if (*Sent != Count)
+	{
+		Endpoint->flowBlocked[_datagram_socket] = true; //let em know when they can go again
+		#if (USE_EPOLL)
+			_rearm_endpoint_socket(Endpoint, _datagram_socket);
+		#endif
+		return kNMFlowErr;
+	}
+	return 0;
+} /* NMSendDatagrams */
+
+
 /* 
  * Function: NMReceiveDatagram
  *--------------------------------------------------------------------
@@ -1626,6 +2711,7 @@ NMErr NMReceiveDatagram(NMEndpointRef Endpoint, NMUInt8 *Data, unsigned long *Si
 	if (module_inited < 1)
 		return kNMInternalErr;
 
+	NMBoolean callbackWasSent = Endpoint->newDataCallbackSent[_datagram_socket];
 	Endpoint->newDataCallbackSent[_datagram_socket] = false; //we should start telling them of incoming data again
 
 	NMErr err;
@@ -1638,6 +2724,22 @@ NMErr NMReceiveDatagram(NMEndpointRef Endpoint, NMUInt8 *Data, unsigned long *Si
 
 	err = _receive_data(Endpoint, _datagram_socket, Data, Size, Flags);
 
+	#if (USE_EPOLL)
+		//anything left behind after the first read since our callback won't produce another edge,
+		//so have epoll take another look at the socket (the select() version would see it next pass)
+		if ((callbackWasSent) && (err == kNMNoError))
+			_rearm_endpoint_socket(Endpoint, _datagram_socket);
+	#endif
+
+	#if (USE_WORKER_THREAD)
+		//same as NMReceive() - the rest of a batch we've read is invisible to the socket
+		if ((callbackWasSent) && (err == kNMNoError) && (_buffered_datagram_count(Endpoint) > 0) && (_on_worker_thread(Endpoint->shard) == false))
+		{
+			_note_buffered_data(Endpoint);
+			sendWakeMessage(Endpoint->shard);
+		}
+	#endif
+
 	return(err);
 } /* NMReceiveDatagram */
 
@@ -1681,12 +2783,71 @@ NMErr NMSend(NMEndpointRef Endpoint, void *Data, unsigned long Size, NMFlags Fla
 	//if its a positive return value (not an error) and not the same as they requested,
 	//we're flow blocked - start looking for a flow clear
 	if ((result != Size) && (result > 0))
+	{
 		Endpoint->flowBlocked[_stream_socket] = true; //let em know when they can go again
+		#if (USE_EPOLL)
+			//the socket may have drained before we set the flag - if so, this gets us a fresh edge
+			_rearm_endpoint_socket(Endpoint, _stream_socket);
+		#endif
+	}
 
 	return(result);
 } /* NMSend */
 
 
+/* 
+ * Function: NMSendv
+ *--------------------------------------------------------------------
+ * Parameters:
+ *  [IN] Endpoint = 
+ *  [IN] Vectors = 
+ *  [IN] Count = 
+ *  [IN] Flags = 
+ *
+ * Returns:
+ *   See NMSend(). 
+ *
+ * Description:
+ *   Function to send stream data from several buffers at once.
+ *
+ *--------------------------------------------------------------------
+ */
+
+NMErr NMSendv(NMEndpointRef Endpoint, const NMIOVec *Vectors, unsigned long Count, NMFlags Flags)
+{
+	DEBUG_ENTRY_EXIT("NMSendv");
+
+	if (module_inited < 1)
+		return kNMInternalErr;
+
+	long result;
+	unsigned long Size = 0;
+	unsigned long index;
+
+	if (!Endpoint || (!Vectors && Count))
+		return(kNMParameterErr);
+
+	if (Endpoint->cookie != kModuleID)
+		return(kNMInternalErr);
+
+	for (index = 0; index < Count; index++)
+		Size += Vectors[index].length;
+
+	result = _send_data_vectored(Endpoint, _stream_socket, Vectors, Count, Flags);
+
+	//same as NMSend() - a partial send means we're flow blocked
+	if ((result > 0) && ((unsigned long) result != Size))
+	{
+		Endpoint->flowBlocked[_stream_socket] = true; //let em know when they can go again
+		#if (USE_EPOLL)
+			_rearm_endpoint_socket(Endpoint, _stream_socket);
+		#endif
+	}
+
+	return(result);
+} /* NMSendv */
+
+
 /* 
  * Function: NMReceive
  *--------------------------------------------------------------------
@@ -1713,6 +2874,7 @@ NMErr NMReceive(NMEndpointRef Endpoint, void *Data, unsigned long *Size, NMFlags
 	if (module_inited < 1)
 		return kNMInternalErr;
 
+	NMBoolean callbackWasSent = Endpoint->newDataCallbackSent[_stream_socket];
 	Endpoint->newDataCallbackSent[_stream_socket] = false; //we should start telling them of incoming data again
 	
 	NMErr err;
@@ -1725,6 +2887,23 @@ NMErr NMReceive(NMEndpointRef Endpoint, void *Data, unsigned long *Size, NMFlags
 
 	err = _receive_data(Endpoint, _stream_socket, Data, Size, Flags);
 
+	#if (USE_EPOLL)
+		//anything left behind after the first read since our callback won't produce another edge,
+		//so have epoll take another look at the socket (the select() version would see it next pass)
+		if ((callbackWasSent) && (err == kNMNoError))
+			_rearm_endpoint_socket(Endpoint, _stream_socket);
+	#endif
+
+	#if (USE_WORKER_THREAD)
+		//the socket won't tell the worker about what's still in our buffer. reads made from a callback
+		//get checked once it returns, but when reading from elsewhere we have to nudge the worker ourselves
+		if ((callbackWasSent) && (err == kNMNoError) && (Endpoint->receiveCount > 0) && (_on_worker_thread(Endpoint->shard) == false))
+		{
+			_note_buffered_data(Endpoint);
+			sendWakeMessage(Endpoint->shard);
+		}
+	#endif
+
 	return(err);
 } /* NMReceive */
 
@@ -1738,16 +2917,24 @@ NMEnterNotifier(NMEndpointRef inEndpoint, NMEndpointMode endpointMode)
 {
 	DEBUG_ENTRY_EXIT("NMEnterNotifier");
 
-	UNUSED_PARAMETER(inEndpoint);
-	UNUSED_PARAMETER(endpointMode);
-	
+	long index;
+
 	if (module_inited < 1)
 		return kNMInternalErr;
 
-	//we're a wee bit sloppy here - whenever anyone calls this, we halt any callbacks.
-	if (notifierLockCount == 0)
-	ENTER_NOTIFIER();
-	notifierLockCount++;
+	if ((!inEndpoint) || ((endpointMode & kNMNormalMode) == 0))
+		return kNMParameterErr;
+
+	if (inEndpoint->cookie != kModuleID)
+		return kNMInternalErr;
+
+	//this only holds off callbacks for this endpoint, in the modes they asked for - the rest carry on.
+	//(the mode bits match our socket types, and are always taken in the same order so two callers can't each end up holding half)
+	for (index = 0; index < NUMBER_OF_SOCKETS; index++)
+	{
+		if (endpointMode & (1 << index))
+			ENTER_NOTIFIER(NOTIFIER_LOCK(inEndpoint, index));
+	}
 	return kNMNoError;
 }
 
@@ -1761,18 +2948,23 @@ NMLeaveNotifier(NMEndpointRef inEndpoint, NMEndpointMode endpointMode)
 {
 	DEBUG_ENTRY_EXIT("NMLeaveNotifier");
 
-	UNUSED_PARAMETER(inEndpoint);
-	UNUSED_PARAMETER(endpointMode);
-
-	op_assert(notifierLockCount > 0);
+	long index;
 
 	if (module_inited < 1)
 		return kNMInternalErr;
 
-	if (notifierLockCount == 1)
-		LEAVE_NOTIFIER();
-	notifierLockCount--;	
-	
+	//(they may have closed the endpoint while they had it, so we don't look inside)
+	if ((!inEndpoint) || ((endpointMode & kNMNormalMode) == 0))
+		return kNMParameterErr;
+
+	for (index = NUMBER_OF_SOCKETS - 1; index >= 0; index--)
+	{
+		if (endpointMode & (1 << index))
+			LEAVE_NOTIFIER(NOTIFIER_LOCK(inEndpoint, index));
+	}
+
+	//anything that came in while they had it has been waiting - get the worker to hand it out now
+	_wake_deferred_shards(NULL);
 	return kNMNoError;
 }
 
@@ -1793,139 +2985,1105 @@ NMLeaveNotifier(NMEndpointRef inEndpoint, NMEndpointMode endpointMode)
  *--------------------------------------------------------------------
  */
 
-NMBoolean NMStartAdvertising(NMEndpointRef Endpoint)
-{
-	DEBUG_ENTRY_EXIT("NMStartAdvertising");
+NMBoolean NMStartAdvertising(NMEndpointRef Endpoint)
+{
+	DEBUG_ENTRY_EXIT("NMStartAdvertising");
+
+	if (module_inited < 1)
+		return(false);   //kNMInternalErr;
+
+	if (!Endpoint)
+		return(false);
+
+	Endpoint->advertising = true;
+
+	return(true);
+
+} /* NMStartAdvertising */
+
+
+/* 
+ * Function: NMStopAdvertising
+ *--------------------------------------------------------------------
+ * Parameters:
+ *  [IN] Endpoint = 
+ *
+ * Returns:
+ *   true  = if stop succeeded
+ *   false = on any error condition
+ *
+ * Description:
+ *   Function to stop advertising games. 
+ *
+ *--------------------------------------------------------------------
+ */
+
+NMBoolean NMStopAdvertising(NMEndpointRef Endpoint)
+{
+	DEBUG_ENTRY_EXIT("NMStopAdvertising");
+
+	if (module_inited < 1)
+		return(false);  //kNMInternalErr;
+
+	if (!Endpoint)
+		return(false);
+
+	Endpoint->advertising = false;
+
+	return(true);
+
+} /* NMStopAdvertising */
+
+//sets up our pool of worker shards - one unless the environment asks for more
+int createWorkerShards(void)
+{
+	char *env_ptr;
+	long index;
+	NMBoolean success = true;
+
+	workerShardCount = 1;
+	env_ptr = getenv(kWorkerShardCountVariable);
+	if (env_ptr)
+	{
+		workerShardCount = atol(env_ptr);
+		if (workerShardCount < 1)
+			workerShardCount = 1;
+		if (workerShardCount > MAXIMUM_WORKER_SHARDS)
+			workerShardCount = MAXIMUM_WORKER_SHARDS;
+		DEBUG_PRINT("env \"%s\" == %s, using %d worker shards",kWorkerShardCountVariable,env_ptr,workerShardCount);
+	}
+
+	workerShards = (NMWorkerShard *) calloc(workerShardCount, sizeof(NMWorkerShard));
+	if (!workerShards)
+	{
+		workerShardCount = 0;
+		return false;
+	}
+
+	notifierLocks = new NMNotifierLock[NOTIFIER_LOCK_STRIPES * NUMBER_OF_SOCKETS];
+	for (index = 0; index < NOTIFIER_LOCK_STRIPES * NUMBER_OF_SOCKETS; index++)
+	{
+		notifierLocks[index].held = false;
+		notifierLocks[index].depth = 0;
+	}
+
+	for (index = 0; index < workerShardCount; index++)
+	{
+		NMWorkerShard *shard = &workerShards[index];
+
+		shard->endpointListLock = new machine_lock;
+		shard->endpointWaitingListLock = new machine_lock;
+		#ifdef OP_API_NETWORK_SOCKETS
+			pthread_mutex_init(&shard->openLock, NULL);
+			pthread_cond_init(&shard->openProgress, NULL);
+		#elif defined(OP_API_NETWORK_WINSOCK)
+			shard->openProgress = CreateEvent(NULL, FALSE, FALSE, NULL);
+		#endif
+		#if (USE_EPOLL)
+			shard->eventSet = -1;
+		#endif
+
+		if (createWakeSocket(shard) == false)
+			success = false;
+
+		#if (USE_EPOLL)
+			//the wake socket must exist before this, as it gets added to the set
+			if (createEventSet(shard) == false)
+				success = false;
+		#endif
+	}
+	return success;
+}
+
+void disposeWorkerShards(void)
+{
+	long index;
+
+	for (index = 0; index < workerShardCount; index++)
+	{
+		NMWorkerShard *shard = &workerShards[index];
+
+		delete shard->endpointListLock;
+		delete shard->endpointWaitingListLock;
+		#ifdef OP_API_NETWORK_SOCKETS
+			pthread_cond_destroy(&shard->openProgress);
+			pthread_mutex_destroy(&shard->openLock);
+		#elif defined(OP_API_NETWORK_WINSOCK)
+			CloseHandle(shard->openProgress);
+		#endif
+
+		disposeWakeSocket(shard);
+
+		#if (USE_EPOLL)
+			disposeEventSet(shard);
+		#endif
+	}
+
+	if (workerShards)
+		free(workerShards);
+	workerShards = NULL;
+	workerShardCount = 0;
+
+	if (notifierLocks)
+		delete [] notifierLocks;
+	notifierLocks = NULL;
+}
+
+//makes the endpoint pool, and enough endpoints to start it off
+int createEndpointPool(void)
+{
+	char *env_ptr;
+	long size = DEFAULT_ENDPOINT_POOL_SIZE;
+	NMEndpointPriv *endpoint;
+
+	env_ptr = getenv(kEndpointPoolSizeVariable);
+	if (env_ptr)
+	{
+		size = atol(env_ptr);
+		if (size < 0)
+			size = 0;
+		if (size > MAXIMUM_ENDPOINT_POOL_SIZE)
+			size = MAXIMUM_ENDPOINT_POOL_SIZE;
+		DEBUG_PRINT("env \"%s\" == %s, pooling %d endpoints",kEndpointPoolSizeVariable,env_ptr,size);
+	}
+
+	endpointPoolLock = new machine_lock;
+
+	while (endpointPoolCount < size)
+	{
+		endpoint = (NMEndpointPriv *) calloc(1, sizeof(NMEndpointPriv));
+		if (!endpoint)
+			return false;
+		_release_pooled_endpoint(endpoint);
+	}
+	return true;
+}
+
+void disposeEndpointPool(void)
+{
+	NMEndpointPriv *endpoint;
+
+	while (endpointPool)
+	{
+		endpoint = endpointPool;
+		endpointPool = endpoint->next;
+
+		if (endpoint->receiveBuffer)
+			free(endpoint->receiveBuffer);
+		#if (USE_MMSG)
+			if (endpoint->datagramBuffer)
+				free(endpoint->datagramBuffer);
+		#endif
+		free(endpoint);
+	}
+	endpointPoolTail = NULL;
+	endpointPoolCount = 0;
+
+	if (endpointPoolLock)
+		delete endpointPoolLock;
+	endpointPoolLock = NULL;
+}
+
+//hands out a zeroed endpoint, from the pool if there's one there.
+//(any buffers it had from its last life are kept, since they'll be wanted again)
+static NMEndpointPriv *_get_pooled_endpoint(void)
+{
+	NMEndpointPriv *endpoint = NULL;
+	char *receiveBuffer = NULL;
+	#if (USE_MMSG)
+		char *datagramBuffer = NULL;
+	#endif
+
+	if (endpointPoolLock)
+	{
+		machine_wait_for_lock(endpointPoolLock);
+		endpoint = endpointPool;
+		if (endpoint)
+		{
+			endpointPool = endpoint->next;
+			if (!endpointPool)
+				endpointPoolTail = NULL;
+			endpointPoolCount--;
+		}
+		machine_clear_lock(endpointPoolLock);
+	}
+
+	if (!endpoint)
+		return (NMEndpointPriv *) calloc(1, sizeof(NMEndpointPriv));
+
+	receiveBuffer = endpoint->receiveBuffer;
+	#if (USE_MMSG)
+		datagramBuffer = endpoint->datagramBuffer;
+	#endif
+
+	machine_mem_zero(endpoint, sizeof(NMEndpointPriv));
+
+	endpoint->receiveBuffer = receiveBuffer;
+	#if (USE_MMSG)
+		endpoint->datagramBuffer = datagramBuffer;
+	#endif
+	return endpoint;
+}
+
+//puts a closed endpoint at the back of the pool, or frees it if the pool is full.
+//(at the back, so the address isn't handed out again until as long as possible after it closed)
+static void _release_pooled_endpoint(NMEndpointPriv *endpoint)
+{
+	if (endpointPoolLock)
+	{
+		machine_wait_for_lock(endpointPoolLock);
+		if (endpointPoolCount < MAXIMUM_ENDPOINT_POOL_SIZE)
+		{
+			endpoint->next = NULL;
+			if (endpointPoolTail)
+				endpointPoolTail->next = endpoint;
+			else
+				endpointPool = endpoint;
+			endpointPoolTail = endpoint;
+			endpointPoolCount++;
+			endpoint = NULL;
+		}
+		machine_clear_lock(endpointPoolLock);
+	}
+
+	if (endpoint)
+	{
+		if (endpoint->receiveBuffer)
+			free(endpoint->receiveBuffer);
+		#if (USE_MMSG)
+			if (endpoint->datagramBuffer)
+				free(endpoint->datagramBuffer);
+		#endif
+		free(endpoint);
+	}
+}
+
+//new endpoints go to whichever shard is watching the fewest.
+//(the counts are only read here, so a slightly stale one just makes for a slightly less even split)
+static NMWorkerShard *_choose_worker_shard(void)
+{
+	NMWorkerShard *best = &workerShards[0];
+	long index;
+
+	for (index = 1; index < workerShardCount; index++)
+	{
+		if (workerShards[index].endpointCount < best->endpointCount)
+			best = &workerShards[index];
+	}
+	return best;
+}
+
+int createWakeSocket(NMWorkerShard *shard)
+{
+	struct sockaddr Server_Address;
+	int result;
+	posix_size_type nameLen = sizeof(Server_Address);
+	
+		
+	shard->wakeSocket = 0;
+	shard->wakeHostSocket = 0;
+	
+	machine_mem_zero((char *) &Server_Address, sizeof(Server_Address));	
+	((sockaddr_in *) &Server_Address)->sin_family = AF_INET;
+	((sockaddr_in *) &Server_Address)->sin_addr.s_addr = INADDR_ANY;
+	((sockaddr_in *) &Server_Address)->sin_port = 0;
+	
+	shard->wakeHostSocket = socket(AF_INET, SOCK_DGRAM, 0);
+	if (!shard->wakeHostSocket)	return false;
+	result = bind(shard->wakeHostSocket, (struct sockaddr *)&Server_Address, sizeof(Server_Address));
+	if (result == -1)	return false;
+	shard->wakeSocket = socket(AF_INET, SOCK_DGRAM, 0);
+	if (!shard->wakeSocket)	return false;
+	result = bind(shard->wakeSocket, (struct sockaddr *)&Server_Address, sizeof(Server_Address));
+	if (result == -1)	return false;
+	
+	result = getsockname(shard->wakeHostSocket, (struct sockaddr *)&Server_Address, &nameLen);
+	if (result == -1)	return false;
+	result = connect(shard->wakeSocket,(sockaddr*)&Server_Address,sizeof(Server_Address));
+	if (result == -1)	return false;
+	
+//	result = send(wakeSocket,buffer,1,0);
+//	if (result == -1)	return false;
+		
+//	long amountIn = recv(wakeHostSocket,buffer,sizeof(buffer),0);
+//	printf("in buffer: %d\n",amountIn);
+	return true;
+}
+
+void disposeWakeSocket(NMWorkerShard *shard)
+{
+	if (shard->wakeSocket)
+		close(shard->wakeSocket);
+	if (shard->wakeHostSocket)
+		close(shard->wakeHostSocket);
+}
+
+
+//sends a small datagram to a shard's "wake" socket to try and break out of its select() call
+void sendWakeMessage(NMWorkerShard *shard)
+{
+	char buffer[10];
+	//DEBUG_PRINT("sending wake message");
+	int result = send(shard->wakeSocket,buffer,1,0);
+	//DEBUG_PRINT("sendWakeMessage result: %d",result);
+}
+
+
+void SetNonBlockingMode(int fd)
+{
+
+	DEBUG_ENTRY_EXIT("SetNonBlockingMode");
+
+#ifdef OP_API_NETWORK_SOCKETS
+	int val = fcntl(fd, F_GETFL,0); //get current file descriptor flags
+	if (val < 0)
+	{
+		DEBUG_PRINT("error: fcntl() failed to get flags for fd %d: err %d",fd,op_errno);
+		return;
+	}
+
+	val |= O_NONBLOCK; //turn non-blocking on
+	if (fcntl(fd, F_SETFL, val) < 0)
+	{
+		DEBUG_PRINT("error: fcntl() failed to set flags for fd %d: err %d",fd,op_errno);
+	}
+#elif defined(OP_API_NETWORK_WINSOCK)
+	unsigned long DataVal = 1;
+	long result = ioctlsocket(fd,FIONBIO,&DataVal);
+	op_assert(result == 0);
+#endif
+}
+
+//makes a socket of the given family. IPv6 ones are made to take IPv4 too, as v4-mapped addresses
+int open_socket(int family, int type)
+{
+	int fd = socket(family, type, 0);
+
+	if ((fd != INVALID_SOCKET) && (family == AF_INET6))
+	{
+		int off = 0;
+
+		//(if this fails the socket still works, just for IPv6 alone)
+		if (setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, (char*)&off, sizeof(off)) != 0)
+		{
+			DEBUG_NETWORK_API("setsockopt for dual-stack", op_errno);
+		}
+	}
+	return fd;
+}
+
+//the family to listen with - IPv6 if this machine has it (our sockets then take both), otherwise IPv4
+int passive_socket_family(void)
+{
+	static int family = AF_UNSPEC;
+
+	if (family == AF_UNSPEC)
+	{
+		int fd = open_socket(AF_INET6, SOCK_DGRAM);
+		int v6only = 1;
+		posix_size_type size = sizeof(v6only);
+
+		family = AF_INET;
+		if (fd != INVALID_SOCKET)
+		{
+			//if it won't take IPv4 too, we'd rather just have IPv4
+			if ((getsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, (char*)&v6only, &size) == 0) && (v6only == 0))
+				family = AF_INET6;
+			close(fd);
+		}
+		DEBUG_PRINT("listening with %s sockets", (family == AF_INET6) ? "dual-stack IPv6" : "IPv4");
+	}
+	return family;
+}
+
+//the wildcard address of a family, with a port (network order)
+void any_sockaddr(struct sockaddr_storage *address, int family, unsigned short port)
+{
+	machine_mem_zero(address, sizeof(*address));
+	address->ss_family = family;
+	if (family == AF_INET6)
+		((struct sockaddr_in6 *) address)->sin6_addr = in6addr_any;
+	else
+		((struct sockaddr_in *) address)->sin_addr.s_addr = INADDR_ANY;
+	set_sockaddr_port(address, port);
+}
+
+//an address's port, in network order
+unsigned short sockaddr_port(const struct sockaddr_storage *address)
+{
+	if (address->ss_family == AF_INET6)
+		return ((const struct sockaddr_in6 *) address)->sin6_port;
+	return ((const struct sockaddr_in *) address)->sin_port;
+}
+
+void set_sockaddr_port(struct sockaddr_storage *address, unsigned short port)
+{
+	if (address->ss_family == AF_INET6)
+		((struct sockaddr_in6 *) address)->sin6_port = port;
+	else
+		((struct sockaddr_in *) address)->sin_port = port;
+}
+
+//how much of the storage the address takes - some systems won't take the whole thing for an IPv4 one
+posix_size_type sockaddr_length(const struct sockaddr_storage *address)
+{
+	if (address->ss_family == AF_INET6)
+		return sizeof(struct sockaddr_in6);
+	return sizeof(struct sockaddr_in);
+}
+
+//an IPv4 (or v4-mapped IPv6) address in host order, otherwise 0
+NMUInt32 sockaddr_ipv4_host(const struct sockaddr_storage *address)
+{
+	if (address->ss_family == AF_INET)
+		return ntohl(((const struct sockaddr_in *) address)->sin_addr.s_addr);
+	if ((address->ss_family == AF_INET6) && (IN6_IS_ADDR_V4MAPPED(&((const struct sockaddr_in6 *) address)->sin6_addr)))
+	{
+		NMUInt32 host;
+		machine_copy_data((char *) &((const struct sockaddr_in6 *) address)->sin6_addr + 12, (char *) &host, sizeof(host));
+		return ntohl(host);
+	}
+	return 0;
+}
+
+//the numeric form of an address (no port) - a v4-mapped one comes out as plain IPv4, since that's what it is
+void sockaddr_to_string(const struct sockaddr_storage *address, char *text, long length)
+{
+	struct sockaddr_storage plain = *address;
+
+	if ((address->ss_family == AF_INET6) && (IN6_IS_ADDR_V4MAPPED(&((const struct sockaddr_in6 *) address)->sin6_addr)))
+	{
+		any_sockaddr(&plain, AF_INET, sockaddr_port(address));
+		((struct sockaddr_in *) &plain)->sin_addr.s_addr = htonl(sockaddr_ipv4_host(address));
+	}
+
+	if ((length < 1) || (getnameinfo((struct sockaddr *) &plain, sockaddr_length(&plain), text, length, NULL, 0, NI_NUMERICHOST) != 0))
+	{
+		if (length > 0)
+			text[0] = 0;
+	}
+}
+
+//what we call ourselves in enumeration responses - made up once, and the same for every listener we have
+NMUInt32 enumeration_host_key(void)
+{
+	static NMUInt32 key = 0;
+
+	while (key == 0)
+		key = (machine_tick_count() * 2654435761UL) ^ ((NMUInt32) time(NULL) << 12) ^ (NMUInt32) (unsigned long) &key;
+	return key;
+}
+
+
+//grabs the endpoint list for a pass of processEndpoints().
+//anyone adding or removing endpoints hops on the waiting list and wakes us before taking the list,
+//so when blocking we simply queue up behind them rather than polling for the locks
+static NMBoolean _lock_endpoint_list_for_processing(NMWorkerShard *shard, NMBoolean block)
+{
+	if (block)
+	{
+		LOCK_ENDPOINT_WAITING_LIST(shard);
+		LOCK_ENDPOINT_LIST(shard);
+		UNLOCK_ENDPOINT_WAITING_LIST(shard);
+		return true;
+	}
+
+	//when we're being idled, we dont wait around for the list
+	if (TRY_LOCK_ENDPOINT_WAITING_LIST(shard) == false)
+		return false;
+
+	if (TRY_LOCK_ENDPOINT_LIST(shard) == false)
+	{
+		UNLOCK_ENDPOINT_WAITING_LIST(shard);
+		return false;
+	}
+	UNLOCK_ENDPOINT_WAITING_LIST(shard);
+	return true;
+}
+
+#if (USE_WORKER_THREAD)
+//true if we're being called from the shard's own worker (ie from within one of its callbacks)
+static NMBoolean _on_worker_thread(NMWorkerShard *shard)
+{
+	#ifdef OP_API_NETWORK_SOCKETS
+		return (pthread_equal(pthread_self(), shard->worker_thread) != 0);
+	#elif defined(OP_API_NETWORK_WINSOCK)
+		return (GetCurrentThreadId() == shard->worker_thread);
+	#endif
+}
+#endif
+
+//a background enumeration's socket has to wake the first worker like any of its endpoints' sockets.
+//(with select() there's nothing to do but let it know - it asks watchBackgroundEnumerations each pass)
+void watchEnumerationSocket(int socket, NMBoolean watch)
+{
+	if (workerShardCount == 0)
+		return;
+
+	#if (USE_EPOLL)
+		if (workerShards[0].eventSet != -1)
+		{
+			struct epoll_event event;
+
+			//level-triggered, since it's drained after the wait rather than when it's reported
+			machine_mem_zero(&event, sizeof(event));
+			event.events = EPOLLIN;
+			event.data.u64 = ENUMERATION_EVENT_DATA;
+			epoll_ctl(workerShards[0].eventSet, watch ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, socket, &event);
+		}
+	#endif
+
+	sendWakeMessage(&workerShards[0]);
+}
+
+//true if we're on the worker that looks after background enumerations
+NMBoolean onEnumerationWorker(void)
+{
+	#if (USE_WORKER_THREAD)
+		if (workerShardCount > 0)
+			return _on_worker_thread(&workerShards[0]);
+	#endif
+	return false;
+}
+
+//if they've taken some of our buffered stream data (or datagrams) but left the rest, the socket may
+//have nothing more to say - so we remember to tell them about it ourselves next pass
+static void _note_buffered_data(NMEndpointPriv *endpoint)
+{
+	if (((endpoint->receiveCount > 0) && (endpoint->newDataCallbackSent[_stream_socket] == false)) ||
+		((_buffered_datagram_count(endpoint) > 0) && (endpoint->newDataCallbackSent[_datagram_socket] == false)))
+	{
+		endpoint->receivePending = true;
+		endpoint->shard->receivePending = true;
+	}
+}
+
+//datagrams we've already pulled off the socket and are holding for them
+static long _buffered_datagram_count(NMEndpointRef endpoint)
+{
+	#if (USE_MMSG)
+		return endpoint->datagramCount;
+	#else
+		UNUSED_PARAMETER(endpoint)
+		return 0;
+	#endif
+}
+
+//hands out the data callbacks we noted above, just as if the socket had become readable.
+//this function is always called with access to a locked endpoint-list, and returns a locked list.
+static void _deliver_buffered_data(NMWorkerShard *shard)
+{
+	NMUInt32 listStartState = shard->endpointListState;
+	NMEndpointPriv *theEndPoint;
+
+	shard->receivePending = false;
+	for (theEndPoint = shard->endpointList; theEndPoint != NULL; theEndPoint = theEndPoint->next)
+	{
+		if (theEndPoint->receivePending == false)
+			continue;
+		theEndPoint->receivePending = false;
+
+		if (theEndPoint->receiveCount > 0)
+			processEndPointSocket(theEndPoint, _stream_socket, _socket_readable);
+		if ((listStartState == shard->endpointListState) && (_buffered_datagram_count(theEndPoint) > 0))
+			processEndPointSocket(theEndPoint, _datagram_socket, _socket_readable);
+
+		//the rest will have to wait for next time
+		if (listStartState != shard->endpointListState)
+		{
+			shard->receivePending = true;
+			break;
+		}
+	}
+}
+
+//takes a notifier lock (or just tries to), or goes one deeper if this thread already has it.
+//only the holder ever sets owner, so if held is set and owner is us, it's ours
+static NMBoolean _enter_notifier(NMNotifierLock *notifier, NMBoolean block)
+{
+	#ifdef OP_API_NETWORK_SOCKETS
+		pthread_t self = pthread_self();
+		#define IS_NOTIFIER_OWNER(n) (pthread_equal((n)->owner, self) != 0)
+	#elif defined(OP_API_NETWORK_WINSOCK)
+		DWORD self = GetCurrentThreadId();
+		#define IS_NOTIFIER_OWNER(n) ((n)->owner == self)
+	#endif
+
+	if ((notifier->held) && (IS_NOTIFIER_OWNER(notifier)))
+	{
+		notifier->depth++;
+		return true;
+	}
+	#undef IS_NOTIFIER_OWNER
+
+	if (block)
+		machine_wait_for_lock(&notifier->lock);
+	else if (machine_acquire_lock(&notifier->lock) == false)
+		return false;
+
+	notifier->owner = self;
+	notifier->depth = 1;
+	notifier->held = true;
+	return true;
+}
+
+static void _leave_notifier(NMNotifierLock *notifier)
+{
+	if (--notifier->depth > 0)
+		return;
+	notifier->held = false;
+	machine_clear_lock(&notifier->lock);
+}
+
+//holds off callbacks for an endpoint in every mode, for news that isn't about one socket in particular.
+//we only try, since they may have it - and if they do, we note that we've something waiting for them
+static NMBoolean _try_enter_endpoint_notifiers(NMEndpointPriv *endpoint)
+{
+	long index;
+
+	for (index = 0; index < NUMBER_OF_SOCKETS; index++)
+	{
+		if (TRY_ENTER_NOTIFIER(NOTIFIER_LOCK(endpoint, index)) == false)
+		{
+			while (--index >= 0)
+				LEAVE_NOTIFIER(NOTIFIER_LOCK(endpoint, index));
+			endpoint->shard->eventsDeferred = true;
+			return false;
+		}
+	}
+	return true;
+}
+
+//we're usually letting go after a callback, which may have closed the endpoint - so we're given its shard,
+//and only use the endpoint's address to find the locks
+static void _leave_endpoint_notifiers(NMEndpointPriv *endpoint, NMWorkerShard *shard)
+{
+	long index;
+
+	for (index = NUMBER_OF_SOCKETS - 1; index >= 0; index--)
+		LEAVE_NOTIFIER(NOTIFIER_LOCK(endpoint, index));
+	_wake_deferred_shards(shard);
+}
+
+//a worker letting go of a notifier - another worker may have had to put off a handoff to one of our listeners because we had it
+static void _leave_socket_notifier(NMWorkerShard *shard, NMNotifierLock *notifier)
+{
+	LEAVE_NOTIFIER(notifier);
+	_wake_deferred_shards(shard);
+}
+
+//wakes any worker (but the one given) that has events waiting on a notifier, so it tries them again
+static void _wake_deferred_shards(NMWorkerShard *except)
+{
+	long index;
+
+	for (index = 0; index < workerShardCount; index++)
+	{
+		if ((&workerShards[index] != except) && (workerShards[index].eventsDeferred))
+			sendWakeMessage(&workerShards[index]);
+	}
+}
+
+//they've got the endpoint's notifier, so we hang on to the socket's news until they let go of it.
+//we don't rearm (or select()) the socket meanwhile - it would only tell us the same thing over and over
+static void _defer_endpoint_events(NMEndpointPriv *endpoint, long socketType, long socketEvents)
+{
+	if (socketEvents == 0)
+		return;
+	endpoint->deferredEvents[socketType] |= socketEvents;
+	endpoint->shard->eventsDeferred = true;
+}
+
+//hands out the socket events we deferred above, as if they had just come in.
+//this function is always called with access to a locked endpoint-list, and returns a locked list.
+static void _deliver_deferred_events(NMWorkerShard *shard)
+{
+	NMUInt32 listStartState = shard->endpointListState;
+	NMEndpointPriv *theEndPoint;
+	long socketType;
+
+	shard->eventsDeferred = false;
+	for (theEndPoint = shard->endpointList; theEndPoint != NULL; theEndPoint = theEndPoint->next)
+	{
+		//a death that was waiting on the notifier goes first (if they've still got it, it waits again)
+		if ((theEndPoint->needToDie == true) && (theEndPoint->dying == false))
+		{
+			_start_endpoint_dying(theEndPoint);
+			if (listStartState != shard->endpointListState)
+			{
+				shard->eventsDeferred = true;
+				break;
+			}
+		}
+
+		for (socketType = 0; socketType < NUMBER_OF_SOCKETS; socketType++)
+		{
+			long socketEvents = theEndPoint->deferredEvents[socketType];
+
+			if (socketEvents == 0)
+				continue;
+			theEndPoint->deferredEvents[socketType] = 0;
+
+			//(if they've still got it, this just defers them again)
+			processEndPointSocket(theEndPoint, socketType, socketEvents);
+			if (listStartState != shard->endpointListState)
+				break;
+		}
+
+		//the rest will have to wait for next time
+		if (listStartState != shard->endpointListState)
+		{
+			shard->eventsDeferred = true;
+			break;
+		}
+	}
+}
+
+//if an endpoint needs to die, start it dying and let the user know
+//this function is always called with access to a locked endpoint-list, and returns a locked list.
+static void _start_endpoint_dying(NMEndpointPriv *theEndPoint)
+{
+	NMWorkerShard *shard = theEndPoint->shard;
+
+	if ((theEndPoint->needToDie == true) && (theEndPoint->dying == false))
+	{
+		//if they're holding the notifier, it waits with the deferred events - a closed socket may never
+		//tell us anything again, so we can't count on another event to bring us back here
+		if ((theEndPoint->alive == true) && (_try_enter_endpoint_notifiers(theEndPoint) == false))
+			return;
+
+		theEndPoint->dying = true;
+
+		//only inform them of its demise if its been fully formed
+		if (theEndPoint->alive == true)
+		{
+			UNLOCK_ENDPOINT_LIST(shard); //they'll probably kill the endpoint (and thus modify the list) as a result
+			//tell the player the endpoint died and make sure we don't do anything else with it
+			theEndPoint->callback(theEndPoint,theEndPoint->user_context,kNMEndpointDied,0,NULL);
+			LOCK_ENDPOINT_LIST(shard);
+			_leave_endpoint_notifiers(theEndPoint, shard);
+		}
+	}
+}
+
+//checks on the endpoints being opened on this shard. once one is connected (and has the remote udp port if it needs one),
+//has failed, or has run out of time, it's done opening: synchronous openers are woken up to see which,
+//and asynchronous ones are finished off here and told with a kNMOpenComplete callback.
+//this function is always called with access to a locked endpoint-list, and returns a locked list.
+static void _note_open_progress(NMWorkerShard *shard)
+{
+	NMUInt32 listStartState = shard->endpointListState;
+	NMEndpointPriv *theEndPoint;
+	NMBoolean wakeOpeners = false;
+	NMErr err;
+
+	for (theEndPoint = shard->endpointList; theEndPoint != NULL; theEndPoint = theEndPoint->next)
+	{
+		if (theEndPoint->opening == false)
+			continue;
+
+		//if our host name is being looked up, see if it's come back yet
+		if ((theEndPoint->resolveName) && (theEndPoint->opening_error == 0))
+		{
+			struct sockaddr_storage hostAddr;
+			int status = _lookup_machine(theEndPoint->resolveName, theEndPoint->resolvePort, &hostAddr, false);
+
+			if (status == 0)
+				theEndPoint->opening_error = kNMAddressNotFound;
+			else if (status == 1)
+			{
+				free(theEndPoint->resolveName);
+				theEndPoint->resolveName = NULL;
+
+				//the connect gets as long as it would have if the name had been known to begin with
+				theEndPoint->openDeadline = machine_tick_count() + OPEN_TIMEOUT_TICKS;
+				theEndPoint->opening_error = _create_endpoint_sockets(theEndPoint, &hostAddr, theEndPoint->active);
+				#if (USE_EPOLL)
+					_register_endpoint_sockets(theEndPoint);
+				#endif
+			}
+		}
+
+		if ((theEndPoint->opening_error == 0)
+			&& (((theEndPoint->connectionMode & theEndPoint->valid_endpoints) != theEndPoint->connectionMode)
+				|| (theEndPoint->dynamically_assign_remote_udp_port)))
+		{
+			//still on its way - unless its out of time
+			if ((NMSInt32) (machine_tick_count() - theEndPoint->openDeadline) < 0)
+				continue;
 
-	if (module_inited < 1)
-		return(false);   //kNMInternalErr;
+			DEBUG_PRINT("timed-out waiting for open complete on 0x%x",theEndPoint);
+			theEndPoint->opening_error = kNMOpenFailedErr;
+		}
 
-	if (!Endpoint)
-		return(false);
+		if (theEndPoint->asyncOpen == false)
+		{
+			#ifdef OP_API_NETWORK_SOCKETS
+				pthread_mutex_lock(&shard->openLock);
+			#endif
+			theEndPoint->opening = false;
+			shard->openingCount--;
+			#ifdef OP_API_NETWORK_SOCKETS
+				pthread_mutex_unlock(&shard->openLock);
+			#endif
+			wakeOpeners = true;
+			continue;
+		}
 
-	Endpoint->advertising = true;
+		//they may be in the middle of something with the notifier held - if so, we'll be back
+		if (_try_enter_endpoint_notifiers(theEndPoint) == false)
+			continue;
 
-	return(true);
+		theEndPoint->opening = false;
+		shard->openingCount--;
 
-} /* NMStartAdvertising */
+		err = theEndPoint->opening_error;
+		if (!err)
+			_finish_open(theEndPoint);
 
+		UNLOCK_ENDPOINT_LIST(shard); //they may well close it, or open another
+		theEndPoint->callback(theEndPoint, theEndPoint->user_context, kNMOpenComplete, err, NULL);
+		LOCK_ENDPOINT_LIST(shard);
+		_leave_endpoint_notifiers(theEndPoint, shard);
 
-/* 
- * Function: NMStopAdvertising
- *--------------------------------------------------------------------
- * Parameters:
- *  [IN] Endpoint = 
- *
- * Returns:
- *   true  = if stop succeeded
- *   false = on any error condition
- *
- * Description:
- *   Function to stop advertising games. 
- *
- *--------------------------------------------------------------------
- */
+		//if an endpoint was added or removed, the rest will have to wait for next time
+		if (listStartState != shard->endpointListState)
+			break;
+	}
 
-NMBoolean NMStopAdvertising(NMEndpointRef Endpoint)
+	if (wakeOpeners)
+	{
+		#ifdef OP_API_NETWORK_SOCKETS
+			pthread_mutex_lock(&shard->openLock);
+			pthread_cond_broadcast(&shard->openProgress);
+			pthread_mutex_unlock(&shard->openLock);
+		#elif defined(OP_API_NETWORK_WINSOCK)
+			SetEvent(shard->openProgress);
+		#endif
+	}
+}
+
+#if (USE_EPOLL)
+
+//adds or modifies an endpoint socket in our event set.
+//we always want to hear about incoming data and errors, but only about output ability if our flow
+//is blocked and we therefore need to see when we can send again (same as the select() version)
+static void _watch_endpoint_socket(NMEndpointRef endpoint, int socketType, int operation)
 {
-	DEBUG_ENTRY_EXIT("NMStopAdvertising");
+	struct epoll_event event;
+	int result;
+	int eventSet = endpoint->shard->eventSet;
 
-	if (module_inited < 1)
-		return(false);  //kNMInternalErr;
+	if ((eventSet == -1) || (endpoint->sockets[socketType] == INVALID_SOCKET))
+		return;
 
-	if (!Endpoint)
-		return(false);
+	machine_mem_zero(&event, sizeof(event));
+	event.events = EPOLLIN | EPOLLPRI | EPOLLET;
+	if (endpoint->flowBlocked[socketType])
+		event.events |= EPOLLOUT;
+	event.data.u64 = EVENT_DATA_FOR_SOCKET(endpoint, socketType);
 
-	Endpoint->advertising = false;
+	result = epoll_ctl(eventSet, operation, endpoint->sockets[socketType], &event);
+	if (result == -1)
+		DEBUG_NETWORK_API("epoll_ctl", result);
+}
 
-	return(true);
+//called once the endpoint's sockets exist - from here on the worker hears about them without us rebuilding anything
+static void _register_endpoint_sockets(NMEndpointRef endpoint)
+{
+	int index;
 
-} /* NMStopAdvertising */
+	for (index = 0; index < NUMBER_OF_SOCKETS; ++index)
+	{
+		if (endpoint->connectionMode & (1 << index))
+			_watch_endpoint_socket(endpoint, index, EPOLL_CTL_ADD);
+	}
+}
 
-int createWakeSocket(void)
+//must be called before the sockets are closed and the endpoint freed
+static void _unregister_endpoint_sockets(NMEndpointRef endpoint)
 {
-	struct sockaddr Server_Address;
-	int result;
-	posix_size_type nameLen = sizeof(Server_Address);
-	
-		
-	wakeSocket = 0;
-	wakeHostSocket = 0;
-	
-	machine_mem_zero((char *) &Server_Address, sizeof(Server_Address));	
-	((sockaddr_in *) &Server_Address)->sin_family = AF_INET;
-	((sockaddr_in *) &Server_Address)->sin_addr.s_addr = INADDR_ANY;
-	((sockaddr_in *) &Server_Address)->sin_port = 0;
-	
-	wakeHostSocket = socket(AF_INET, SOCK_DGRAM, 0);
-	if (!wakeHostSocket)	return false;
-	result = bind(wakeHostSocket, (struct sockaddr *)&Server_Address, sizeof(Server_Address));
-	if (result == -1)	return false;
-	wakeSocket = socket(AF_INET, SOCK_DGRAM, 0);
-	if (!wakeSocket)	return false;
-	result = bind(wakeSocket, (struct sockaddr *)&Server_Address, sizeof(Server_Address));
-	if (result == -1)	return false;
-	
-	result = getsockname(wakeHostSocket, (struct sockaddr *)&Server_Address, &nameLen);
-	if (result == -1)	return false;
-	result = connect(wakeSocket,(sockaddr*)&Server_Address,sizeof(Server_Address));
-	if (result == -1)	return false;
-	
-//	result = send(wakeSocket,buffer,1,0);
-//	if (result == -1)	return false;
-		
-//	long amountIn = recv(wakeHostSocket,buffer,sizeof(buffer),0);
-//	printf("in buffer: %d\n",amountIn);
-	return true;
+	struct epoll_event event;
+	int index;
+	int eventSet = endpoint->shard->eventSet;
+
+	if (eventSet == -1)
+		return;
+
+	//(older kernels insist on a non-NULL event, even for a delete)
+	machine_mem_zero(&event, sizeof(event));
+	for (index = 0; index < NUMBER_OF_SOCKETS; ++index)
+	{
+		if (endpoint->sockets[index] != INVALID_SOCKET)
+			epoll_ctl(eventSet, EPOLL_CTL_DEL, endpoint->sockets[index], &event);
+	}
 }
 
-void disposeWakeSocket(void)
+//since we're edge-triggered, anything we leave sitting in a socket won't be reported again on its own.
+//re-applying the socket's events makes epoll re-check it, giving us a fresh event if its still ready
+static void _rearm_endpoint_socket(NMEndpointRef endpoint, int socketType)
 {
-	if (wakeSocket)
-		close(wakeSocket);
-	if (wakeHostSocket)
-		close(wakeHostSocket);
+	_watch_endpoint_socket(endpoint, socketType, EPOLL_CTL_MOD);
 }
 
+//true if the endpoint is still on the shard's list (ie it hasnt been closed out from under us)
+static NMBoolean _endpoint_is_listed(NMWorkerShard *shard, NMEndpointPriv *endpoint)
+{
+	NMEndpointPriv *theEndPoint;
+
+	for (theEndPoint = shard->endpointList; theEndPoint != NULL; theEndPoint = theEndPoint->next)
+	{
+		if (theEndPoint == endpoint)
+			return true;
+	}
+	return false;
+}
 
-//sends a small datagram to our "wake" socket to try and break out of a select() call
-void sendWakeMessage(void)
+int createEventSet(NMWorkerShard *shard)
 {
-	char buffer[10];
-	//DEBUG_PRINT("sending wake message");
-	int result = send(wakeSocket,buffer,1,0);
-	//DEBUG_PRINT("sendWakeMessage result: %d",result);
+	struct epoll_event event;
+	int result;
+
+	shard->eventSet = epoll_create(MAXIMUM_EVENTS_PER_WAIT);
+	if (shard->eventSet == -1)	return false;
+
+	//the wake socket is level-triggered - we only pull one message off it per pass
+	if (shard->wakeHostSocket)
+	{
+		machine_mem_zero(&event, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.u64 = 0;
+		result = epoll_ctl(shard->eventSet, EPOLL_CTL_ADD, shard->wakeHostSocket, &event);
+		if (result == -1)	return false;
+	}
+	return true;
 }
 
+void disposeEventSet(NMWorkerShard *shard)
+{
+	if (shard->eventSet != -1)
+		close(shard->eventSet);
+	shard->eventSet = -1;
+}
 
-void SetNonBlockingMode(int fd)
+//process any events that have happened with a shard's endpoints
+NMBoolean processEndpoints(NMWorkerShard *shard, NMBoolean block)
 {
+	struct epoll_event events[MAXIMUM_EVENTS_PER_WAIT];
+	int timeout;
+	long numEvents;
+	long index;
+	NMBoolean gotEvent = false;
+	NMEndpointPriv *theEndPoint;
+	NMUInt32 listStartState;
 
-	DEBUG_ENTRY_EXIT("SetNonBlockingMode");
+	// if block is true, we wait one second - otherwise not at all (see the select() version below)
+	// (nor if we've got buffered data to tell someone about)
+	if ((block) && (shard->receivePending == false))
+	{
+		#if (DEBUG)
+			timeout = 10 * 1000;
+		#else
+			timeout = 1000;
+		#endif
+	}
+	else
+		timeout = 0;
 
-#ifdef OP_API_NETWORK_SOCKETS
-	int val = fcntl(fd, F_GETFL,0); //get current file descriptor flags
-	if (val < 0)
+	//opens that have gone quiet still need to be timed out
+	if ((shard->openingCount > 0) && (timeout > OPEN_CHECK_INTERVAL_MSEC))
+		timeout = OPEN_CHECK_INTERVAL_MSEC;
+
+	//and the first worker has to get back to any enumerations it's looking after
+	if ((shard == &workerShards[0]) && (backgroundEnumerationsActive()) && (timeout > ENUMERATION_POLL_INTERVAL_MSEC))
+		timeout = ENUMERATION_POLL_INTERVAL_MSEC;
+
+	if (_lock_endpoint_list_for_processing(shard, block) == false)
+		return false;
+
+	//so we can abort if the list changes while we're using it
+	listStartState = shard->endpointListState;
+
+	//check for events
+	if (shard->eventSet != -1)
+		numEvents = epoll_wait(shard->eventSet, events, MAXIMUM_EVENTS_PER_WAIT, timeout);
+	else
+		numEvents = 0;
+
+	for (index = 0; index < numEvents; index++)
 	{
-		DEBUG_PRINT("error: fcntl() failed to get flags for fd %d: err %d",fd,op_errno);
-		return;
+		uint64_t data = events[index].data.u64;
+		long socketType;
+		long socketEvents = 0;
+
+		gotEvent = true; //something came in
+
+		//our wake socket
+		if (data == 0)
+		{
+			char buffer[64];
+			long amountIn = recv(shard->wakeHostSocket,buffer,sizeof(buffer),0);
+			DEBUG_PRINT("wakeHostSocket amountIn: %d",amountIn);
+			continue;
+		}
+
+		//(read by processBackgroundEnumerations once we're done here)
+		if (data == ENUMERATION_EVENT_DATA)
+			continue;
+
+		theEndPoint = ENDPOINT_FOR_EVENT_DATA(data);
+		socketType = SOCKET_TYPE_FOR_EVENT_DATA(data);
+
+		//if the list has been changed, the rest of these may belong to endpoints that no longer exist.
+		//those that do still exist get another look next time, since we'd otherwise lose their edges
+		if (listStartState != shard->endpointListState)
+		{
+			if (_endpoint_is_listed(shard, theEndPoint))
+				_rearm_endpoint_socket(theEndPoint, socketType);
+			continue;
+		}
+
+		//first off, if the endpoint needs to die, start it dying.
+		_start_endpoint_dying(theEndPoint);
+		if (listStartState != shard->endpointListState)
+		{
+			index--; //give this one the treatment above
+			continue;
+		}
+
+		//errors show up in select() as readable and writable sockets, so we report them the same way
+		if (events[index].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+			socketEvents |= _socket_readable;
+		if (events[index].events & EPOLLPRI)
+			socketEvents |= _socket_exception;
+		if ((events[index].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) && (theEndPoint->flowBlocked[socketType]))
+			socketEvents |= _socket_writable;
+
+		processEndPointSocket(theEndPoint, socketType, socketEvents);
 	}
 
-	val |= O_NONBLOCK; //turn non-blocking on
-	if (fcntl(fd, F_SETFL, val) < 0)
+	if ((shard->openingCount > 0) && (listStartState == shard->endpointListState))
+		_note_open_progress(shard);
+
+	//(not an event of its own - if they've still got the notifier, we've nothing new to say)
+	if ((shard->eventsDeferred) && (listStartState == shard->endpointListState))
+		_deliver_deferred_events(shard);
+
+	if ((shard->receivePending) && (listStartState == shard->endpointListState))
 	{
-		DEBUG_PRINT("error: fcntl() failed to set flags for fd %d: err %d",fd,op_errno);
+		gotEvent = true;
+		_deliver_buffered_data(shard);
 	}
-#elif defined(OP_API_NETWORK_WINSOCK)
-	unsigned long DataVal = 1;
-	long result = ioctlsocket(fd,FIONBIO,&DataVal);
-	op_assert(result == 0);
-#endif
+
+	UNLOCK_ENDPOINT_LIST(shard);
+
+	return gotEvent;
 }
 
+#else
 
-//process any events that have happened with the endpoints
-NMBoolean processEndpoints(NMBoolean block)
+//process any events that have happened with a shard's endpoints
+NMBoolean processEndpoints(NMWorkerShard *shard, NMBoolean block)
 {
 	struct timeval timeout;
 	long nfds = 0;
@@ -1940,7 +4098,8 @@ NMBoolean processEndpoints(NMBoolean block)
 	// or add new endpoints to watch
 	// ECF - changed this to 10 seconds in the debug version so as to identify unnecessary delays
 	// (sufficient machinery is in place now so we never should need to spin waiting for the duration of a select() call)
-	if (block)
+	// we also dont wait if we've got buffered data to tell someone about
+	if ((block) && (shard->receivePending == false))
 	{
 		#if (DEBUG)
 			timeout.tv_sec = 10;
@@ -1954,69 +4113,70 @@ NMBoolean processEndpoints(NMBoolean block)
 		timeout.tv_sec = 0;
 		timeout.tv_usec = 0;
 	}
+
+	//opens that have gone quiet still need to be timed out
+	if ((shard->openingCount > 0) && (timeout.tv_sec > 0))
+	{
+		timeout.tv_sec = 0;
+		timeout.tv_usec = OPEN_CHECK_INTERVAL_MSEC * 1000;
+	}
+
+	//and the first worker has to get back to any enumerations it's looking after
+	if ((shard == &workerShards[0]) && (backgroundEnumerationsActive())
+		&& ((timeout.tv_sec > 0) || (timeout.tv_usec > ENUMERATION_POLL_INTERVAL_MSEC * 1000)))
+	{
+		timeout.tv_sec = 0;
+		timeout.tv_usec = ENUMERATION_POLL_INTERVAL_MSEC * 1000;
+	}
 	
 	//set up the sets
 	FD_ZERO(&input_set);
 	FD_ZERO(&output_set);
 	FD_ZERO(&exc_set);
 
+	if (_lock_endpoint_list_for_processing(shard, block) == false)
+		return false;
+
 	//so we can abort if the list changes while we're using it
-	listStartState = endpointListState;
+	listStartState = shard->endpointListState;
 	
-	//dont hog the proc if we cant get the list right now
-	if (TRY_LOCK_ENDPOINT_WAITING_LIST() == false)
+	//if we have a wake endpoint, add it
+	if (shard->wakeHostSocket)
 	{
-		if (!block)
-			return false;
-		usleep(10000); //sleep for 10 millisecs
-		return false;
+		FD_SET(shard->wakeHostSocket,&input_set);
+		nfds = shard->wakeHostSocket + 1;
 	}
 
-	if (TRY_LOCK_ENDPOINT_LIST() == false)
-	{
-		UNLOCK_ENDPOINT_WAITING_LIST();
-		if (!block)
-			return false;
-		usleep(10000); //sleep for 10 millisecs
-		return false;
-	}
-	else
-		UNLOCK_ENDPOINT_WAITING_LIST();
-	
-	//if we have a wake endpoint, add it
-	if (wakeHostSocket)
-		FD_SET(wakeHostSocket,&input_set);
+	//the first worker also wakes for replies to its background enumerations (it reads them itself, afterwards)
+	if (shard == &workerShards[0])
+		nfds = watchBackgroundEnumerations(&input_set, nfds);
 	
 	//add all endpoints to our lists to check
-	theEndPoint = endpointList;
+	theEndPoint = shard->endpointList;
 			
 	while (theEndPoint != NULL)
 	{
 		//first off, if the endpoint needs to die, start it dying.  
-		if ((theEndPoint->needToDie == true) && (theEndPoint->dying == false))
-		{
-			theEndPoint->dying = true;
-
-			//only inform them of its demise if its been fully formed
-			if (theEndPoint->alive == true)
-			{
-				UNLOCK_ENDPOINT_LIST(); //they'll probably kill the endpoint (and thus modify the list) as a result
-				//tell the player the endpoint died and make sure we don't do anything else with it
-				theEndPoint->callback(theEndPoint,theEndPoint->user_context,kNMEndpointDied,0,NULL);
-				LOCK_ENDPOINT_LIST();
-			}
-		}
+		_start_endpoint_dying(theEndPoint);
 		
 		//if the list has changed, we need to abort and do it next time
-		if (listStartState != endpointListState)
+		if (listStartState != shard->endpointListState)
 		{
-			UNLOCK_ENDPOINT_LIST();
+			UNLOCK_ENDPOINT_LIST(shard);
 			return true;
 		}
 		
+		//an endpoint whose host name is still being looked up has no sockets yet
+		if (theEndPoint->resolveName)
+		{
+			theEndPoint = theEndPoint->next;
+			continue;
+		}
+
 		//we always check for waiting input and errors
 		//we only look for output ability if our flow is blocked and we therefore need to see when we can send again
-		if (theEndPoint->connectionMode & (1 << _datagram_socket)){
+		//(and we don't look at all at a socket whose news is already waiting on the notifier)
+		if ((theEndPoint->connectionMode & (1 << _datagram_socket)) && (theEndPoint->deferredEvents[_datagram_socket] == 0)){
 			FD_SET(theEndPoint->sockets[_datagram_socket],&input_set);
 			if (theEndPoint->flowBlocked[_datagram_socket])
 				FD_SET(theEndPoint->sockets[_datagram_socket],&output_set);
@@ -2024,7 +4184,7 @@ NMBoolean processEndpoints(NMBoolean block)
 			if (theEndPoint->sockets[_datagram_socket] + 1 > nfds)
     			nfds = theEndPoint->sockets[_datagram_socket] + 1;			
 		}
-		if (theEndPoint->connectionMode & (1 << _stream_socket)){
+		if ((theEndPoint->connectionMode & (1 << _stream_socket)) && (theEndPoint->deferredEvents[_stream_socket] == 0)){
 			FD_SET(theEndPoint->sockets[_stream_socket],&input_set);
 			//only look for output if our flow is blocked
 			if (theEndPoint->flowBlocked[_stream_socket])
@@ -2037,7 +4197,8 @@ NMBoolean processEndpoints(NMBoolean block)
 	}
 	
 	//check for events
-	if (endpointList)
+	//even with no endpoints we wait on the wake socket, so we hear right away when one is added
+	if ((shard->endpointList) || (shard->wakeHostSocket))
 		numEvents = select(nfds,&input_set,&output_set,&exc_set,&timeout);
 	else
 		numEvents = 0; //save ourselves some time with good ol' common sense!
@@ -2046,60 +4207,86 @@ NMBoolean processEndpoints(NMBoolean block)
 	if (numEvents > 0)
     {
     	gotEvent = true; //something came in
-		theEndPoint = endpointList;
+		theEndPoint = shard->endpointList;
 		
 		//first check our wake socket
-		if (wakeHostSocket){
+		if (shard->wakeHostSocket){
 			char buffer[64];
-			if (FD_ISSET(wakeHostSocket,&input_set)){
-				long amountIn = recv(wakeHostSocket,buffer,sizeof(buffer),0);
+			if (FD_ISSET(shard->wakeHostSocket,&input_set)){
+				long amountIn = recv(shard->wakeHostSocket,buffer,sizeof(buffer),0);
 				DEBUG_PRINT("wakeHostSocket amountIn: %d",amountIn);
 			}
 		}
 		while (theEndPoint)
 		{
-			//this endpoint has a datagram socket
-			if (theEndPoint->connectionMode & (1 << _datagram_socket))
-				processEndPointSocket(theEndPoint,_datagram_socket,&input_set,&output_set,&exc_set);			
+			long socketType;
 
-			//abort if the list has been changed since theEndPoint may no longer exist for all we know...
-			if (endpointListState != listStartState)
+			for (socketType = 0; socketType < NUMBER_OF_SOCKETS; socketType++)
 			{
-				break;
+				long socketEvents = 0;
+
+				//this endpoint doesnt have this type of socket (or any, yet)
+				if (((theEndPoint->connectionMode & (1 << socketType)) == 0) || (theEndPoint->sockets[socketType] == INVALID_SOCKET))
+					continue;
+
+				if (FD_ISSET(theEndPoint->sockets[socketType],&input_set))
+					socketEvents |= _socket_readable;
+				if (FD_ISSET(theEndPoint->sockets[socketType],&output_set))
+					socketEvents |= _socket_writable;
+				if (FD_ISSET(theEndPoint->sockets[socketType],&exc_set))
+					socketEvents |= _socket_exception;
+
+				processEndPointSocket(theEndPoint,socketType,socketEvents);
+
+				//abort if the list has been changed since theEndPoint may no longer exist for all we know...
+				if (shard->endpointListState != listStartState)
+					break;
 			}
-				
-			//if it has a stream socket
-			if (theEndPoint->connectionMode & (1 << _stream_socket))
-				processEndPointSocket(theEndPoint,_stream_socket,&input_set,&output_set,&exc_set);
 			
 			//abort if the list has been changed since theEndPoint may no longer exist for all we know...
-			if (endpointListState != listStartState)
+			if (shard->endpointListState != listStartState)
 				break;
 
 			theEndPoint = theEndPoint->next;
 		}
 	}
-	
-	UNLOCK_ENDPOINT_LIST();
-	
-	//if we arent getting events, we dont wanna sit in a spin-lock, hogging the endpoint list
-	if (gotEvent == false)
+
+	if ((shard->openingCount > 0) && (listStartState == shard->endpointListState))
+		_note_open_progress(shard);
+
+	//(not an event of its own - if they've still got the notifier, we've nothing new to say)
+	if ((shard->eventsDeferred) && (listStartState == shard->endpointListState))
+		_deliver_deferred_events(shard);
+
+	if ((shard->receivePending) && (listStartState == shard->endpointListState))
 	{
-		usleep(10000); //sleep for 10 millisecs
+		gotEvent = true;
+		_deliver_buffered_data(shard);
 	}
+	
+	UNLOCK_ENDPOINT_LIST(shard);
+	
 	return gotEvent;
 }
 
+#endif //USE_EPOLL
+
 //this function is always called with access to a locked endpoint-list, remember. And it should always return a locked list.
-void processEndPointSocket(NMEndpointPriv *theEndPoint, long socketType, fd_set *input_set, fd_set *output_set, fd_set *exc_set)
+void processEndPointSocket(NMEndpointPriv *theEndPoint, long socketType, long socketEvents)
 {
-	//cant do nothing if they've called ProtocolEnterNotifier
-	if (TRY_ENTER_NOTIFIER() == false)
+	NMWorkerShard *shard = theEndPoint->shard;
+	NMNotifierLock *notifier = NOTIFIER_LOCK(theEndPoint, socketType);
+
+	//cant do nothing if they've called ProtocolEnterNotifier on this endpoint (for this type of socket)
+	if (TRY_ENTER_NOTIFIER(notifier) == false)
+	{
+		_defer_endpoint_events(theEndPoint, socketType, socketEvents);
 		return;
+	}
 
-	if (FD_ISSET(theEndPoint->sockets[socketType],exc_set)) // There was an Error?
+	if (socketEvents & _socket_exception) // There was an Error?
 	{
-		NMUInt32 listStartState = endpointListState;
+		NMUInt32 listStartState = shard->endpointListState;
 		//if we're already dying, theres nothing to be done...
 		if (theEndPoint->dying == false)
 		{
@@ -2111,13 +4298,13 @@ void processEndPointSocket(NMEndpointPriv *theEndPoint, long socketType, fd_set
 				//tell the player the endpoint died and make sure we don't do anything else with it
 				theEndPoint->needToDie = true;
 				theEndPoint->dying = true;
-				UNLOCK_ENDPOINT_LIST();
+				UNLOCK_ENDPOINT_LIST(shard);
 				theEndPoint->callback(theEndPoint,theEndPoint->user_context,kNMEndpointDied,0,NULL);
-				LOCK_ENDPOINT_LIST();
+				LOCK_ENDPOINT_LIST(shard);
 				
 				//if an endpoint was added or removed, we can't go on (it might have been us)
-				if (listStartState != endpointListState){
-					LEAVE_NOTIFIER();
+				if (listStartState != shard->endpointListState){
+					_leave_socket_notifier(shard, notifier);
 					return;
 				}
 			}
@@ -2125,15 +4312,15 @@ void processEndPointSocket(NMEndpointPriv *theEndPoint, long socketType, fd_set
 			{
 				theEndPoint->opening_error = kNMOpenFailedErr;
 				theEndPoint->needToDie = true;
-				LEAVE_NOTIFIER();
+				_leave_socket_notifier(shard, notifier);
 				return;
 			}
 		}
 	}
 
-	if ((FD_ISSET(theEndPoint->sockets[socketType],input_set))) // Data has arrived
+	if (socketEvents & _socket_readable) // Data has arrived
 	{
-		NMUInt32 listStartState = endpointListState;
+		NMUInt32 listStartState = shard->endpointListState;
 			
 		//if the endpoint is dying, we don't care....
 		//(we might, though, in the future, if we're doing "graceful" disconnects or something)
@@ -2149,12 +4336,12 @@ void processEndPointSocket(NMEndpointPriv *theEndPoint, long socketType, fd_set
 				if (theEndPoint->alive == true)
 				{
 					DEBUG_PRINT("sending user a connect request");
-					UNLOCK_ENDPOINT_LIST();
+					UNLOCK_ENDPOINT_LIST(shard);
 					theEndPoint->callback(theEndPoint,theEndPoint->user_context,kNMConnectRequest,0,NULL);
-					LOCK_ENDPOINT_LIST();
+					LOCK_ENDPOINT_LIST(shard);
 					//if an endpoint was added or removed, we can't go on (it might have been us)
-					if (listStartState != endpointListState){
-						LEAVE_NOTIFIER();
+					if (listStartState != shard->endpointListState){
+						_leave_socket_notifier(shard, notifier);
 						return;
 					}
 				}
@@ -2167,7 +4354,14 @@ void processEndPointSocket(NMEndpointPriv *theEndPoint, long socketType, fd_set
 				if (theEndPoint->alive)
 				{
 					//do a test-read without actually pulling data out
-					long readResult = socketReadResult(theEndPoint,socketType);
+					//(if we've still got some buffered, the socket's news can wait until they've read it)
+					long readResult;
+					if ((socketType == _stream_socket) && (theEndPoint->receiveCount > 0))
+						readResult = theEndPoint->receiveCount;
+					else if ((socketType == _datagram_socket) && (_buffered_datagram_count(theEndPoint) > 0))
+						readResult = _buffered_datagram_count(theEndPoint);
+					else
+						readResult = socketReadResult(theEndPoint,socketType);
 					
 					//first off we check the data to see if its of zero length - this implies
 					//that the endpoint has died, in which case we deliver that news instead of the new-data
@@ -2178,12 +4372,12 @@ void processEndPointSocket(NMEndpointPriv *theEndPoint, long socketType, fd_set
 							//tell the player the endpoint died and make sure we don't do anything else with it
 							theEndPoint->needToDie = true;
 							theEndPoint->dying = true;
-							UNLOCK_ENDPOINT_LIST();
+							UNLOCK_ENDPOINT_LIST(shard);
 							DEBUG_PRINT("sending kNMEndpointDied for ep 0x%x",theEndPoint);
 							theEndPoint->callback(theEndPoint,theEndPoint->user_context,kNMEndpointDied,0,NULL);
-							LOCK_ENDPOINT_LIST();
+							LOCK_ENDPOINT_LIST(shard);
 							
-							LEAVE_NOTIFIER();
+							_leave_socket_notifier(shard, notifier);
 							return;
 						}					
 					}
@@ -2206,16 +4400,17 @@ void processEndPointSocket(NMEndpointPriv *theEndPoint, long socketType, fd_set
 						}
 							
 						//hand it off to the user to read or whatever
-						UNLOCK_ENDPOINT_LIST();
+						UNLOCK_ENDPOINT_LIST(shard);
 						theEndPoint->callback(theEndPoint,theEndPoint->user_context,code,0,NULL);
-						LOCK_ENDPOINT_LIST();
+						LOCK_ENDPOINT_LIST(shard);
 						
 						//if an endpoint was added or removed, we can't go on (it might have been us)
-						if (listStartState != endpointListState){
-							LEAVE_NOTIFIER();
+						if (listStartState != shard->endpointListState){
+							_leave_socket_notifier(shard, notifier);
 							return;
 						}
 					}
+					_note_buffered_data(theEndPoint);
 				}
 				//if we're not yet alive, we at least see if the endpoint has died so we can fail in opening
 				//otherwise we'd wind up spinning until the open timed out
@@ -2226,26 +4421,55 @@ void processEndPointSocket(NMEndpointPriv *theEndPoint, long socketType, fd_set
 					{
 						theEndPoint->opening_error = kNMAcceptFailedErr;
 						theEndPoint->needToDie = true;
-						LEAVE_NOTIFIER();
+						_leave_socket_notifier(shard, notifier);
 						return;
 					}
 				}
 			}
+			//we only consumed the internal data - anything behind it needs another look
+			else if (theEndPoint->needToDie == false)
+			{
+				#if (USE_EPOLL)
+					_rearm_endpoint_socket(theEndPoint, socketType);
+				#endif
+				_note_buffered_data(theEndPoint);
+			}
 		}
 	}
 	
-	if (FD_ISSET(theEndPoint->sockets[socketType],output_set)) // Socket is ready to write
+	if (socketEvents & _socket_writable) // Socket is ready to write
 	{
-		NMUInt32 listStartState = endpointListState;
+		NMUInt32 listStartState = shard->endpointListState;
+		NMNotifierLock *parentNotifier = NULL;
 	
 		//if its dying, we dont care
 		if (theEndPoint->dying == false)
 		{
+			//a new remote-client connection coming online sends its parent a handoff-complete, so we need the
+			//parent's notifier as well (unless it happens to share ours). we only try for it, so two workers
+			//handing off to each other's listeners can't deadlock - if its busy, we come back to this socket later
+			if ((socketType == _stream_socket) && (theEndPoint->active == false) && (theEndPoint->listener == false)
+				&& ((theEndPoint->valid_endpoints & (1 << socketType)) == 0)
+				&& (NOTIFIER_LOCK(theEndPoint->parent, _stream_socket) != notifier))
+			{
+				if (TRY_ENTER_NOTIFIER(NOTIFIER_LOCK(theEndPoint->parent, _stream_socket)) == false)
+				{
+					_defer_endpoint_events(theEndPoint, socketType, socketEvents);
+					_leave_socket_notifier(shard, notifier);
+					return;
+				}
+				parentNotifier = NOTIFIER_LOCK(theEndPoint->parent, _stream_socket);
+			}
+
 			//if this socket hasnt been declared valid yet, we do so
 			//if it already was, there must have been a flow control problem and we need to send
 			//out a flow clear message (unless its a listener, which doesnt send)
 			theEndPoint->flowBlocked[socketType] = false;
-			UNLOCK_ENDPOINT_LIST();
+			#if (USE_EPOLL)
+				//stop watching for output, and have another look for input now that we may be alive
+				_rearm_endpoint_socket(theEndPoint, socketType);
+			#endif
+			UNLOCK_ENDPOINT_LIST(shard);
 			if (theEndPoint->valid_endpoints & (1 << socketType)) //this endpoint's been marked valid already - this must be flow clear
 			{
 				DEBUG_PRINT("sending 0x%x a flowclear for socketType %d.",theEndPoint,socketType);
@@ -2296,12 +4520,12 @@ void processEndPointSocket(NMEndpointPriv *theEndPoint, long socketType, fd_set
 					if (theEndPoint->netSprocketMode)
 					{
 						NMErr result;
-						sockaddr_in address;
+						struct sockaddr_storage address;
 						posix_size_type	address_size= sizeof (address);
 					
 						getpeername(theEndPoint->sockets[_stream_socket], (sockaddr*) &address, &address_size);
-						DEBUG_PRINT("connecting datagram socket to port %d",ntohs(address.sin_port));						
-						result = connect(theEndPoint->sockets[_datagram_socket],(sockaddr*)&address,sizeof(address));
+						DEBUG_PRINT("connecting datagram socket to port %d",ntohs(sockaddr_port(&address)));						
+						result = connect(theEndPoint->sockets[_datagram_socket],(sockaddr*)&address,sockaddr_length(&address));
 						DEBUG_NETWORK_API("connect",result);
 					}
 					//send a handoff-complete to its parent and an accept-complete to it
@@ -2326,16 +4550,18 @@ void processEndPointSocket(NMEndpointPriv *theEndPoint, long socketType, fd_set
 						DEBUG_PRINT("stream socket completion failed for 0x%x",theEndPoint);				
 				}
 			}
-			LOCK_ENDPOINT_LIST();
+			if (parentNotifier)
+				LEAVE_NOTIFIER(parentNotifier);
+			LOCK_ENDPOINT_LIST(shard);
 
 			//if an endpoint was added or removed, we can't go on (it might have been us)
-			if (listStartState != endpointListState){
-				LEAVE_NOTIFIER();
+			if (listStartState != shard->endpointListState){
+				_leave_socket_notifier(shard, notifier);
 				return;
 			}
 		}
 	}
-	LEAVE_NOTIFIER();
+	_leave_socket_notifier(shard, notifier);
 	return;
 }
 
@@ -2350,28 +4576,16 @@ NMErr NMGetAddress(NMEndpointRef inEndpoint, NMAddressType addressType, void **o
 		case kNMIPAddressType:	// IP address (string of format "127.0.0.1:80")
 		
 		    // First, get the socket address for the remote connection...
-		    // (Note, I tried using inEndpoint->remoteAddress.sin_addr, but the value
-		    // was nil.  Isn't that structure element supposed to contain the remote
-		    // machine's address?  Does this mean that datagrams will be screwed?
-		    // I'll have to look into this when I have more time, but for now, I don't
-		    // need datagrams, and I can get the remote address directly using "getpeername()"...)
-		    
+		    // (remoteAddress is only filled in for active endpoints, so we ask the socket)
 		    posix_size_type size;
-		    unsigned char *byte;
-		    sockaddr_in	socket_address;
+		    struct sockaddr_storage socket_address;
 
-		    size  = sizeof(sockaddr_in);
+		    size  = sizeof(socket_address);
 		    status = getpeername(inEndpoint->sockets[_stream_socket], (sockaddr *) &socket_address, &size);
 		
-		    // Now, convert the UInt32 value in socket_address.sin_addr into a dotted decimal
-		    // format string...
-		    byte = (unsigned char *) &socket_address.sin_addr;
-		    *outAddress = (void *) new char[16];
-		    #if big_endian
-		    sprintf((char *) *outAddress, "%u.%u.%u.%u",byte[0],byte[1],byte[2],byte[3]);
-		    #else
-		    sprintf((char *) *outAddress, "%u.%u.%u.%u",byte[3],byte[2],byte[1],byte[0]);		    
-		    #endif
+		    // Now make it a string - dotted decimal for IPv4, and the usual colons for IPv6
+		    *outAddress = (void *) new char[kMaxAddressStringLength];
+		    sockaddr_to_string(&socket_address, (char *) *outAddress, kMaxAddressStringLength);
 		break;
 
 		default:	// This module returns no other type of address.
@@ -2404,83 +4618,101 @@ NMErr NMFreeAddress(NMEndpointRef inEndpoint, void **outAddress)
 #ifdef USE_WORKER_THREAD
 void createWorkerThread(void)
 {
-	dieWorkerThread = false;
-	
-	//if we've already got a worker thread...
-	if (workerThreadAlive)
-		return;
+	long index;
+
+	for (index = 0; index < workerShardCount; index++)
+	{
+		NMWorkerShard *shard = &workerShards[index];
+
+		shard->dieWorkerThread = false;
 		
-	#ifdef OP_API_NETWORK_SOCKETS
-		long pThreadResult = pthread_create(&worker_thread,NULL,worker_thread_func,NULL);
-		op_assert(pThreadResult == 0);
-	#elif defined(OP_API_NETWORK_WINSOCK)
-		worker_thread_handle = CreateThread((_SECURITY_ATTRIBUTES*)NULL,
-								0,
-								worker_thread_func,
-								0, //context
-								0,
-								&worker_thread);
-		op_assert(worker_thread_handle != NULL);
-	#endif
-	
-	workerThreadAlive = true;
+		//if we've already got a worker thread...
+		if (shard->workerThreadAlive)
+			continue;
+			
+		#ifdef OP_API_NETWORK_SOCKETS
+			long pThreadResult = pthread_create(&shard->worker_thread,NULL,worker_thread_func,shard);
+			op_assert(pThreadResult == 0);
+		#elif defined(OP_API_NETWORK_WINSOCK)
+			shard->worker_thread_handle = CreateThread((_SECURITY_ATTRIBUTES*)NULL,
+									0,
+									worker_thread_func,
+									shard, //context
+									0,
+									&shard->worker_thread);
+			op_assert(shard->worker_thread_handle != NULL);
+		#endif
+		
+		shard->workerThreadAlive = true;
+	}
 }
 
 void killWorkerThread(void)
 {
-	if (workerThreadAlive == false)
-		return;
-	
-	DEBUG_PRINT("terminating worker-thread...");	
-	
-	// on windows, we simply annihilate the thread in its tracks,
-	// as it seems unable to execute, and thus shut itself down, during DllMain().
-	// this is a rather unelegant way to do it...
-	#ifdef OP_API_NETWORK_WINSOCK
-		BOOL result = 	TerminateThread(worker_thread_handle,0);
-		op_assert(result != 0);
-		dieWorkerThread = true;
-		workerThreadAlive = false;
-		return;
-	#endif
-			
-	dieWorkerThread = true;
-	
-	//snap the worker thread out of its select() call
-	sendWakeMessage();
-	
-	//wait while it dies
-	while (workerThreadAlive == true)
+	long index;
+
+	for (index = 0; index < workerShardCount; index++)
 	{
-		usleep(10000); //sleep for 10 millisecs
+		NMWorkerShard *shard = &workerShards[index];
+
+		if (shard->workerThreadAlive == false)
+			continue;
+		
+		DEBUG_PRINT("terminating worker-thread %d...",index);	
+		
+		// on windows, we simply annihilate the thread in its tracks,
+		// as it seems unable to execute, and thus shut itself down, during DllMain().
+		// this is a rather unelegant way to do it...
+		#ifdef OP_API_NETWORK_WINSOCK
+			BOOL result = 	TerminateThread(shard->worker_thread_handle,0);
+			op_assert(result != 0);
+			shard->dieWorkerThread = true;
+			shard->workerThreadAlive = false;
+			continue;
+		#endif
+				
+		shard->dieWorkerThread = true;
+		
+		//snap the worker thread out of its select() call
+		sendWakeMessage(shard);
+		
+		//wait while it dies
+		#ifdef OP_API_NETWORK_SOCKETS
+			pthread_join(shard->worker_thread, NULL);
+		#endif
+		shard->workerThreadAlive = false;
+		DEBUG_PRINT("...worker thread terminated.");			
 	}
-	DEBUG_PRINT("...worker thread terminated.");			
 }
 
-// the main function for our worker thread, which just sits and waits for socket events to happen
+// the main function for our worker threads, each of which just sits and waits for socket events to happen on its shard
 #ifdef OP_API_NETWORK_SOCKETS
 	void* worker_thread_func(void *arg)
 #elif defined(OP_API_NETWORK_WINSOCK)
 	DWORD WINAPI worker_thread_func(LPVOID arg)
 #endif
 {
-	UNUSED_PARAMETER(arg);
-
+	NMWorkerShard *shard = (NMWorkerShard *) arg;
 	NMBoolean done = false;
 
 	DEBUG_PRINT("worker_thread is now running");
-	workerThreadAlive = true;
+	shard->workerThreadAlive = true;
 	
 	//sit in a loop blocking until new stuff happens
 	while (!done)
 	{
-		processEndpoints(true);
-		if (dieWorkerThread)
+		processEndpoints(shard, true);
+
+		//(outside the endpoint list lock, since the callbacks may well open endpoints)
+		if (shard == &workerShards[0])
+			processBackgroundEnumerations();
+
+		if (shard->dieWorkerThread)
 			done = true;
 	}
 	
 	DEBUG_PRINT("worker-thread shutting down");	
-	workerThreadAlive = false;
+	shard->workerThreadAlive = false;
     pthread_exit(0);
 	return NULL;
 }
@@ -2512,22 +4744,22 @@ receive_udp_port(NMEndpointRef endpoint)
 	if (!err && size==sizeof (port_data))
 	{
 		NMSInt16 	old_port;
-		sockaddr_in address;
+		struct sockaddr_storage address;
 		posix_size_type	address_size= sizeof (address);
 
 		op_assert(size==sizeof (port_data)); // or else
 		
 		// And change our local port to match theirs..
 		getpeername(endpoint->sockets[_datagram_socket], (sockaddr*) &address, &address_size);
-		old_port= address.sin_port;
-		address.sin_port= port_data.port; // already in network order
+		old_port= sockaddr_port(&address);
+		set_sockaddr_port(&address, port_data.port); // already in network order
 		{
-			long port = ntohs(address.sin_port);
+			long port = ntohs(port_data.port);
 			DEBUG_PRINT("received remote udp port: %d",port);
 		}
 		
 		// make the connect call.. (sets the udp destination)
-		err= connect(endpoint->sockets[_datagram_socket], (sockaddr*) &address, sizeof (address));
+		err= connect(endpoint->sockets[_datagram_socket], (sockaddr*) &address, sockaddr_length(&address));
 		if (!err)
 		{
 			// and mark the connection as having been completed...
@@ -163,11 +163,30 @@ static void _build_config_string_into_config_buffer(NMConfigRef config)
 
     if (status)
     {
-      long port = ntohs(config->hostAddr.sin_port);
+      long port = ntohs(sockaddr_port(&config->hostAddr));
 		
       /* insert PORT, in host byte order */
       status = put_token(config->buffer, MAXIMUM_CONFIG_LENGTH, kIPConfigPort, LONG_DATA, &port, sizeof(long));
 
+      /* insert socket options, but only those that differ from the defaults */
+      if (status && !config->socketOptions.noDelay)
+        status = put_token(config->buffer, MAXIMUM_CONFIG_LENGTH, kIPConfigNoDelay, BOOLEAN_DATA, &config->socketOptions.noDelay, sizeof(NMBoolean));
+
+      if (status && config->socketOptions.cork)
+        status = put_token(config->buffer, MAXIMUM_CONFIG_LENGTH, kIPConfigCork, BOOLEAN_DATA, &config->socketOptions.cork, sizeof(NMBoolean));
+
+      if (status && config->socketOptions.sendBufferSize)
+        status = put_token(config->buffer, MAXIMUM_CONFIG_LENGTH, kIPConfigSendBuffer, LONG_DATA, &config->socketOptions.sendBufferSize, sizeof(long));
+
+      if (status && config->socketOptions.receiveBufferSize)
+        status = put_token(config->buffer, MAXIMUM_CONFIG_LENGTH, kIPConfigReceiveBuffer, LONG_DATA, &config->socketOptions.receiveBufferSize, sizeof(long));
+
+      if (status && config->asyncOpen)
+        status = put_token(config->buffer, MAXIMUM_CONFIG_LENGTH, kIPConfigAsyncOpen, BOOLEAN_DATA, &config->asyncOpen, sizeof(NMBoolean));
+
+      if (status && config->backgroundEnumeration)
+        status = put_token(config->buffer, MAXIMUM_CONFIG_LENGTH, kIPConfigBackgroundEnumeration, BOOLEAN_DATA, &config->backgroundEnumeration, sizeof(NMBoolean));
+
       if(status)
         success = true;
     }
@@ -306,6 +325,28 @@ static NMErr _parse_config_string(char *string, NMUInt32 GameID, NMConfigRef con
 	if (!get_token(string, kConfigNetSprocketMode, BOOLEAN_DATA, &config->netSprocketMode, &length))
 		config->netSprocketMode = kDefaultNetSprocketMode;
 
+	// Socket options are all optional; anything not given keeps its default.
+	length = sizeof(NMBoolean);
+	get_token(string, kIPConfigNoDelay, BOOLEAN_DATA, &config->socketOptions.noDelay, &length);
+
+	length = sizeof(NMBoolean);
+	get_token(string, kIPConfigCork, BOOLEAN_DATA, &config->socketOptions.cork, &length);
+
+	length = sizeof(long);
+	get_token(string, kIPConfigSendBuffer, LONG_DATA, &config->socketOptions.sendBufferSize, &length);
+
+	length = sizeof(long);
+	get_token(string, kIPConfigReceiveBuffer, LONG_DATA, &config->socketOptions.receiveBufferSize, &length);
+
+	length = sizeof(NMBoolean);
+	get_token(string, kIPConfigAsyncOpen, BOOLEAN_DATA, &config->asyncOpen, &length);
+
+	length = sizeof(NMBoolean);
+	get_token(string, kIPConfigBackgroundEnumeration, BOOLEAN_DATA, &config->backgroundEnumeration, &length);
+
+	if ((config->socketOptions.sendBufferSize < 0) || (config->socketOptions.receiveBufferSize < 0))
+		return kNMInvalidConfigErr;
+
 		
     length = sizeof(config->host_name);
     status = get_token(string, kIPConfigAddress, STRING_DATA, &config->host_name, &length);
@@ -321,7 +362,7 @@ static NMErr _parse_config_string(char *string, NMUInt32 GameID, NMConfigRef con
       {
         if (port >= 0 && port <= 65535)
 	{
-          config->hostAddr.sin_port = htons(port);
+          set_sockaddr_port(&config->hostAddr, htons(port));
           err = 0;
 	}
       }
@@ -413,18 +454,31 @@ NMErr NMCreateConfig(char *ConfigStr,
 		_config->version = kVersion;
 		_config->gameID  = GameID;
 
-		_config->hostAddr.sin_family = AF_INET;
-		_config->hostAddr.sin_port = htons( _get_default_port(GameID) );
-		_config->hostAddr.sin_addr.s_addr = INADDR_NONE;
+		//(the address itself is looked up from host_name when we open)
+		machine_mem_zero(&_config->hostAddr, sizeof(_config->hostAddr));
+		_config->hostAddr.ss_family = AF_INET;
+		set_sockaddr_port(&_config->hostAddr, htons( _get_default_port(GameID) ));
 
 		_config->enumeration_socket = INVALID_SOCKET;
 		_config->enumerating = false;
 		_config->connectionMode = kNMNormalMode; /* stream and datagram. */
 		_config->netSprocketMode = kDefaultNetSprocketMode;
+		_config->asyncOpen = false;
+		_config->socketOptions.noDelay = true;
+		_config->socketOptions.cork = false;
+		_config->socketOptions.sendBufferSize = 0;
+		_config->socketOptions.receiveBufferSize = 0;
 		_config->callback = NULL;
-		_config->games = NULL;
+		_config->game_table = NULL;
+		_config->game_table_size = 0;
 		_config->game_count = 0;
-		_config->new_game_count = 0;
+		machine_mem_zero(_config->game_wheel, sizeof(_config->game_wheel));
+		_config->game_wheel_ticks = 0;
+		_config->new_games = NULL;
+		_config->new_games_tail = NULL;
+		_config->backgroundEnumeration = false;
+		_config->announcing = false;
+		_config->enumeration_next = NULL;
 	}
 	else
 	{
@@ -562,6 +616,10 @@ NMErr NMDeleteConfig(NMConfigRef inConfig)
 	op_vassert_return((inConfig != NULL),"Config ref is NULL!",kNMParameterErr);
 	op_vassert_return((inConfig->cookie==config_cookie),"inConfig->cookie==config_cookie",kNMParameterErr);
 
+	//the worker may be looking after its enumeration, so it has to hear it's over
+	if (inConfig->enumerating)
+		NMEndEnumeration(inConfig);
+
 	inConfig->cookie= 'bad ';
 	dispose_pointer(inConfig);
 	
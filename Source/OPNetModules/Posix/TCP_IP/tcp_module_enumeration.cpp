@@ -40,6 +40,572 @@
 #include "tcp_module.h"
 
 
+//configs enumerating in the background, which the first worker looks after (see processBackgroundEnumerations).
+//it holds the lock while it does, callbacks and all - so a callback that starts or ends one mustn't take it again
+static machine_lock *backgroundEnumerationLock = NULL;
+static NMBoolean backgroundEnumerationLockHeld = false;
+static NMConfigRef backgroundEnumerations = NULL;
+static NMUInt32 backgroundEnumerationListState = 0;
+
+static NMErr _handle_packets(NMConfigRef Config);
+static void _send_game_request_packet(NMConfigRef Config);
+
+
+/* 
+ * Static Function: _game_bucket
+ *--------------------------------------------------------------------
+ * Parameters:
+ *   [IN] Config 
+ *   [IN] host
+ *
+ * Returns:
+ *   the game table bucket for the host
+ *
+ * Description:
+ *   Games are hashed by host alone (not port) so NMBindEnumerationItemToConfig,
+ *   which only has the host, can find them.  The table must exist.
+ *
+ *--------------------------------------------------------------------
+ */
+
+static struct available_game_data **_game_bucket(NMConfigRef Config, long host)
+{
+	NMUInt32 hash = (NMUInt32) host;
+
+	hash ^= hash >> 16;
+	hash *= 0x45d9f3b;
+	hash ^= hash >> 16;
+
+	return &Config->game_table[hash & (Config->game_table_size - 1)];
+} /* _game_bucket */
+
+
+/* 
+ * Static Function: _find_game
+ *--------------------------------------------------------------------
+ * Parameters:
+ *   [IN] Config 
+ *   [IN] host
+ *   [IN] port
+ *
+ * Returns:
+ *   the game, or NULL if we don't know it
+ *
+ * Description:
+ *   Function 
+ *
+ *--------------------------------------------------------------------
+ */
+
+static struct available_game_data *_find_game(NMConfigRef Config, long host, word port)
+{
+	struct available_game_data *game;
+
+	if (!Config->game_table)
+		return NULL;
+
+	for (game = *_game_bucket(Config, host); game; game = game->hash_next)
+	{
+		if ((game->host == host) && (game->port == port))
+			break;
+	}
+	return game;
+} /* _find_game */
+
+
+/* 
+ * Static Function: _grow_game_table
+ *--------------------------------------------------------------------
+ * Parameters:
+ *   [IN] Config 
+ *
+ * Returns:
+ *  
+ *
+ * Description:
+ *   Makes the game table (or doubles it) and rehashes what was in it.
+ *   If there's no memory for a bigger one, the old one just gets fuller.
+ *
+ *--------------------------------------------------------------------
+ */
+
+static void _grow_game_table(NMConfigRef Config)
+{
+	struct available_game_data **old_table = Config->game_table;
+	long old_size = Config->game_table_size;
+	long new_size = old_size ? (old_size * 2) : INITIAL_GAME_TABLE_SIZE;
+	struct available_game_data **new_table;
+	struct available_game_data *game;
+	long index;
+
+	new_table = (struct available_game_data **) calloc(new_size, sizeof(struct available_game_data *));
+	if (!new_table)
+		return;
+
+	Config->game_table = new_table;
+	Config->game_table_size = new_size;
+
+	for (index = 0; index < old_size; index++)
+	{
+		while ((game = old_table[index]) != NULL)
+		{
+			struct available_game_data **bucket = _game_bucket(Config, game->host);
+
+			old_table[index] = game->hash_next;
+			game->hash_next = *bucket;
+			*bucket = game;
+		}
+	}
+
+	if (old_table)
+		free(old_table);
+} /* _grow_game_table */
+
+
+/* 
+ * Static Function: _schedule_game_drop
+ *--------------------------------------------------------------------
+ * Parameters:
+ *   [IN] Config 
+ *   [IN] game
+ *
+ * Returns:
+ *  
+ *
+ * Description:
+ *   (Re)files the game in the timer wheel slot it'll be due to be dropped
+ *   in, going by when we last heard from it.
+ *
+ *--------------------------------------------------------------------
+ */
+
+static void _schedule_game_drop(NMConfigRef Config, struct available_game_data *game)
+{
+	short slot = (short) (((NMUInt32) (game->ticks_at_last_response + TICKS_BEFORE_GAME_DROPPED) / GAME_WHEEL_SLOT_TICKS) % GAME_WHEEL_SLOTS);
+
+	//off whichever slot it was in (if any)..
+	if (game->wheel_prev)
+		game->wheel_prev->wheel_next = game->wheel_next;
+	else if (Config->game_wheel[game->wheel_slot] == game)
+		Config->game_wheel[game->wheel_slot] = game->wheel_next;
+	if (game->wheel_next)
+		game->wheel_next->wheel_prev = game->wheel_prev;
+
+	//..and onto its new one
+	game->wheel_slot = slot;
+	game->wheel_prev = NULL;
+	game->wheel_next = Config->game_wheel[slot];
+	if (game->wheel_next)
+		game->wheel_next->wheel_prev = game;
+	Config->game_wheel[slot] = game;
+} /* _schedule_game_drop */
+
+
+/* 
+ * Static Function: _remove_game
+ *--------------------------------------------------------------------
+ * Parameters:
+ *   [IN] Config 
+ *   [IN] game
+ *
+ * Returns:
+ *  
+ *
+ * Description:
+ *   Takes the game out of the table and the wheel, and frees it.
+ *
+ *--------------------------------------------------------------------
+ */
+
+static void _remove_game(NMConfigRef Config, struct available_game_data *game)
+{
+	struct available_game_data **link;
+
+	for (link = _game_bucket(Config, game->host); *link; link = &(*link)->hash_next)
+	{
+		if (*link == game)
+		{
+			*link = game->hash_next;
+			break;
+		}
+	}
+
+	if (game->wheel_prev)
+		game->wheel_prev->wheel_next = game->wheel_next;
+	else
+		Config->game_wheel[game->wheel_slot] = game->wheel_next;
+	if (game->wheel_next)
+		game->wheel_next->wheel_prev = game->wheel_prev;
+
+	Config->game_count--;
+	free(game);
+} /* _remove_game */
+
+
+/* 
+ * Static Function: _dispose_games
+ *--------------------------------------------------------------------
+ * Parameters:
+ *   [IN] Config 
+ *
+ * Returns:
+ *  
+ *
+ * Description:
+ *   Forgets every game, and the table they were in.
+ *
+ *--------------------------------------------------------------------
+ */
+
+static void _dispose_games(NMConfigRef Config)
+{
+	struct available_game_data *game;
+	long index;
+
+	for (index = 0; index < Config->game_table_size; index++)
+	{
+		while ((game = Config->game_table[index]) != NULL)
+		{
+			Config->game_table[index] = game->hash_next;
+			free(game);
+		}
+	}
+
+	if (Config->game_table)
+		free(Config->game_table);
+	Config->game_table = NULL;
+	Config->game_table_size = 0;
+	Config->game_count = 0;
+	machine_mem_zero(Config->game_wheel, sizeof(Config->game_wheel));
+	Config->new_games = NULL;
+	Config->new_games_tail = NULL;
+} /* _dispose_games */
+
+
+/* 
+ * Static Function: _announce_new_games
+ *--------------------------------------------------------------------
+ * Parameters:
+ *   [IN] Config 
+ *
+ * Returns:
+ *  
+ *
+ * Description:
+ *   Tells the callback about each game we've heard from for the first time since last we called it.
+ *
+ *--------------------------------------------------------------------
+ */
+
+static void _announce_new_games(NMConfigRef Config)
+{
+	struct available_game_data *game;
+	NMEnumerationItem item;
+
+	while ((game = Config->new_games) != NULL)
+	{
+		Config->new_games = game->new_next;
+		game->new_next = NULL;
+		game->flags &= ~_new_game_flag;
+		if (!Config->new_games)
+			Config->new_games_tail = NULL;
+
+		item.id = game->host;
+		item.name = game->name;
+
+		// mb_printf("giving callbacks item (Host: 0x%x port: %d) as new game", 
+		//game->host, game->port)  
+
+		Config->callback(Config->user_context, kNMEnumAdd, &item);
+
+		//(they may have ended the enumeration from the callback)
+		if (!Config->enumerating)
+			return;
+	}
+} /* _announce_new_games */
+
+
+/* 
+ * Static Function: _drop_stale_games
+ *--------------------------------------------------------------------
+ * Parameters:
+ *   [IN] Config 
+ *
+ * Returns:
+ *  
+ *
+ * Description:
+ *   Turns the timer wheel up to now, dropping (and telling the callback about)
+ *   each game in the slots passed that we haven't heard from in too long.
+ *   The slot now is in is looked at again next time, since it isn't over yet.
+ *
+ *--------------------------------------------------------------------
+ */
+
+static void _drop_stale_games(NMConfigRef Config)
+{
+	NMUInt32 now = machine_tick_count();
+	NMUInt32 first_slot = Config->game_wheel_ticks / GAME_WHEEL_SLOT_TICKS;
+	NMUInt32 last_slot = now / GAME_WHEEL_SLOT_TICKS;
+	NMUInt32 slot_count = last_slot - first_slot + 1;
+	NMUInt32 index;
+
+	//(a whole turn or more since last time means every slot)
+	if (slot_count > GAME_WHEEL_SLOTS)
+		slot_count = GAME_WHEEL_SLOTS;
+
+	for (index = 0; index < slot_count; index++)
+	{
+		struct available_game_data *game = Config->game_wheel[(first_slot + index) % GAME_WHEEL_SLOTS];
+
+		while (game)
+		{
+			struct available_game_data *next_game = game->wheel_next;
+
+			// Drop if necessary
+			if (now - game->ticks_at_last_response > TICKS_BEFORE_GAME_DROPPED)
+			{
+				NMEnumerationItem item;
+
+				// time to drop this one..
+				item.id = game->host;
+				item.name = game->name;
+
+				// mb_printf("giving callbacks item 0x%x as delete game", game->host);
+
+				Config->callback(Config->user_context, kNMEnumDelete, &item);
+
+				_remove_game(Config, game);
+
+				//(they may have ended the enumeration from the callback)
+				if (!Config->enumerating)
+					return;
+			}
+			game = next_game;
+		}
+	}
+
+	Config->game_wheel_ticks = now;
+} /* _drop_stale_games */
+
+
+/* 
+ * Static Function: _deliver_enumeration_news
+ *--------------------------------------------------------------------
+ * Parameters:
+ *   [IN] Config 
+ *
+ * Returns:
+ *  
+ *
+ * Description:
+ *   Makes all the callbacks we have news for - new games first, then those
+ *   that have gone quiet.  If one of them ends the enumeration, NMEndEnumeration
+ *   leaves the games for us to get rid of once we're done with them.
+ *
+ *--------------------------------------------------------------------
+ */
+
+static void _deliver_enumeration_news(NMConfigRef Config)
+{
+	Config->announcing = true;
+
+	_announce_new_games(Config);
+	if (Config->enumerating)
+		_drop_stale_games(Config);
+
+	Config->announcing = false;
+
+	if (!Config->enumerating)
+		_dispose_games(Config);
+} /* _deliver_enumeration_news */
+
+
+/* 
+ * Static Function: _lock_background_enumerations
+ *--------------------------------------------------------------------
+ * Parameters:
+ *   none
+ *
+ * Returns:
+ *   true if we took the lock (and so must give it back)
+ *
+ * Description:
+ *   Function 
+ *
+ *--------------------------------------------------------------------
+ */
+
+static NMBoolean _lock_background_enumerations(void)
+{
+	//the worker already has it if we're in one of its callbacks
+	if ((backgroundEnumerationLockHeld) && (onEnumerationWorker()))
+		return false;
+
+	machine_wait_for_lock(backgroundEnumerationLock);
+	return true;
+} /* _lock_background_enumerations */
+
+
+/* 
+ * Function: createBackgroundEnumerations
+ *--------------------------------------------------------------------
+ * Parameters:
+ *   none
+ *
+ * Returns:
+ *   true on success
+ *
+ * Description:
+ *   Function 
+ *
+ *--------------------------------------------------------------------
+ */
+
+int createBackgroundEnumerations(void)
+{
+	backgroundEnumerationLock = new machine_lock;
+	backgroundEnumerations = NULL;
+
+	return (backgroundEnumerationLock != NULL);
+} /* createBackgroundEnumerations */
+
+
+/* 
+ * Function: disposeBackgroundEnumerations
+ *--------------------------------------------------------------------
+ * Parameters:
+ *   none
+ *
+ * Returns:
+ *  
+ *
+ * Description:
+ *   Called once the workers are gone.
+ *
+ *--------------------------------------------------------------------
+ */
+
+void disposeBackgroundEnumerations(void)
+{
+	backgroundEnumerations = NULL;
+
+	if (backgroundEnumerationLock)
+		delete backgroundEnumerationLock;
+	backgroundEnumerationLock = NULL;
+} /* disposeBackgroundEnumerations */
+
+
+/* 
+ * Function: backgroundEnumerationsActive
+ *--------------------------------------------------------------------
+ * Parameters:
+ *   none
+ *
+ * Returns:
+ *   true if the worker has any enumerations to look after
+ *
+ * Description:
+ *   (only a hint - it's read without the lock)
+ *
+ *--------------------------------------------------------------------
+ */
+
+NMBoolean backgroundEnumerationsActive(void)
+{
+	return (backgroundEnumerations != NULL);
+} /* backgroundEnumerationsActive */
+
+
+#if (!USE_EPOLL)
+/* 
+ * Function: watchBackgroundEnumerations
+ *--------------------------------------------------------------------
+ * Parameters:
+ *   [IN] input_set = the first worker's select() set
+ *   [IN] nfds = 
+ *
+ * Returns:
+ *   nfds, raised to cover the sockets added
+ *
+ * Description:
+ *   Adds each background enumeration's socket to the set, so a reply wakes
+ *   the worker.  If someone has the list just now, it does without this
+ *   pass - it won't wait longer than ENUMERATION_POLL_INTERVAL_MSEC anyway.
+ *
+ *--------------------------------------------------------------------
+ */
+
+long watchBackgroundEnumerations(fd_set *input_set, long nfds)
+{
+	NMConfigRef Config;
+
+	if ((backgroundEnumerations == NULL) || (backgroundEnumerationLock == NULL))
+		return nfds;
+
+	if (machine_acquire_lock(backgroundEnumerationLock) == false)
+		return nfds;
+
+	for (Config = backgroundEnumerations; Config != NULL; Config = Config->enumeration_next)
+	{
+		FD_SET(Config->enumeration_socket, input_set);
+		if (Config->enumeration_socket + 1 > nfds)
+			nfds = Config->enumeration_socket + 1;
+	}
+
+	machine_clear_lock(backgroundEnumerationLock);
+	return nfds;
+} /* watchBackgroundEnumerations */
+#endif
+
+
+/* 
+ * Function: processBackgroundEnumerations
+ *--------------------------------------------------------------------
+ * Parameters:
+ *   none
+ *
+ * Returns:
+ *  
+ *
+ * Description:
+ *   Called by the first worker after each pass over its endpoints. Does for each
+ *   background enumeration what NMIdleEnumeration does for the others - reads
+ *   the replies that have come in, asks again if it's time, and makes the callbacks.
+ *
+ *--------------------------------------------------------------------
+ */
+
+void processBackgroundEnumerations(void)
+{
+	NMConfigRef Config;
+	NMUInt32 listStartState;
+
+	if ((backgroundEnumerations == NULL) || (backgroundEnumerationLock == NULL))
+		return;
+
+	machine_wait_for_lock(backgroundEnumerationLock);
+	backgroundEnumerationLockHeld = true;
+
+	//so we can stop if a callback changes the list
+	listStartState = backgroundEnumerationListState;
+
+	for (Config = backgroundEnumerations; Config != NULL; Config = Config->enumeration_next)
+	{
+		if (_handle_packets(Config) == kNMNoError)
+			_send_game_request_packet(Config);
+
+		_deliver_enumeration_news(Config);
+
+		//(the rest get their turn next time)
+		if (listStartState != backgroundEnumerationListState)
+			break;
+	}
+
+	backgroundEnumerationLockHeld = false;
+	machine_clear_lock(backgroundEnumerationLock);
+} /* processBackgroundEnumerations */
+
 
 /* 
  * Static Function: _handle_game_enumeration_packet
@@ -58,33 +624,72 @@
 
 static void _handle_game_enumeration_packet(NMConfigRef Config, 
                                             IPEnumerationResponsePacket *packet,
-                                            long host, unsigned short port)
+                                            int length,
+                                            struct sockaddr_storage *address)
 {
 	DEBUG_ENTRY_EXIT("_handle_game_enumeration_packet");
 	if(Config && Config->enumerating)
 	{
+		NMUInt32 hostKey;
+
 		/* Byteswap the packet.. */
-		packet->host = host; /* in network byte order. */
-		packet->port = port;
+		packet->host = htonl(sockaddr_ipv4_host(address)); /* in network byte order. */
+		packet->port = sockaddr_port(address);
 		byteswap_ip_enumeration_packet((char *) packet);
 
-		if ((Config->gameID == packet->gameID) && 
-			(Config->new_game_count < MAXIMUM_GAMES_ALLOWED_BETWEEN_IDLE))
+		/* newer hosts give us a key to know them by, since IPv6 addresses don't fit in host */
+		if (get_ip_enumeration_host_key((char *) packet, length, &hostKey))
+			packet->host = hostKey;
+		else if (packet->host == 0)
+			return; /* an older host over IPv6 - we'd have no way to tell it from the next */
+
+		if (Config->gameID == packet->gameID)
 		{
-			struct available_game_data *new_game;
+			struct available_game_data *game = _find_game(Config, packet->host, packet->port);
+
+			if (game)
+			{
+				//a host heard over IPv4 and IPv6 both is reached over IPv6
+				if ((sockaddr_ipv4_host(&game->address) != 0) && (sockaddr_ipv4_host(address) == 0))
+					game->address = *address;
+
+				game->ticks_at_last_response = machine_tick_count();
+				_schedule_game_drop(Config, game);
+				return;
+			}
+
+			if (Config->game_count >= Config->game_table_size)
+				_grow_game_table(Config);
+			if (!Config->game_table)
+				return;
+
+			game = (struct available_game_data *) calloc(1, sizeof(struct available_game_data));
+			if (!game)
+				return;
 
-			new_game = &Config->new_games[Config->new_game_count++];
+			game->host  = packet->host;
+			game->port  = packet->port;
+			game->address = *address;
+			game->flags = _new_game_flag;
+			game->ticks_at_last_response= machine_tick_count();
 
-			memset(new_game, 0, sizeof(struct available_game_data));
+			strncpy(game->name, packet->name, kMaxGameNameLen);
 
-			new_game->host  = packet->host;
-			new_game->port  = packet->port;
-			new_game->flags = _new_game_flag;
-			new_game->ticks_at_last_response= machine_tick_count();
+			game->name[kMaxGameNameLen]= '\0';
 
-			strncpy(new_game->name, packet->name, kMaxGameNameLen);
+			struct available_game_data **bucket = _game_bucket(Config, game->host);
 
-			new_game->name[kMaxGameNameLen]= '\0';
+			game->hash_next = *bucket;
+			*bucket = game;
+			Config->game_count++;
+			_schedule_game_drop(Config, game);
+
+			//(announced in the order we heard from them)
+			if (Config->new_games)
+				Config->new_games_tail->new_next = game;
+			else
+				Config->new_games = game;
+			Config->new_games_tail = game;
 		}
 	}	
 
@@ -112,7 +717,7 @@ static NMErr _handle_packets(NMConfigRef Config)
 
 	DEBUG_ENTRY_EXIT("_handle_packets");
 
-	struct sockaddr_in source_address;
+	struct sockaddr_storage source_address;
 	int bytes_read;
 	int done = 0;
 	posix_size_type source_address_len = sizeof(source_address);
@@ -123,6 +728,7 @@ static NMErr _handle_packets(NMConfigRef Config)
 	while (!done)
 	{
 		//op_errno = 0;
+		source_address_len = sizeof(source_address);
 		bytes_read = recvfrom(Config->enumeration_socket, Config->buffer, (unsigned long)MAXIMUM_CONFIG_LENGTH,
 		0, (sockaddr*)&source_address, &source_address_len);
 
@@ -132,9 +738,9 @@ static NMErr _handle_packets(NMConfigRef Config)
 			
 			IPEnumerationResponsePacket *packet = (IPEnumerationResponsePacket *) Config->buffer;
 
-			if (packet->responseCode == htonl(kReplyFlag))
+			if ((bytes_read >= (int) sizeof(IPEnumerationResponsePacket)) && (packet->responseCode == htonl(kReplyFlag)))
 			{
-				_handle_game_enumeration_packet(Config, packet, source_address.sin_addr.s_addr, source_address.sin_port);
+				_handle_game_enumeration_packet(Config, packet, bytes_read, &source_address);
 			} 
 			else
 			DEBUG_PRINT("Got a response packet with a size of %d but a response code of: 0x%x", bytes_read, packet->responseCode);
@@ -175,7 +781,9 @@ static void _send_game_request_packet(NMConfigRef Config)
 	{
 		Config->ticks_at_last_enumeration_request = machine_tick_count();
 
-		struct sockaddr_in dest_address;
+		struct sockaddr_storage dest_addresses[2];
+		long dest_count = 1;
+		long index;
 		char request_packet[kQuerySize];
 		int bytes_sent;
 		short packet_length;
@@ -185,31 +793,50 @@ static void _send_game_request_packet(NMConfigRef Config)
 
 		op_assert(packet_length <= sizeof(request_packet));
 
-		/* Build the address. */
-		dest_address.sin_family = AF_INET;
-		dest_address.sin_addr.s_addr = INADDR_BROADCAST;
-		dest_address.sin_port = Config->hostAddr.sin_port; //already in network order
-		DEBUG_PRINT("broadcasting to port %d",ntohs(dest_address.sin_port));
-
 		/* Send the request. */
 		if (Config->enumeration_socket == INVALID_SOCKET)
 		{
 			DEBUG_PRINT("invalid socket for enumeration");
 			return;
 		}
-		
-		bytes_sent = sendto(Config->enumeration_socket, request_packet, packet_length, 0,
-		(sockaddr*)&dest_address, sizeof(dest_address));
-		if (bytes_sent == -1)
+
+		/* Build the addresses - an IPv4 broadcast, and on a dual-stack socket (where that has */
+		/* to be v4-mapped) a multicast to every IPv6 node on the link as well */
+		any_sockaddr(&dest_addresses[0], Config->enumeration_family, sockaddr_port(&Config->hostAddr)); //already in network order
+		if (Config->enumeration_family == AF_INET6)
 		{
-			DEBUG_NETWORK_API("sendto()",bytes_sent);
-		} 
-		else{
-			DEBUG_PRINT("bytes sent: %d",bytes_sent);
-		#ifdef DEBUG
-			if (bytes_sent != packet_length)
-				DEBUG_PRINT("Error in  _send_game_request_packet: sendto only delivered %d bytes of %d", bytes_sent, packet_length);
-			#endif
+			struct sockaddr_in6 *broadcast = (struct sockaddr_in6 *) &dest_addresses[0];
+			struct sockaddr_in6 *all_nodes = (struct sockaddr_in6 *) &dest_addresses[1];
+
+			broadcast->sin6_addr.s6_addr[10] = 0xff;
+			broadcast->sin6_addr.s6_addr[11] = 0xff;
+			memset(&broadcast->sin6_addr.s6_addr[12], 0xff, 4);
+
+			any_sockaddr(&dest_addresses[1], AF_INET6, sockaddr_port(&Config->hostAddr));
+			all_nodes->sin6_addr.s6_addr[0] = 0xff;
+			all_nodes->sin6_addr.s6_addr[1] = 0x02;
+			all_nodes->sin6_addr.s6_addr[15] = 0x01;
+			dest_count = 2;
+		}
+		else
+			((struct sockaddr_in *) &dest_addresses[0])->sin_addr.s_addr = INADDR_BROADCAST;
+		DEBUG_PRINT("broadcasting to port %d",ntohs(sockaddr_port(&Config->hostAddr)));
+
+		for (index = 0; index < dest_count; index++)
+		{
+			bytes_sent = sendto(Config->enumeration_socket, request_packet, packet_length, 0,
+			(sockaddr*)&dest_addresses[index], sockaddr_length(&dest_addresses[index]));
+			if (bytes_sent == -1)
+			{
+				DEBUG_NETWORK_API("sendto()",bytes_sent);
+			} 
+			else{
+				DEBUG_PRINT("bytes sent: %d",bytes_sent);
+			#ifdef DEBUG
+				if (bytes_sent != packet_length)
+					DEBUG_PRINT("Error in  _send_game_request_packet: sendto only delivered %d bytes of %d", bytes_sent, packet_length);
+				#endif
+			}
 		}
 	}
 
@@ -242,21 +869,22 @@ NMErr NMBindEnumerationItemToConfig(NMConfigRef inConfig, NMHostID inID)
 	op_assert(inConfig->cookie==config_cookie);
 	if(inConfig->enumerating)
 	{
-		int	index;
+		struct available_game_data *game= NULL;
 
-		for(index= 0; index<inConfig->game_count; ++index)
+		if(inConfig->game_table)
 		{
-			if((NMHostID)(inConfig->games[index].host)==inID)
-	    	{
-				inConfig->hostAddr.sin_family = AF_INET;
-				inConfig->hostAddr.sin_addr.s_addr = htonl(inConfig->games[index].host);
-				inConfig->hostAddr.sin_port = htons(inConfig->games[index].port);
-				strcpy(inConfig->host_name, inet_ntoa(inConfig->hostAddr.sin_addr));
-				break;
-		    }
+			for(game= *_game_bucket(inConfig, (long) inID); game; game= game->hash_next)
+			{
+				if((NMHostID)(game->host)==inID)
+		    	{
+					inConfig->hostAddr = game->address;
+					sockaddr_to_string(&inConfig->hostAddr, inConfig->host_name, sizeof(inConfig->host_name));
+					break;
+			    }
+			}
 		}
 		
-		if	(index==inConfig->game_count)
+		if	(!game)
 	  		err= kNMInvalidConfigErr;
 
 	} else
@@ -311,29 +939,29 @@ NMErr NMStartEnumeration(NMConfigRef Config, NMEnumerationCallbackPtr Callback,
 	if(!Config->enumerating)
 	{  
 		op_assert(!Config->callback);
-		op_assert(!Config->games);
+		op_assert(!Config->game_table);
 		op_assert(!Config->game_count);
 		op_assert(Config);
 		op_assert(Config->enumeration_socket==INVALID_SOCKET);
   
-		if (Config->callback || Config->games || Config->game_count || 
+		if (Config->callback || Config->game_table || Config->game_count || 
 			(Config->enumeration_socket != INVALID_SOCKET))
 		{
 			DEBUG_PRINT("return b");
 			return(kNMInvalidConfigErr);
 		}
 	    
-	    Config->enumeration_socket = socket(AF_INET, SOCK_DGRAM, 0);
+	    //a dual-stack socket hears from hosts over IPv4 and IPv6 both
+	    Config->enumeration_family = passive_socket_family();
+	    Config->enumeration_socket = open_socket(Config->enumeration_family, SOCK_DGRAM);
 
 		if (Config->enumeration_socket != INVALID_SOCKET)
 		{
-			struct sockaddr_in  sock_addr;
+			struct sockaddr_storage  sock_addr;
 			
-			sock_addr.sin_family = AF_INET;
-			sock_addr.sin_addr.s_addr = INADDR_ANY;
-			sock_addr.sin_port = 0;
+			any_sockaddr(&sock_addr, Config->enumeration_family, 0);
 
-			status = bind(Config->enumeration_socket, (sockaddr*)&sock_addr, sizeof(sock_addr));
+			status = bind(Config->enumeration_socket, (sockaddr*)&sock_addr, sockaddr_length(&sock_addr));
 
 
 			if (status == 0)
@@ -350,9 +978,28 @@ NMErr NMStartEnumeration(NMConfigRef Config, NMEnumerationCallbackPtr Callback,
 				Config->user_context = Context;
 				Config->enumerating  = true;
 				Config->ticks_at_last_enumeration_request = 0;
+				Config->game_wheel_ticks = machine_tick_count();
 
 				/* clear the enumeration list */
 				Config->callback(Config->user_context, kNMEnumClear, NULL);
+
+				/* hand it to the worker, if it's to look after it */
+				if (Config->backgroundEnumeration)
+				{
+					NMBoolean locked;
+
+					createWorkerThread();
+
+					locked = _lock_background_enumerations();
+					Config->enumeration_next = backgroundEnumerations;
+					backgroundEnumerations = Config;
+					backgroundEnumerationListState++;
+					if (locked)
+						machine_clear_lock(backgroundEnumerationLock);
+
+					//(this wakes it too, so it stops waiting as long as it was going to)
+					watchEnumerationSocket(Config->enumeration_socket, true);
+				}
 			}
 			else
 			{
@@ -410,8 +1057,8 @@ NMErr NMIdleEnumeration(NMConfigRef Config)
 	if (Config->cookie != config_cookie)
 	return(kNMInvalidConfigErr);
 
-	//we do nothing for inactive enumeration
-	if (Config->activeEnumeration == false)
+	//we do nothing for inactive enumeration, nor for one the worker is looking after
+	if ((Config->activeEnumeration == false) || (Config->backgroundEnumeration))
 		return kNMNoError;
 
 	if (Config->enumerating)
@@ -419,106 +1066,10 @@ NMErr NMIdleEnumeration(NMConfigRef Config)
 
 		err = _handle_packets(Config);
 
-		if ((err == kNMNoError) && (Config->new_game_count))  /* add game to list */
+		if (err == kNMNoError)
 		{
-			int index;
-			int added_game_count = 0;
-			struct available_game_data *new_games;
-
-			for (index = 0; index < Config->new_game_count; ++index)
-			{
-				int compare_index;
-
-				for (compare_index = 0; compare_index < Config->game_count; ++compare_index)
-				{
-					if ((Config->new_games[index].host == Config->games[compare_index].host) &&
-					(Config->new_games[index].port == Config->games[compare_index].port))
-					{
-						Config->new_games[index].flags |= _duplicate_game_flag;
-						Config->games[compare_index].ticks_at_last_response = machine_tick_count();
-						break;
-					}
-				} /* for(compare_index) */
-
-				if (compare_index == Config->game_count)
-				added_game_count++;
-			} /* for(index) */
-
-			/* Now allocate and add... */
-			if (added_game_count)
-			{
-				new_games = (struct available_game_data *) calloc(1, (Config->game_count + added_game_count) * sizeof(struct available_game_data));
-
-				if (new_games)
-				{
-					memcpy(new_games, Config->games, Config->game_count * sizeof(struct available_game_data));
-
-					// bump the count.
-					for (index = 0; index < Config->new_game_count; ++index)
-					{
-						if ( !(Config->new_games[index].flags & _duplicate_game_flag) )
-						{
-							struct available_game_data *new_game = &new_games[Config->game_count++];
-
-							memcpy(new_game, &Config->new_games[index], sizeof(struct available_game_data));
-						}
-					} // for(index)
-
-					if (Config->games) 
-						free(Config->games);
-
-					Config->games = new_games;
-				} // if (new_games)
-			}
-
-			// reset the new game count, since it is now in our global...
-			Config->new_game_count = 0;
-
-			// Give their callback the items... 
-			index = 0;
-
-			while (index < Config->game_count)
-			{
-				NMEnumerationItem item;
-
-				if (Config->games[index].flags & _new_game_flag)
-				{
-					Config->games[index].flags &= ~_new_game_flag;
-
-					item.id = Config->games[index].host;
-					item.name = Config->games[index].name;
-
-					// mb_printf("giving callbacks item %d (Host: 0x%x port: %d) as new game", index, 
-					//Config->games[index].host, Config->games[index].port)  
-
-					Config->callback(Config->user_context, kNMEnumAdd, &item);
-
-					// next!
-					index++;
-				} 
-				else 
-				{
-					// Drop if necessary
-					if (machine_tick_count() - Config->games[index].ticks_at_last_response > TICKS_BEFORE_GAME_DROPPED)
-					{
-						// time to drop this one..
-						item.id = Config->games[index].host;
-						item.name = Config->games[index].name;
-
-						// mb_printf("giving callbacks item %d as delete game", index);
-
-						Config->callback(Config->user_context, kNMEnumDelete, &item);
-
-						memmove(&Config->games[index], &Config->games[index+1],
-						(Config->game_count-index - 1) * sizeof(struct available_game_data));
-
-						Config->game_count -= 1;
-					} 
-					else
-					index++; // go to next 
-				}
-			}
-
+			// Give their callback the new items, and take away the ones that have gone quiet...
+			_deliver_enumeration_news(Config);
 		}
 	}
 	else
@@ -573,14 +1124,33 @@ NMErr NMEndEnumeration(NMConfigRef Config)
 
 	if (Config->enumerating)
 	{
-		if (Config->game_count)
+		//take it back from the worker - once we have the lock, it's not in the middle of it
+		if (Config->backgroundEnumeration)
 		{
-			Config->game_count = 0;
+			NMBoolean locked = _lock_background_enumerations();
+			NMConfigRef *link;
 
-			if (Config->games)
-				free(Config->games);
+			for (link = &backgroundEnumerations; *link; link = &(*link)->enumeration_next)
+			{
+				if (*link == Config)
+				{
+					*link = Config->enumeration_next;
+					backgroundEnumerationListState++;
+					break;
+				}
+			}
+			Config->enumeration_next = NULL;
+
+			if (locked)
+				machine_clear_lock(backgroundEnumerationLock);
+
+			if (Config->enumeration_socket != INVALID_SOCKET)
+				watchEnumerationSocket(Config->enumeration_socket, false);
 		}
-		Config->games = NULL;
+
+		//(if we're in one of its callbacks, whoever's making them gets rid of the games afterwards)
+		if (!Config->announcing)
+			_dispose_games(Config);
 
 		Config->callback = NULL;
 		Config->enumerating = false;
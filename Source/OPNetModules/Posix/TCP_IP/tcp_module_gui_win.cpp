@@ -144,7 +144,7 @@ NMSetupDialog(
 	if (GetWindowRect(windowModuleBoxItem,&windowModuleBox) &&
 	    GetWindowRect(dialog,&mainWindowBox))
 	{
-		NMUInt16		portNum = ntohs(inConfig->hostAddr.sin_port);
+		NMUInt16		portNum = ntohs(sockaddr_port(&inConfig->hostAddr));
 
 	// correct for the location of the parent window.
 		windowModuleBox.left -= mainWindowBox.left;
@@ -266,7 +266,7 @@ NMTeardownDialog(
 		GetDlgItemText(dialog,gCommandNumberBase+kHostText,inConfig->host_name,255);
 
 	//	Get the port number as unsigned in network byte order
-		inConfig->hostAddr.sin_port = htons((u_short)GetDlgItemInt(dialog,gCommandNumberBase+(NMSInt32)kPortText,NULL,false));
+		set_sockaddr_port(&inConfig->hostAddr, htons((u_short)GetDlgItemInt(dialog,gCommandNumberBase+(NMSInt32)kPortText,NULL,false)));
 	}
 
 	return true;
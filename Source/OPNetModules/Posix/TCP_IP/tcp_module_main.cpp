@@ -58,11 +58,8 @@ static const NMUInt32 moduleID = 'Inet';
 static const char *kModuleName = "TCP/IP";
 static const char *kModuleCopyright = "1996-2004 Apple Computer, Inc.";
 
-NMEndpointPriv *endpointList = NULL;
-NMUInt32 endpointListState = 0;
-machine_lock *endpointListLock; //dont access the list without locking it!
-machine_lock *endpointWaitingListLock;
-machine_lock *notifierLock; //dont call the user back without locking it!
+NMWorkerShard *workerShards = NULL; //each has its own endpoint list - dont access one without locking it!
+long workerShardCount = 0;
 
 NMSInt32 module_inited = 0;
 
@@ -108,23 +105,26 @@ void _init(void)
 	gModuleInfo.maxEndpoints = kNMNoEndpointLimit;
 	gModuleInfo.flags= kNMModuleHasStream | kNMModuleHasDatagram | kNMModuleHasExpedited;
 
-	//create the lock for our main list
-	endpointListLock = new machine_lock;
-	endpointWaitingListLock = new machine_lock;
-	notifierLock = new machine_lock;	
-
 #ifdef OP_API_NETWORK_WINSOCK
 	initWinsock();	//LR -- can not use sockets before they are started up!
 #endif
 
-	if (createWakeSocket())
-		DEBUG_PRINT("createWakeSocket succeeded");
+	//create the lists, locks and wake sockets for our workers
+	if (createWorkerShards())
+		DEBUG_PRINT("createWorkerShards succeeded");
 	else
 #ifdef OP_API_NETWORK_WINSOCK
-		DEBUG_PRINT("createWakeSocket failed, err = %d", WSAGetLastError() );
+		DEBUG_PRINT("createWorkerShards failed, err = %d", WSAGetLastError() );
 #else
-		DEBUG_PRINT("createWakeSocket failed");
+		DEBUG_PRINT("createWorkerShards failed");
 #endif
+
+	//and have some endpoints ready for the first joiners
+	if (!createEndpointPool())
+		DEBUG_PRINT("createEndpointPool failed");
+
+	if (!createBackgroundEnumerations())
+		DEBUG_PRINT("createBackgroundEnumerations failed");
 	
 } /* _init */
 
@@ -155,6 +155,9 @@ void _fini(void)
 			
 	//op_assert(module_inited == true);
 
+	//any lookups still going have nobody left to tell
+	killResolverThreads();
+
 	//if we have a worker thread, kill it
 	#if USE_WORKER_THREAD
 		killWorkerThread();
@@ -165,11 +168,9 @@ void _fini(void)
 		shutdownWinsock();
 	#endif
 	
-	delete endpointListLock;
-	delete endpointWaitingListLock;
-	delete notifierLock;
-	
-	disposeWakeSocket();
+	disposeWorkerShards();
+	disposeEndpointPool();
+	disposeBackgroundEnumerations();
 
 #ifdef OP_API_NETWORK_WINSOCK
 	WSACleanup();
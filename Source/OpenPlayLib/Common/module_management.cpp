@@ -37,8 +37,15 @@
 #include "OPDLLUtils.h"
 #include "module_management.h"
 
+/* ----------- local definitions */
+
+/* endpoints are at least this far apart, so the low bits of their address tell us nothing */
+#define ENDPOINT_REGISTRY_INDEX(e)	(((NMUInt32) (((size_t) (e)) / sizeof(Endpoint))) & (ENDPOINT_REGISTRY_SIZE - 1))
+
 /* ----------- local prototypes  */
 static void remove_loaded_module(loaded_modules_data *loaded_module);
+static loaded_modules_data *find_loaded_module(NMType type);
+static void load_endpoint_dispatch(ConnectionRef connection, endpoint_dispatch *dispatch);
 
 /* ---------- code */
 
@@ -49,7 +56,8 @@ static void remove_loaded_module(loaded_modules_data *loaded_module);
 NMErr bind_to_protocol(
 	NMType type,
 	FileDesc *spec,
-	ConnectionRef *connection)
+	ConnectionRef *connection,
+	const endpoint_dispatch **dispatch)
 {
 	loaded_modules_data *loaded_module;
 	NMErr err= kNMNoError;
@@ -61,6 +69,7 @@ NMErr bind_to_protocol(
 		if(loaded_module->type==type)
 		{
 			*connection= loaded_module->connection;
+			if(dispatch) *dispatch= &loaded_module->dispatch;
 			loaded_module->connection_binded_count+= 1;
 			found= true;
 		}
@@ -84,6 +93,7 @@ NMErr bind_to_protocol(
 				loaded_module->connection= new_connection;
 				loaded_module->connection_binded_count= 1;
 				loaded_module->first_loaded_endpoint= NULL;
+				load_endpoint_dispatch(new_connection, &loaded_module->dispatch);
 
 				/* attach.. */
 				loaded_module->next= gOp_globals.loaded_modules;
@@ -91,6 +101,7 @@ NMErr bind_to_protocol(
 				/* DEBUG_PRINT("INITIAL BIND"); */
 				/* and return the right thing.. */
 				*connection= loaded_module->connection;
+				if(dispatch) *dispatch= &loaded_module->dispatch;
 			} else {
 				free_library(new_connection);
 				err= kNMOutOfMemoryErr;
@@ -165,23 +176,25 @@ void add_endpoint_to_loaded_list(
 	Endpoint *endpoint)
 {
 	loaded_modules_data *loaded_module;
-	NMBoolean found= false;
 
-	loaded_module= gOp_globals.loaded_modules;
-	while(!found && loaded_module)
+	loaded_module= find_loaded_module(endpoint->type);
+	if(loaded_module)
 	{
-		if(loaded_module->type==endpoint->type)
-		{
-			/* add it to the head of the list.. */
-			endpoint->next= loaded_module->first_loaded_endpoint;
-			loaded_module->first_loaded_endpoint= endpoint;
-			loaded_module->endpoints_instantiated+= 1;
-			found= true;
-			/*DEBUG_PRINT("ADDING endpoint to loaded list: New Count:  %d", loaded_module->endpoints_instantiated);	*/
-		}
-		loaded_module= loaded_module->next;
+		NMUInt32 index= ENDPOINT_REGISTRY_INDEX(endpoint);
+
+		/* add it to the head of the list.. */
+		endpoint->previous= NULL;
+		endpoint->next= loaded_module->first_loaded_endpoint;
+		if(endpoint->next) endpoint->next->previous= endpoint;
+		loaded_module->first_loaded_endpoint= endpoint;
+		loaded_module->endpoints_instantiated+= 1;
+
+		/* ..and to the registry, so valid_endpoint() can find it */
+		endpoint->registry_next= gOp_globals.endpoint_registry[index];
+		gOp_globals.endpoint_registry[index]= endpoint;
+		/*DEBUG_PRINT("ADDING endpoint to loaded list: New Count:  %d", loaded_module->endpoints_instantiated);	*/
 	}
-	op_assert(found);
+	op_assert(loaded_module);
 }
 
 //----------------------------------------------------------------------------------------
@@ -193,26 +206,17 @@ NMBoolean valid_endpoint(
 {
 	NMBoolean valid= false;
 	
+	/* we only look at the registry, not the endpoint itself - it may well have been freed */
 	if(endpoint)
 	{
-		loaded_modules_data *loaded_module;
+		Endpoint *ep;
+
+		ep= gOp_globals.endpoint_registry[ENDPOINT_REGISTRY_INDEX(endpoint)];
+		while(ep && ep!=endpoint) ep= ep->registry_next;
 
-		loaded_module= gOp_globals.loaded_modules;
-		while(!valid && loaded_module)
+		if(ep)
 		{
-			if(loaded_module->type==endpoint->type)
-			{
-				Endpoint *ep;
-				
-				ep= loaded_module->first_loaded_endpoint;
-				while(ep && ep!=endpoint) ep= ep->next;
-				
-				if(ep)
-				{
-					valid= true;
-				}
-			}
-			loaded_module= loaded_module->next;
+			valid= true;
 		}
 	}
 	
@@ -227,38 +231,36 @@ void remove_endpoint_from_loaded_list(
 	Endpoint *endpoint)
 {
 	loaded_modules_data *loaded_module;
-	NMBoolean found= false;
 	
-	loaded_module= gOp_globals.loaded_modules;
-	while(!found && loaded_module)
+	loaded_module= find_loaded_module(endpoint->type);
+	if(loaded_module)
 	{
-		if(loaded_module->type==endpoint->type)
-		{
-			/* remove from the list */
-			if(endpoint==loaded_module->first_loaded_endpoint)
-			{
-				loaded_module->first_loaded_endpoint= endpoint->next;
-			} else {
-				Endpoint *previous_endpoint;
-				
-				previous_endpoint= loaded_module->first_loaded_endpoint;
-				while(previous_endpoint && previous_endpoint->next != endpoint)
-				{
-					previous_endpoint= previous_endpoint->next;
-				}
-				op_assert(previous_endpoint);
-				previous_endpoint->next= endpoint->next;
-			}
-		
-			op_assert(loaded_module->endpoints_instantiated>=1);
+		Endpoint **link;
 
-			loaded_module->endpoints_instantiated-= 1;
-			/* DEBUG_PRINT("REMOVE endpoint from loaded list: New Count: %d", loaded_module->endpoints_instantiated); */	
-			found= true;
+		/* remove from the list */
+		if(endpoint->previous)
+		{
+			endpoint->previous->next= endpoint->next;
+		} else {
+			op_assert(endpoint==loaded_module->first_loaded_endpoint);
+			loaded_module->first_loaded_endpoint= endpoint->next;
 		}
-		loaded_module= loaded_module->next;
+		if(endpoint->next) endpoint->next->previous= endpoint->previous;
+		endpoint->next= endpoint->previous= NULL;
+
+		/* and from the registry */
+		link= &gOp_globals.endpoint_registry[ENDPOINT_REGISTRY_INDEX(endpoint)];
+		while(*link && *link!=endpoint) link= &(*link)->registry_next;
+		op_assert(*link);
+		if(*link) *link= endpoint->registry_next;
+		endpoint->registry_next= NULL;
+	
+		op_assert(loaded_module->endpoints_instantiated>=1);
+
+		loaded_module->endpoints_instantiated-= 1;
+		/* DEBUG_PRINT("REMOVE endpoint from loaded list: New Count: %d", loaded_module->endpoints_instantiated); */	
 	}
-	op_assert(found);
+	op_assert(loaded_module);
 }
 
 //----------------------------------------------------------------------------------------
@@ -300,6 +302,70 @@ NMSInt32 count_endpoints_of_type(
 
 /* ----------- local code */
 
+//----------------------------------------------------------------------------------------
+// load_endpoint_dispatch
+//----------------------------------------------------------------------------------------
+
+static void load_endpoint_dispatch(
+	ConnectionRef connection,
+	endpoint_dispatch *dispatch)
+{
+	/* Lock and load the pointers.. */
+	dispatch->NMGetModuleInfo= (NMGetModuleInfoPtr) load_proc(connection, kNMGetModuleInfo);
+
+	dispatch->NMGetConfig= (NMGetConfigPtr) load_proc(connection, kNMGetConfig);
+	dispatch->NMGetConfigLen= (NMGetConfigLenPtr) load_proc(connection, kNMGetConfigLen);
+
+	dispatch->NMOpen= (NMOpenPtr) load_proc(connection, kNMOpen);
+	dispatch->NMClose= (NMClosePtr) load_proc(connection, kNMClose);
+
+	dispatch->NMAcceptConnection= (NMAcceptConnectionPtr) load_proc(connection, kNMAcceptConnection);
+	dispatch->NMRejectConnection= (NMRejectConnectionPtr) load_proc(connection, kNMRejectConnection);
+
+	dispatch->NMSendDatagram= (NMSendDatagramPtr) load_proc(connection, kNMSendDatagram);
+	dispatch->NMReceiveDatagram= (NMReceiveDatagramPtr) load_proc(connection, kNMReceiveDatagram);
+
+	dispatch->NMSend= (NMSendPtr) load_proc(connection, kNMSend);
+	dispatch->NMReceive= (NMReceivePtr) load_proc(connection, kNMReceive);
+
+	dispatch->NMSetTimeout= (NMSetTimeoutPtr) load_proc(connection, kNMSetTimeout);
+	dispatch->NMIsAlive= (NMIsAlivePtr) load_proc(connection, kNMIsAlive);
+	dispatch->NMFreeAddress= (NMFreeAddressPtr) load_proc(connection, kNMFreeAddress);
+	dispatch->NMGetAddress= (NMGetAddressPtr) load_proc(connection, kNMGetAddress);
+	dispatch->NMFunctionPassThrough= (NMFunctionPassThroughPtr) load_proc(connection, kNMFunctionPassThrough);
+
+	dispatch->NMIdle= (NMIdlePtr) load_proc(connection, kNMIdle);
+
+	dispatch->NMStopAdvertising  = (NMStopAdvertisingPtr)  load_proc(connection, kNMStopAdvertising);
+	dispatch->NMStartAdvertising = (NMStartAdvertisingPtr) load_proc(connection, kNMStartAdvertising);
+
+	dispatch->NMEnterNotifier  = (NMEnterNotifierPtr)  load_proc(connection, kNMEnterNotifier);
+	dispatch->NMLeaveNotifier  = (NMLeaveNotifierPtr)  load_proc(connection, kNMLeaveNotifier);
+
+	dispatch->NMGetIdentifier = (NMGetIdentifierPtr) load_proc(connection, kNMGetIdentifier);
+
+	/* these are optional; we gather into one buffer for modules without them */
+	dispatch->NMSendDatagramv= (NMSendDatagramvPtr) load_proc(connection, kNMSendDatagramv);
+	dispatch->NMSendv= (NMSendvPtr) load_proc(connection, kNMSendv);
+	dispatch->NMSendDatagrams= (NMSendDatagramsPtr) load_proc(connection, kNMSendDatagrams);
+}
+
+//----------------------------------------------------------------------------------------
+// find_loaded_module
+//----------------------------------------------------------------------------------------
+
+static loaded_modules_data *find_loaded_module(
+	NMType type)
+{
+	loaded_modules_data *loaded_module;
+
+	loaded_module= gOp_globals.loaded_modules;
+	while(loaded_module && loaded_module->type!=type)
+		loaded_module= loaded_module->next;
+
+	return loaded_module;
+}
+
 //----------------------------------------------------------------------------------------
 // remove_loaded_module
 //----------------------------------------------------------------------------------------
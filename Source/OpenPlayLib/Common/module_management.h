@@ -31,7 +31,7 @@
 
 //	------------------------------	Public Functions
 
-	extern NMErr 		bind_to_protocol(NMType protocol, FileDesc *spec, ConnectionRef *connection);
+	extern NMErr 		bind_to_protocol(NMType protocol, FileDesc *spec, ConnectionRef *connection, const endpoint_dispatch **dispatch);
 	extern void 		unbind_from_protocol(NMType protocol, NMBoolean synchronous);
 
 	extern void 		add_endpoint_to_loaded_list(Endpoint *endpoint);
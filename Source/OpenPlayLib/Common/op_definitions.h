@@ -93,27 +93,9 @@
 		_state_closed
 	};
 
-	struct Endpoint 
+	/* a module's endpoint entry points, looked up once when we bind to it (see bind_to_protocol) */
+	struct endpoint_dispatch
 	{
-		NMUInt32					cookie;
-		NMType						type;
-		NMSInt16					state;
-		NMOpenFlags					openFlags;
-
-		/* Data */
-		ConnectionRef				connection;
-		FileDesc					library_file; /* where the code is.. */
-		
-		/* Parent (NULL if none) */
-		Endpoint			*		parent;
-		
-		/* Callback data */
-		callback_data				callback;
-
-		/* Private module specific data */
-		NMEndpointRef				module;
-		
-		/* Function pointers for standard stuff */
 		NMGetModuleInfoPtr			NMGetModuleInfo;
 
 		NMGetConfigLenPtr			NMGetConfigLen;
@@ -131,6 +113,10 @@
 		NMSendPtr					NMSend;
 		NMReceivePtr				NMReceive;
 
+		NMSendDatagramvPtr			NMSendDatagramv;	/* optional */
+		NMSendvPtr					NMSendv;			/* optional */
+		NMSendDatagramsPtr			NMSendDatagrams;	/* optional */
+
 		NMEnterNotifierPtr			NMEnterNotifier;
 		NMLeaveNotifierPtr			NMLeaveNotifier;
 		
@@ -145,8 +131,35 @@
 		NMStartAdvertisingPtr 		NMStartAdvertising;
 
 		NMGetIdentifierPtr          NMGetIdentifier;
+	};
+	typedef struct endpoint_dispatch endpoint_dispatch;
+
+	struct Endpoint 
+	{
+		NMUInt32					cookie;
+		NMType						type;
+		NMSInt16					state;
+		NMOpenFlags					openFlags;
+
+		/* Data */
+		ConnectionRef				connection;
+		FileDesc					library_file; /* where the code is.. */
+		
+		/* Parent (NULL if none) */
+		Endpoint			*		parent;
+		
+		/* Callback data */
+		callback_data				callback;
+
+		/* Private module specific data */
+		NMEndpointRef				module;
+		
+		/* Function pointers for standard stuff (shared by every endpoint of the module) */
+		const endpoint_dispatch *	dispatch;
 
 		Endpoint *					next;
+		Endpoint *					previous;		/* on the loaded module's list */
+		Endpoint *					registry_next;	/* in the endpoint registry bucket */
 	};
 	typedef struct Endpoint Endpoint;
 
@@ -156,4 +169,9 @@
 	extern void refresh_protocols(void);
 	extern void shutdown_report(void);
 
+#ifdef OP_API_NETWORK_SOCKETS
+	extern Endpoint *get_pooled_endpoint(void);
+	extern void release_pooled_endpoint(Endpoint *endpoint);
+#endif
+
 #endif // __OP_DEFINITIONS__
@@ -50,6 +50,7 @@ static PEndpointRef create_endpoint_and_bind_to_protocol_library(NMType type,
 
 static Endpoint *create_endpoint_for_accept(PEndpointRef endpoint, NMErr *err, NMBoolean *from_cache);
 static void clean_up_endpoint(PEndpointRef endpoint, NMBoolean return_to_cache);
+static NMUInt8 *gather_vectors(const NMIOVec *inVectors, NMUInt32 inCount, NMUInt32 *outLength);
 
 #if (DEBUG)
 	char* GetOPErrorName(NMErr err);
@@ -114,14 +115,14 @@ NMErr ProtocolOpenEndpoint(
 		/* So we know where we came from.. */
 		machine_copy_data(&inConfig->file, &ep->library_file, sizeof(FileDesc));
 		/* Now call it's initialization function */
-		if(ep->NMOpen)
+		if(ep->dispatch->NMOpen)
 		{
 			/* setup the callback data */
 			ep->callback.user_callback= inCallback;
 			ep->callback.user_context= inContext;
 
 			/* And open.. */			
-			err= ep->NMOpen((NMProtocolConfigPriv*)inConfig->configuration_data, net_module_callback_function, (void *)ep, &ep->module, 
+			err= ep->dispatch->NMOpen((NMProtocolConfigPriv*)inConfig->configuration_data, net_module_callback_function, (void *)ep, &ep->module, 
                                         (flags & kOpenActive) ? true : false);
 			if(!err)
 			{
@@ -181,7 +182,7 @@ NMErr ProtocolCloseEndpoint(
 	if(valid_endpoint(endpoint) && endpoint->state != _state_closing)
 	{
 		op_assert(endpoint->cookie==PENDPOINT_COOKIE);
-		if(endpoint->NMClose)
+		if(endpoint->dispatch->NMClose)
 		{
 			/* don't try to close it more than once... */
 			if(endpoint->state==_state_unknown)
@@ -190,7 +191,7 @@ NMErr ProtocolCloseEndpoint(
 				
 				//make sure we're not working with an incomplete endpoint
 				op_assert(endpoint->module != NULL);
-				err= endpoint->NMClose(endpoint->module, inOrderly);
+				err= endpoint->dispatch->NMClose(endpoint->module, inOrderly);
 
 			} else {
 				op_vwarn(endpoint->state==_state_closing, csprintf(sz_temporary, 
@@ -253,6 +254,8 @@ static void clean_up_endpoint(
     } else {
       dispose_pointer(endpoint);
     }
+#elif defined(OP_API_NETWORK_SOCKETS)
+	release_pooled_endpoint(endpoint);
 #else
   /* do something for ports here ?? */
 #endif
@@ -287,7 +290,7 @@ ProtocolAcceptConnection(
 	if(endpoint)
 	{
 		op_assert(endpoint->cookie==PENDPOINT_COOKIE);
-		if(endpoint->NMAcceptConnection)
+		if(endpoint->dispatch->NMAcceptConnection)
 		{
 			Endpoint *new_endpoint;
 			NMBoolean from_cache;
@@ -301,7 +304,7 @@ ProtocolAcceptConnection(
 				new_endpoint->callback.user_context= inNewContext;
 
 /* DEBUG_PRINT("Calling accept connection on endpoint: 0x%x ep->module: 0x%x new_endpoint: 0x%x", endpoint, endpoint->module, new_endpoint); */
-				err= endpoint->NMAcceptConnection(endpoint->module, inCookie, net_module_callback_function, new_endpoint);
+				err= endpoint->dispatch->NMAcceptConnection(endpoint->module, inCookie, net_module_callback_function, new_endpoint);
 				if(!err)
 				{
 				} else {
@@ -351,10 +354,10 @@ NMErr ProtocolRejectConnection(
 	{
 		op_assert(endpoint->cookie==PENDPOINT_COOKIE);
 
-		if(endpoint->NMRejectConnection)
+		if(endpoint->dispatch->NMRejectConnection)
 		{
 			op_assert(endpoint->module);
-			err= endpoint->NMRejectConnection(endpoint->module, inCookie);
+			err= endpoint->dispatch->NMRejectConnection(endpoint->module, inCookie);
 		} else {
 			err= kNMFunctionNotBoundErr;
 		}
@@ -402,10 +405,10 @@ NMErr ProtocolSetTimeout(
 		op_assert(endpoint->cookie==PENDPOINT_COOKIE);
 
 		/* keep a local copy. */
-		if(endpoint->NMSetTimeout)
+		if(endpoint->dispatch->NMSetTimeout)
 		{
 			op_assert(endpoint->module);
-			err= endpoint->NMSetTimeout(endpoint->module, timeout);
+			err= endpoint->dispatch->NMSetTimeout(endpoint->module, timeout);
 		} else {
 			err= kNMFunctionNotBoundErr;
 		}
@@ -442,10 +445,10 @@ NMBoolean ProtocolIsAlive(
 	{
 		op_assert(endpoint->cookie==PENDPOINT_COOKIE);
 		/* keep a local copy. */
-		if(endpoint->NMIsAlive)
+		if(endpoint->dispatch->NMIsAlive)
 		{
 			op_assert(endpoint->module);
-			state= endpoint->NMIsAlive(endpoint->module);
+			state= endpoint->dispatch->NMIsAlive(endpoint->module);
 		}
 	}
 
@@ -478,10 +481,10 @@ NMErr ProtocolIdle(
 	if(valid_endpoint(endpoint))
 	{
 		op_assert(endpoint->cookie==PENDPOINT_COOKIE);
-		if(endpoint->NMIdle)
+		if(endpoint->dispatch->NMIdle)
 		{
 			op_assert(endpoint->module);
-			err= endpoint->NMIdle(endpoint->module);
+			err= endpoint->dispatch->NMIdle(endpoint->module);
 		} else {
 			err= kNMFunctionNotBoundErr;
 		}
@@ -520,10 +523,10 @@ NMErr ProtocolFunctionPassThrough(
 		op_assert(endpoint->cookie==PENDPOINT_COOKIE);
 
 		/* keep a local copy. */
-		if(endpoint->NMFunctionPassThrough)
+		if(endpoint->dispatch->NMFunctionPassThrough)
 		{
 			op_assert(endpoint->module);
-			err= endpoint->NMFunctionPassThrough(endpoint->module, inSelector, inParamBlock);
+			err= endpoint->dispatch->NMFunctionPassThrough(endpoint->module, inSelector, inParamBlock);
 		} else {
 			err= kNMFunctionNotBoundErr;
 		}
@@ -585,7 +588,7 @@ NMErr ProtocolSetEndpointContext(PEndpointRef endpoint, void* newContext)
 /* >>>> Moved ProtocolStart/StopAdvertising() from op_module_mgmt.c */
 void ProtocolStartAdvertising(PEndpointRef endpoint)	/* [Edmark/PBE] 11/8/99 changed parameter from PConfigRef to PEndpointRef */
 {
-	endpoint->NMStartAdvertising(endpoint->module);
+	endpoint->dispatch->NMStartAdvertising(endpoint->module);
 }
 //----------------------------------------------------------------------------------------
 // ProtocolStopAdvertising
@@ -600,7 +603,7 @@ void ProtocolStartAdvertising(PEndpointRef endpoint)	/* [Edmark/PBE] 11/8/99 cha
 
 void ProtocolStopAdvertising(PEndpointRef endpoint)	/* [Edmark/PBE] 11/8/99 changed parameter from PConfigRef to PEndpointRef */
 {
-	endpoint->NMStopAdvertising(endpoint->module);
+	endpoint->dispatch->NMStopAdvertising(endpoint->module);
 }
 
 /** @}*/
@@ -646,10 +649,126 @@ NMErr ProtocolSendPacket(
 	if(endpoint)
 	{
 		op_assert(endpoint->cookie==PENDPOINT_COOKIE);
-		if(endpoint->NMSendDatagram)
+		if(endpoint->dispatch->NMSendDatagram)
+		{
+			op_assert(endpoint->module);
+			err= endpoint->dispatch->NMSendDatagram(endpoint->module, (unsigned char*)inData, inLength, inFlags);
+		} else {
+			err= kNMFunctionNotBoundErr;
+		}
+	} else {
+		err= kNMParameterErr;
+	}
+
+	return err;
+}
+
+//----------------------------------------------------------------------------------------
+// ProtocolSendPacketv
+//----------------------------------------------------------------------------------------
+/**
+	Send a single packet, assembled from several separate pieces of memory, via an endpoint's
+	unreliable(datagram) connection.  The receiver sees one datagram containing the pieces back to back,
+	exactly as if they had been copied into one buffer and passed to \ref ProtocolSendPacket().
+	@brief Send a packet gathered from several buffers via an endpoint's unreliable(datagram) connection.
+	@param endpoint The endpoint to send the data to.
+	@param inVectors Array of \ref NMIOVec structs describing the pieces of the packet, in order.
+	@param inCount Number of entries in \e inVectors.
+	@param inFlags Flags.  None used currently.
+	@return Same as \ref ProtocolSendPacket().
+	\n\n\n\n
+ */
+NMErr ProtocolSendPacketv(
+	PEndpointRef endpoint, 
+	const NMIOVec *inVectors, 
+	NMUInt32 inCount, 
+	NMFlags inFlags)
+{
+	NMErr err= kNMNoError;
+
+	op_assert(valid_endpoint(endpoint));
+	if(endpoint && (inVectors || inCount == 0))
+	{
+		op_assert(endpoint->cookie==PENDPOINT_COOKIE);
+		if(endpoint->dispatch->NMSendDatagramv)
+		{
+			op_assert(endpoint->module);
+			err= endpoint->dispatch->NMSendDatagramv(endpoint->module, inVectors, inCount, inFlags);
+		}
+		else if(endpoint->dispatch->NMSendDatagram)
 		{
+			NMUInt8 *data;
+			NMUInt32 length;
+
+			/* module can't gather; do it for it */
 			op_assert(endpoint->module);
-			err= endpoint->NMSendDatagram(endpoint->module, (unsigned char*)inData, inLength, inFlags);
+			data= gather_vectors(inVectors, inCount, &length);
+			if(data)
+			{
+				err= endpoint->dispatch->NMSendDatagram(endpoint->module, data, length, inFlags);
+				dispose_pointer(data);
+			} else {
+				err= kNMOutOfMemoryErr;
+			}
+		} else {
+			err= kNMFunctionNotBoundErr;
+		}
+	} else {
+		err= kNMParameterErr;
+	}
+
+	return err;
+}
+
+//----------------------------------------------------------------------------------------
+// ProtocolSendPackets
+//----------------------------------------------------------------------------------------
+/**
+	Send several packets at once via an endpoint's unreliable(datagram) connection.  Each entry in \e inPackets
+	is sent as its own datagram, in order, just as if \ref ProtocolSendPacket() had been called for each; NetModules
+	that support it hand the whole batch to the network in one go.
+	@brief Send several packets at once via an endpoint's unreliable(datagram) connection.
+	@param endpoint The endpoint to send the data to.
+	@param inPackets Array of \ref NMIOVec structs, one for each packet.
+	@param inCount Number of entries in \e inPackets.
+	@param outSent Receives the number of packets that were sent.
+	@param inFlags Flags.  None used currently.
+	@return \ref kNMNoError if all the packets were sent.\n
+	\ref kNMFlowErr if flow control stopped the send partway; \e outSent tells how many made it, and
+	the endpoint will be sent a \ref kNMFlowClear message when data can be sent again.\n
+	Otherwise, an error code.
+	\n\n\n\n
+ */
+NMErr ProtocolSendPackets(
+	PEndpointRef endpoint, 
+	const NMIOVec *inPackets, 
+	NMUInt32 inCount, 
+	NMUInt32 *outSent, 
+	NMFlags inFlags)
+{
+	NMErr err= kNMNoError;
+
+	op_assert(valid_endpoint(endpoint));
+	if(endpoint && outSent && (inPackets || inCount == 0))
+	{
+		op_assert(endpoint->cookie==PENDPOINT_COOKIE);
+		*outSent= 0;
+		if(endpoint->dispatch->NMSendDatagrams)
+		{
+			op_assert(endpoint->module);
+			err= endpoint->dispatch->NMSendDatagrams(endpoint->module, inPackets, inCount, outSent, inFlags);
+		}
+		else if(endpoint->dispatch->NMSendDatagram)
+		{
+			/* module can't batch; send them one at a time */
+			op_assert(endpoint->module);
+			while(*outSent<inCount && err==kNMNoError)
+			{
+				err= endpoint->dispatch->NMSendDatagram(endpoint->module, (unsigned char*)inPackets[*outSent].data, 
+					inPackets[*outSent].length, inFlags);
+				if(err==kNMNoError)
+					(*outSent)++;
+			}
 		} else {
 			err= kNMFunctionNotBoundErr;
 		}
@@ -692,10 +811,10 @@ NMErr ProtocolReceivePacket(
 	if(endpoint)
 	{
 		op_assert(endpoint->cookie==PENDPOINT_COOKIE);
-		if(endpoint->NMReceiveDatagram)
+		if(endpoint->dispatch->NMReceiveDatagram)
 		{
 			op_assert(endpoint->module);
-			err= endpoint->NMReceiveDatagram(endpoint->module, (unsigned char*)outData, outLength, outFlags);
+			err= endpoint->dispatch->NMReceiveDatagram(endpoint->module, (unsigned char*)outData, outLength, outFlags);
 		} else {
 			err= kNMFunctionNotBoundErr;
 		}
@@ -736,10 +855,67 @@ NMSInt32 result= 0;
 	if(endpoint)
 	{
 		op_assert(endpoint->cookie==PENDPOINT_COOKIE);
-		if(endpoint->NMSend)
+		if(endpoint->dispatch->NMSend)
 		{
 			op_assert(endpoint->module);
-			result= endpoint->NMSend(endpoint->module, inData, inSize, inFlags);
+			result= endpoint->dispatch->NMSend(endpoint->module, inData, inSize, inFlags);
+		} else {
+			result= kNMFunctionNotBoundErr;
+		}
+	} else {
+		result= kNMParameterErr;
+	}
+	
+	return result; // is < 0 incase of error...
+}
+
+//----------------------------------------------------------------------------------------
+// ProtocolSendv
+//----------------------------------------------------------------------------------------
+/**
+	Send data from several separate pieces of memory via an endpoint's reliable(stream) connection.
+	The pieces go out in order as one run of stream data, without being copied together first when
+	the NetModule supports it.
+	@brief Send data gathered from several buffers via an endpoint's reliable(stream) connection.
+	@param endpoint The endpoint to send the data to.
+	@param inVectors Array of \ref NMIOVec structs describing the data to be sent, in order.
+	@param inCount Number of entries in \e inVectors.
+	@param inFlags Flags.
+	@return Same as \ref ProtocolSend(); a positive result counts bytes across all the pieces.
+	\n\n\n\n
+*/
+NMSInt32 ProtocolSendv(
+	PEndpointRef endpoint, 
+	const NMIOVec *inVectors, 
+	NMUInt32 inCount, 
+	NMFlags inFlags)
+{
+NMSInt32 result= 0;
+
+	op_warn(valid_endpoint(endpoint));
+	if(endpoint && (inVectors || inCount == 0))
+	{
+		op_assert(endpoint->cookie==PENDPOINT_COOKIE);
+		if(endpoint->dispatch->NMSendv)
+		{
+			op_assert(endpoint->module);
+			result= endpoint->dispatch->NMSendv(endpoint->module, inVectors, inCount, inFlags);
+		}
+		else if(endpoint->dispatch->NMSend)
+		{
+			NMUInt8 *data;
+			NMUInt32 length;
+
+			/* module can't gather; do it for it */
+			op_assert(endpoint->module);
+			data= gather_vectors(inVectors, inCount, &length);
+			if(data)
+			{
+				result= endpoint->dispatch->NMSend(endpoint->module, data, length, inFlags);
+				dispose_pointer(data);
+			} else {
+				result= kNMOutOfMemoryErr;
+			}
 		} else {
 			result= kNMFunctionNotBoundErr;
 		}
@@ -778,10 +954,10 @@ NMErr ProtocolReceive(
 	if(endpoint)
 	{
 		op_vassert(endpoint->cookie==PENDPOINT_COOKIE, csprintf(sz_temporary, "Endpoint cookie not right: ep: 0x%x cookie: 0x%x",endpoint, endpoint->cookie));
-		if(endpoint->NMReceive)
+		if(endpoint->dispatch->NMReceive)
 		{
 			op_assert(endpoint->module);
-			err= endpoint->NMReceive(endpoint->module, outData, ioSize, outFlags);
+			err= endpoint->dispatch->NMReceive(endpoint->module, outData, ioSize, outFlags);
 		} else {
 			err= kNMFunctionNotBoundErr;
 		}
@@ -816,13 +992,13 @@ NMErr ProtocolEnterNotifier(
 
 	if(endpoint)
 	{
-		op_vpause("ProtocolEnterNotifier - Checking for endpoint->NMEnterNotifier.");
-		if(endpoint->NMEnterNotifier)
+		op_vpause("ProtocolEnterNotifier - Checking for endpoint->dispatch->NMEnterNotifier.");
+		if(endpoint->dispatch->NMEnterNotifier)
 		{
-			op_vpause("ProtocolEnterNotifier - Calling endpoint->NMEnterNotifier...");
-			err= endpoint->NMEnterNotifier(endpoint->module, endpointMode);
+			op_vpause("ProtocolEnterNotifier - Calling endpoint->dispatch->NMEnterNotifier...");
+			err= endpoint->dispatch->NMEnterNotifier(endpoint->module, endpointMode);
 		} else {
-			op_vpause("ProtocolEnterNotifier - endpoint->NMEnterNotifier not bound.");
+			op_vpause("ProtocolEnterNotifier - endpoint->dispatch->NMEnterNotifier not bound.");
 			err= kNMFunctionNotBoundErr;
 		}
 	} else {
@@ -854,9 +1030,9 @@ NMErr ProtocolLeaveNotifier(
 
 	if(endpoint)
 	{
-		if(endpoint->NMLeaveNotifier)
+		if(endpoint->dispatch->NMLeaveNotifier)
 		{
-			err= endpoint->NMLeaveNotifier(endpoint->module, endpointMode);
+			err= endpoint->dispatch->NMLeaveNotifier(endpoint->module, endpointMode);
 		} else {
 			err= kNMFunctionNotBoundErr;
 		}
@@ -893,9 +1069,9 @@ NMErr ProtocolGetEndpointInfo(
 	op_assert(endpoint->cookie==PENDPOINT_COOKIE);
 	if(endpoint)
 	{
-		if(endpoint->NMGetModuleInfo)
+		if(endpoint->dispatch->NMGetModuleInfo)
 		{
-			err= endpoint->NMGetModuleInfo(info);
+			err= endpoint->dispatch->NMGetModuleInfo(info);
 		} else {
 			err= kNMFunctionNotBoundErr;
 		}
@@ -931,10 +1107,10 @@ NMErr ProtocolFreeEndpointAddress(
 		op_assert(endpoint->cookie==PENDPOINT_COOKIE);
 
 		/* keep a local copy. */
-		if(endpoint->NMFreeAddress)
+		if(endpoint->dispatch->NMFreeAddress)
 		{
 			op_assert(endpoint->module);
-			err= endpoint->NMFreeAddress(endpoint->module, outAddress);
+			err= endpoint->dispatch->NMFreeAddress(endpoint->module, outAddress);
 		} else {
 			err= kNMFunctionNotBoundErr;
 		}
@@ -971,10 +1147,10 @@ NMErr ProtocolGetEndpointAddress(
 		op_assert(endpoint->cookie==PENDPOINT_COOKIE);
 
 		/* keep a local copy. */
-		if(endpoint->NMGetAddress)
+		if(endpoint->dispatch->NMGetAddress)
 		{
 			op_assert(endpoint->module);
-			err= endpoint->NMGetAddress(endpoint->module, addressType, outAddress);
+			err= endpoint->dispatch->NMGetAddress(endpoint->module, addressType, outAddress);
 		} else {
 			err= kNMFunctionNotBoundErr;
 		}
@@ -1002,9 +1178,9 @@ NMErr ProtocolGetEndpointIdentifier (
 	op_assert(endpoint->cookie==PENDPOINT_COOKIE);
 	if(endpoint)
 	{
-		if(endpoint->NMGetIdentifier)
+		if(endpoint->dispatch->NMGetIdentifier)
 		{
-			err= endpoint->NMGetIdentifier(endpoint->module, identifier_string, max_length);
+			err= endpoint->dispatch->NMGetIdentifier(endpoint->module, identifier_string, max_length);
 		} else {
 			err= kNMFunctionNotBoundErr;
 		}
@@ -1020,6 +1196,39 @@ NMErr ProtocolGetEndpointIdentifier (
 //----------------------------------------------------------------------------------------
 
 /* ------------ static code */
+
+/*
+	Copies an NMIOVec array into one new_pointer'd buffer, for modules with no vectored send.
+	Caller disposes of it.
+*/
+static NMUInt8 *gather_vectors(
+	const NMIOVec *inVectors, 
+	NMUInt32 inCount, 
+	NMUInt32 *outLength)
+{
+	NMUInt8 *data;
+	NMUInt32 length= 0;
+	NMUInt32 index;
+
+	for(index= 0; index<inCount; ++index)
+		length+= inVectors[index].length;
+
+	/* new_pointer(0) isn't guaranteed to give us anything back */
+	data= (NMUInt8 *) new_pointer(length ? length : 1);
+	if(data)
+	{
+		NMUInt8 *dest= data;
+
+		for(index= 0; index<inCount; ++index)
+		{
+			machine_move_data(inVectors[index].data, dest, inVectors[index].length);
+			dest+= inVectors[index].length;
+		}
+	}
+	*outLength= length;
+
+	return data;
+}
 static void net_module_callback_function(
 	NMEndpointRef inEndpoint, 
 	void* inContext,
@@ -1083,11 +1292,15 @@ static PEndpointRef create_endpoint_and_bind_to_protocol_library(
 {
 	Endpoint *ep = NULL;
 	
+#ifdef OP_API_NETWORK_SOCKETS
+	ep= get_pooled_endpoint();
+#else
 	ep= (Endpoint *) new_pointer(sizeof(Endpoint));
+#endif
 	if(ep)
 	{
 		machine_mem_zero(ep, sizeof(Endpoint));
-		*err= bind_to_protocol(type, library_file, &ep->connection);
+		*err= bind_to_protocol(type, library_file, &ep->connection, &ep->dispatch);
 		if(!(*err))
 		{
 			/* Load in the endpoint information.. */
@@ -1097,40 +1310,6 @@ static PEndpointRef create_endpoint_and_bind_to_protocol_library(
 			ep->library_file= *library_file;
 			ep->parent= NULL;
 
-			/* Lock and load the pointers.. */
-			ep->NMGetModuleInfo= (NMGetModuleInfoPtr) load_proc(ep->connection, kNMGetModuleInfo);
-
-			ep->NMGetConfig= (NMGetConfigPtr) load_proc(ep->connection, kNMGetConfig);
-			ep->NMGetConfigLen= (NMGetConfigLenPtr) load_proc(ep->connection, kNMGetConfigLen);
-
-			ep->NMOpen= (NMOpenPtr) load_proc(ep->connection, kNMOpen);
-			ep->NMClose= (NMClosePtr) load_proc(ep->connection, kNMClose);
-
-			ep->NMAcceptConnection= (NMAcceptConnectionPtr) load_proc(ep->connection, kNMAcceptConnection);
-			ep->NMRejectConnection= (NMRejectConnectionPtr) load_proc(ep->connection, kNMRejectConnection);
-
-			ep->NMSendDatagram= (NMSendDatagramPtr) load_proc(ep->connection, kNMSendDatagram);
-			ep->NMReceiveDatagram= (NMReceiveDatagramPtr) load_proc(ep->connection, kNMReceiveDatagram);
-
-			ep->NMSend= (NMSendPtr) load_proc(ep->connection, kNMSend);
-			ep->NMReceive= (NMReceivePtr) load_proc(ep->connection, kNMReceive);
-
-			ep->NMSetTimeout= (NMSetTimeoutPtr) load_proc(ep->connection, kNMSetTimeout);
-			ep->NMIsAlive= (NMIsAlivePtr) load_proc(ep->connection, kNMIsAlive);
-			ep->NMFreeAddress= (NMFreeAddressPtr) load_proc(ep->connection, kNMFreeAddress);
-			ep->NMGetAddress= (NMGetAddressPtr) load_proc(ep->connection, kNMGetAddress);
-			ep->NMFunctionPassThrough= (NMFunctionPassThroughPtr) load_proc(ep->connection, kNMFunctionPassThrough);
-
-			ep->NMIdle= (NMIdlePtr) load_proc(ep->connection, kNMIdle);
-
-			ep->NMStopAdvertising  = (NMStopAdvertisingPtr)  load_proc(ep->connection, kNMStopAdvertising);
-			ep->NMStartAdvertising = (NMStartAdvertisingPtr) load_proc(ep->connection, kNMStartAdvertising);
-
-			ep->NMEnterNotifier  = (NMEnterNotifierPtr)  load_proc(ep->connection, kNMEnterNotifier);
-			ep->NMLeaveNotifier  = (NMLeaveNotifierPtr)  load_proc(ep->connection, kNMLeaveNotifier);
-
-			ep->NMGetIdentifier = (NMGetIdentifierPtr) load_proc(ep->connection, kNMGetIdentifier);
-
 			/* [Edmark/PBE] 11/8/99 moved NMStart/StopAdvertising from ProtocolConfig to Endpoint */
 
 			ep->next= NULL;
@@ -1142,7 +1321,11 @@ static PEndpointRef create_endpoint_and_bind_to_protocol_library(
 		if(*err)
 		{
 			/* clear! */
+#ifdef OP_API_NETWORK_SOCKETS
+			release_pooled_endpoint(ep);
+#else
 			dispose_pointer(ep);
+#endif
 			ep= NULL;
 		}
 	} else {
@@ -1176,7 +1359,7 @@ static Endpoint *create_endpoint_for_accept(
 
 	if(new_endpoint) 
 	{
-		*err= bind_to_protocol(endpoint->type, &endpoint->library_file, &new_endpoint->connection);
+		*err= bind_to_protocol(endpoint->type, &endpoint->library_file, &new_endpoint->connection, &new_endpoint->dispatch);
 		if(!(*err))
 		{
 			/* Load in the endpoint information.. */
@@ -1186,32 +1369,6 @@ static Endpoint *create_endpoint_for_accept(
 			new_endpoint->parent= NULL;
 
 			new_endpoint->library_file= endpoint->library_file;
-			new_endpoint->NMGetModuleInfo= endpoint->NMGetModuleInfo;
-			new_endpoint->NMGetConfig= endpoint->NMGetConfig;
-			new_endpoint->NMGetConfigLen= endpoint->NMGetConfigLen;
-			new_endpoint->NMOpen= endpoint->NMOpen;
-			new_endpoint->NMClose= endpoint->NMClose;
-			new_endpoint->NMAcceptConnection= endpoint->NMAcceptConnection;
-			new_endpoint->NMRejectConnection= endpoint->NMRejectConnection;
-			new_endpoint->NMSendDatagram= endpoint->NMSendDatagram;
-			new_endpoint->NMReceiveDatagram= endpoint->NMReceiveDatagram;
-			new_endpoint->NMSend= endpoint->NMSend;
-			new_endpoint->NMReceive= endpoint->NMReceive;
-			new_endpoint->NMSetTimeout= endpoint->NMSetTimeout;
-			new_endpoint->NMIsAlive= endpoint->NMIsAlive;
-			new_endpoint->NMFreeAddress= endpoint->NMFreeAddress;
-			new_endpoint->NMGetAddress= endpoint->NMGetAddress;
-			new_endpoint->NMFunctionPassThrough= endpoint->NMFunctionPassThrough;
-			new_endpoint->NMIdle= endpoint->NMIdle;
-
-			new_endpoint->NMStopAdvertising  = endpoint->NMStopAdvertising;
-			new_endpoint->NMStartAdvertising = endpoint->NMStartAdvertising;
-
-			new_endpoint->NMEnterNotifier  = endpoint->NMEnterNotifier;
-			new_endpoint->NMLeaveNotifier  = endpoint->NMLeaveNotifier;
-			
-			new_endpoint->NMGetIdentifier = endpoint->NMGetIdentifier;
-
 			new_endpoint->next= NULL;
 
 			add_endpoint_to_loaded_list(new_endpoint);
@@ -1228,11 +1385,12 @@ static Endpoint *create_endpoint_for_accept(
 		*err= kNMOutOfMemoryErr;
 	}
 #elif defined(OP_API_NETWORK_SOCKETS)
-	new_endpoint = (Endpoint*)new_pointer(sizeof(Endpoint));
+	new_endpoint = get_pooled_endpoint();
+	*from_cache= true;
 
 	if(new_endpoint) 
 	{
-		*err= bind_to_protocol(endpoint->type, &endpoint->library_file, &new_endpoint->connection);
+		*err= bind_to_protocol(endpoint->type, &endpoint->library_file, &new_endpoint->connection, &new_endpoint->dispatch);
 		if(!(*err))
 		{
 			/* Load in the endpoint information.. */
@@ -1242,32 +1400,6 @@ static Endpoint *create_endpoint_for_accept(
 			new_endpoint->parent= NULL;
 
 			new_endpoint->library_file= endpoint->library_file;
-			new_endpoint->NMGetModuleInfo= endpoint->NMGetModuleInfo;
-			new_endpoint->NMGetConfig= endpoint->NMGetConfig;
-			new_endpoint->NMGetConfigLen= endpoint->NMGetConfigLen;
-			new_endpoint->NMOpen= endpoint->NMOpen;
-			new_endpoint->NMClose= endpoint->NMClose;
-			new_endpoint->NMAcceptConnection= endpoint->NMAcceptConnection;
-			new_endpoint->NMRejectConnection= endpoint->NMRejectConnection;
-			new_endpoint->NMSendDatagram= endpoint->NMSendDatagram;
-			new_endpoint->NMReceiveDatagram= endpoint->NMReceiveDatagram;
-			new_endpoint->NMSend= endpoint->NMSend;
-			new_endpoint->NMReceive= endpoint->NMReceive;
-			new_endpoint->NMSetTimeout= endpoint->NMSetTimeout;
-			new_endpoint->NMIsAlive= endpoint->NMIsAlive;
-			new_endpoint->NMFreeAddress= endpoint->NMFreeAddress;
-			new_endpoint->NMGetAddress= endpoint->NMGetAddress;
-			new_endpoint->NMFunctionPassThrough= endpoint->NMFunctionPassThrough;
-			new_endpoint->NMIdle= endpoint->NMIdle;
-
-			new_endpoint->NMStopAdvertising  = endpoint->NMStopAdvertising;
-			new_endpoint->NMStartAdvertising = endpoint->NMStartAdvertising;
-
-			new_endpoint->NMEnterNotifier  = endpoint->NMEnterNotifier;
-			new_endpoint->NMLeaveNotifier  = endpoint->NMLeaveNotifier;
-
-			new_endpoint->NMGetIdentifier = endpoint->NMGetIdentifier;
-
 			new_endpoint->next= NULL;
 
 			add_endpoint_to_loaded_list(new_endpoint);
@@ -1276,6 +1408,7 @@ static Endpoint *create_endpoint_for_accept(
 		{
 			DEBUG_PRINT("Err %d binding to protocol", *err);
 
+			release_pooled_endpoint(new_endpoint);
 			new_endpoint= NULL;
 		}
 	} else {
@@ -37,6 +37,16 @@ void initialize_openplay(FileDesc *file);
 	#define MAXIMUM_CACHED_ENDPOINTS (8)
 	#define MAXIMUM_DOOMED_ENDPOINTS (8)
 
+	/* with sockets, closed endpoints are pooled for reuse instead (they can be freed whenever). */
+	/* this many are kept ready - the environment variable overrides it - and up to the maximum are kept */
+	#define kEndpointPoolSizeVariable "OPENPLAY_ENDPOINT_POOL"
+	#define DEFAULT_ENDPOINT_POOL_SIZE (16)
+	#define MAXIMUM_ENDPOINT_POOL_SIZE (256)
+
+	/* buckets in the registry of live endpoints (see valid_endpoint); must be a power of two. */
+	/* it's never resized, since endpoints come and go at interrupt time on some platforms */
+	#define ENDPOINT_REGISTRY_SIZE (1024)
+
 //	------------------------------	Public Types
 
 	struct module_data {
@@ -52,6 +62,7 @@ void initialize_openplay(FileDesc *file);
 		NMSInt32    			connection_binded_count;
 		NMSInt32    			endpoints_instantiated;
 		Endpoint *				first_loaded_endpoint;
+		endpoint_dispatch		dispatch; /* shared by all of the above; never changes once bound */
 		loaded_modules_data *	next;
 	};
 	typedef struct loaded_modules_data	loaded_modules_data;
@@ -65,6 +76,9 @@ void initialize_openplay(FileDesc *file);
 		FileDesc				file_spec;
 		loaded_modules_data *	loaded_modules;
 
+		/* every endpoint on a loaded module's list, hashed by address */
+		Endpoint *				endpoint_registry[ENDPOINT_REGISTRY_SIZE];
+
 		NMSInt16				res_refnum;
 	#if OP_PLATFORM_MAC_MACHO
 		CFBundleRef				selfBundleRef;
@@ -84,6 +98,12 @@ void initialize_openplay(FileDesc *file);
 
 	#elif defined(OP_API_NETWORK_SOCKETS)
 
+		Endpoint *				endpoint_pool;		/* oldest first, linked through next */
+		Endpoint *				endpoint_pool_tail;
+		NMSInt32 				endpoint_pool_size;
+		NMSInt32 				endpoint_pool_target;	/* how many op_idle_synchronous keeps there */
+		NMBoolean				endpoint_pool_configured;	/* target read from the environment yet? (it may well be 0) */
+
 	#else
 		#error "Porting problem - check op_globals structure"
 	#endif
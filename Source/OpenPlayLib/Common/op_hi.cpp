@@ -244,6 +244,8 @@ void ProtocolGetRequiredDialogFrame(
 	@param inActive Active enumeration searches the network for games.  Passive only uses stored addresses, etc.
 	@return \ref kNMNoError if the function succeeds.\n
 	Otherwise, an error code.
+	@note With "IPbgenum=true" in a TCP/IP config string, the NetModule searches on its own thread and the callback
+	is called from there, with no need for \ref ProtocolIdleEnumeration().
 	\n\n\n\n
  */
 
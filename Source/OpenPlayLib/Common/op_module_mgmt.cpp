@@ -53,6 +53,30 @@
     #define MAX_STRINGS_PER_GROUP 128 /* must match that in build_rc.c */
 #endif
 
+#if defined(OP_API_PLUGIN_POSIX) || defined(OP_API_PLUGIN_POSIX_DARWIN)
+	#include <sys/stat.h>
+	#include <stdio.h>
+	#include <stdlib.h>
+	#include <string.h>
+	#include <time.h>
+	#include <unistd.h>
+
+	/* we remember what each netmodule told us, keyed by its path, modification time and size, so a
+	   refresh only has to load the ones that have changed.  set this environment variable to the
+	   name of a file to keep the catalogue on disk as well, so a new process needn't load any. */
+	#define kModuleIndexVariable "OPENPLAY_MODULE_INDEX"
+	#define MODULE_INDEX_HEADER "OpenPlay module index 1"
+
+	struct module_catalogue_entry {
+		char path[PATH_MAX];
+		long mtime;
+		long size;
+		NMType type;
+		char name[kNMNameLength];
+	};
+	typedef struct module_catalogue_entry module_catalogue_entry;
+#endif
+
 /* -------- local prototypes */
 
 #ifdef OP_API_PLUGIN_MACHO
@@ -67,6 +91,19 @@
 	static NMBoolean haveRefreshedProtocols = false;
 #endif //OP_API_PLUGIN_MAC_CFM
 
+#if defined(OP_API_PLUGIN_POSIX) || defined(OP_API_PLUGIN_POSIX_DARWIN)
+	/* the catalogue as of the last search (or as read from the index), and the one the current search is building */
+	static module_catalogue_entry *module_catalogue = NULL;
+	static NMSInt32 module_catalogue_count = 0;
+	static module_catalogue_entry *next_module_catalogue = NULL;
+	static NMSInt32 next_module_catalogue_count = 0;
+
+	/* the directory it describes, and that directory's modification time (-1 if we can't trust it) */
+	static char module_catalogue_directory[PATH_MAX] = "";
+	static long module_catalogue_directory_mtime = -1;
+	static NMBoolean module_index_read = false;
+#endif
+
 /* -------- Protocol Management Layer */
 
 
@@ -192,7 +229,7 @@ NMErr ProtocolCreateConfig(
 		{
 			if(type==gOp_globals.modules[index].module.type)
 			{
-				err= bind_to_protocol(type, &gOp_globals.modules[index].module_spec, &config->connection);
+				err= bind_to_protocol(type, &gOp_globals.modules[index].module_spec, &config->connection, NULL);
 				config->file= gOp_globals.modules[index].module_spec;
 				break;
 			}
@@ -658,6 +695,328 @@ static NMBoolean get_module_name_and_type(
   return valid;
 }
 
+//----------------------------------------------------------------------------------------
+// add_protocol_module
+//----------------------------------------------------------------------------------------
+
+static void add_protocol_module(
+	module_data *new_module)
+{
+  module_data *old_module_list= gOp_globals.modules;
+
+  gOp_globals.modules= (module_data *) new_pointer((gOp_globals.module_count+1)*sizeof(module_data));
+  if(gOp_globals.modules)
+  {
+      if(old_module_list)
+      {
+		  machine_copy_data(old_module_list, gOp_globals.modules, gOp_globals.module_count*sizeof(module_data));
+		  dispose_pointer(old_module_list);
+      }
+      machine_copy_data(new_module, &gOp_globals.modules[gOp_globals.module_count], sizeof(module_data));
+      gOp_globals.module_count++;
+  }
+}
+
+#if defined(OP_API_PLUGIN_POSIX) || defined(OP_API_PLUGIN_POSIX_DARWIN)
+
+//----------------------------------------------------------------------------------------
+// get_catalogued_module_name_and_type
+//----------------------------------------------------------------------------------------
+
+/* like get_module_name_and_type, but only loads the module if the catalogue doesn't already
+   know it in its present form.  either way, it goes into the catalogue being built. */
+static NMBoolean get_catalogued_module_name_and_type(
+	FileDesc *file,
+	NMType *type,
+	char *name)
+{
+  struct stat info;
+  module_catalogue_entry *entry;
+  NMSInt32 index;
+  NMBoolean valid= false;
+
+  if(stat(file->name, &info) != 0)
+    return false;
+
+  for(index= 0; index<module_catalogue_count; index++)
+  {
+    entry= &module_catalogue[index];
+    if(entry->mtime==(long) info.st_mtime && entry->size==(long) info.st_size && strcmp(entry->path, file->name)==0)
+    {
+      *type= entry->type;
+      strcpy(name, entry->name);
+      valid= true;
+      break;
+    }
+  }
+
+  if(!valid)
+    valid= get_module_name_and_type(file, type, name);
+
+  if(valid)
+  {
+    module_catalogue_entry *old_catalogue= next_module_catalogue;
+
+    next_module_catalogue= (module_catalogue_entry *) new_pointer((next_module_catalogue_count+1)*sizeof(module_catalogue_entry));
+    if(next_module_catalogue)
+    {
+      if(old_catalogue)
+      {
+        machine_copy_data(old_catalogue, next_module_catalogue, next_module_catalogue_count*sizeof(module_catalogue_entry));
+        dispose_pointer(old_catalogue);
+      }
+      entry= &next_module_catalogue[next_module_catalogue_count++];
+      machine_mem_zero(entry, sizeof(module_catalogue_entry));
+      strcpy(entry->path, file->name);
+      entry->mtime= (long) info.st_mtime;
+      entry->size= (long) info.st_size;
+      entry->type= *type;
+      strncpy(entry->name, name, kNMNameLength-1);
+    } else {
+      next_module_catalogue= old_catalogue;
+    }
+  }
+
+  return valid;
+}
+
+//----------------------------------------------------------------------------------------
+// module_path_is_in_directory
+//----------------------------------------------------------------------------------------
+
+/* true if path names a module directly inside directory, the way valid_protocol_file builds them -
+   the index is just a file another process wrote, so nothing it names gets loaded otherwise */
+static NMBoolean module_path_is_in_directory(
+	const char *path,
+	const char *directory)
+{
+  size_t dirlen= strlen(directory);
+  const char *file_name;
+
+  if(dirlen==0 || strncmp(path, directory, dirlen)!=0)
+    return false;
+
+  file_name= path+dirlen;
+  if(directory[dirlen-1]!='/' && *file_name++!='/')
+    return false;
+
+  return *file_name && strchr(file_name, '/')==NULL && strcmp(file_name, ".")!=0 && strcmp(file_name, "..")!=0;
+}
+
+//----------------------------------------------------------------------------------------
+// module_catalogue_is_current
+//----------------------------------------------------------------------------------------
+
+/* true if the catalogue still describes the module directory - ie nothing has been added, removed
+   or renamed there (which would change its modification time), and no module has been rewritten */
+static NMBoolean module_catalogue_is_current(
+	const char *directory)
+{
+  struct stat info;
+  NMSInt32 index;
+
+  if(module_catalogue_directory_mtime==-1 || strcmp(directory, module_catalogue_directory)!=0)
+    return false;
+
+  if(stat(directory, &info)!=0 || (long) info.st_mtime!=module_catalogue_directory_mtime)
+    return false;
+
+  for(index= 0; index<module_catalogue_count; index++)
+  {
+    module_catalogue_entry *entry= &module_catalogue[index];
+
+    if(!module_path_is_in_directory(entry->path, directory))
+      return false;
+
+    if(stat(entry->path, &info)!=0 || (long) info.st_mtime!=entry->mtime || (long) info.st_size!=entry->size)
+      return false;
+  }
+
+  return true;
+}
+
+//----------------------------------------------------------------------------------------
+// note_module_catalogue_directory
+//----------------------------------------------------------------------------------------
+
+/* called once a search of the directory has filled the catalogue */
+static void note_module_catalogue_directory(
+	const char *directory)
+{
+  struct stat info;
+
+  strcpy(module_catalogue_directory, directory);
+  module_catalogue_directory_mtime= -1;
+
+  /* (if it changed within the second, something else may yet change it within the same second) */
+  if(stat(directory, &info)==0 && info.st_mtime<time(NULL))
+    module_catalogue_directory_mtime= (long) info.st_mtime;
+}
+
+//----------------------------------------------------------------------------------------
+// read_module_index
+//----------------------------------------------------------------------------------------
+
+/* each line after the header is "mtime size type path name", separated by tabs */
+static void read_module_index(
+	void)
+{
+  char *index_name= getenv(kModuleIndexVariable);
+  char line[PATH_MAX+128];
+  FILE *index_file;
+  NMBoolean ok;
+
+  if(!index_name)
+    return;
+
+  index_file= fopen(index_name, "r");
+  if(!index_file)
+    return;
+
+  ok= (fgets(line, sizeof(line), index_file) != NULL) && (strncmp(line, MODULE_INDEX_HEADER, strlen(MODULE_INDEX_HEADER))==0);
+
+  /* the directory it describes */
+  if(ok && fgets(line, sizeof(line), index_file))
+  {
+    char *path= strchr(line, '\t');
+
+    ok= (path != NULL);
+    if(ok)
+    {
+      path[strcspn(path, "\n")]= 0;
+      module_catalogue_directory_mtime= strtol(line, NULL, 10);
+      strncpy(module_catalogue_directory, path+1, PATH_MAX-1);
+    }
+  }
+
+  while(ok && fgets(line, sizeof(line), index_file))
+  {
+    module_catalogue_entry entry;
+    char *field[4];
+    NMSInt32 index;
+
+    line[strcspn(line, "\n")]= 0;
+    field[0]= line;
+    for(index= 1; ok && index<4; index++)
+    {
+      field[index]= strchr(field[index-1], '\t');
+      if(field[index]) *field[index]++= 0;
+      ok= (field[index] != NULL);
+    }
+
+    /* (the name is whatever's left after the path) */
+    if(ok)
+    {
+      char *name= strchr(field[3], '\t');
+
+      ok= (name != NULL);
+      if(ok)
+      {
+        *name++= 0;
+        machine_mem_zero(&entry, sizeof(entry));
+        entry.mtime= strtol(line, NULL, 10);
+        entry.size= strtol(field[1], NULL, 10);
+        entry.type= (NMType) strtoul(field[2], NULL, 10);
+        strncpy(entry.path, field[3], PATH_MAX-1);
+        strncpy(entry.name, name, kNMNameLength-1);
+      }
+    }
+
+    if(ok)
+    {
+      module_catalogue_entry *old_catalogue= module_catalogue;
+
+      module_catalogue= (module_catalogue_entry *) new_pointer((module_catalogue_count+1)*sizeof(module_catalogue_entry));
+      if(module_catalogue)
+      {
+        if(old_catalogue)
+        {
+          machine_copy_data(old_catalogue, module_catalogue, module_catalogue_count*sizeof(module_catalogue_entry));
+          dispose_pointer(old_catalogue);
+        }
+        machine_copy_data(&entry, &module_catalogue[module_catalogue_count++], sizeof(entry));
+      } else {
+        module_catalogue= old_catalogue;
+        ok= false;
+      }
+    }
+  }
+
+  /* a damaged index is as good as none - we'll just search as usual */
+  if(!ok)
+    module_catalogue_directory_mtime= -1;
+
+  fclose(index_file);
+}
+
+//----------------------------------------------------------------------------------------
+// write_module_index
+//----------------------------------------------------------------------------------------
+
+static void write_module_index(
+	void)
+{
+  char *index_name= getenv(kModuleIndexVariable);
+  char temporary_name[PATH_MAX+8];
+  FILE *index_file;
+  NMSInt32 index;
+  NMBoolean ok;
+  int length;
+
+  if(!index_name)
+    return;
+
+  /* written alongside and renamed over, so another process never reads half of one
+     (and if the name won't fit, we just don't keep an index) */
+  length= snprintf(temporary_name, sizeof(temporary_name), "%s.%ld", index_name, (long) getpid());
+  if(length<0 || (size_t) length>=sizeof(temporary_name))
+    return;
+
+  index_file= fopen(temporary_name, "w");
+  if(!index_file)
+    return;
+
+  ok= fprintf(index_file, "%s\n%ld\t%s\n", MODULE_INDEX_HEADER, module_catalogue_directory_mtime, module_catalogue_directory) > 0;
+  for(index= 0; ok && index<module_catalogue_count; index++)
+  {
+    module_catalogue_entry *entry= &module_catalogue[index];
+
+    ok= fprintf(index_file, "%ld\t%ld\t%lu\t%s\t%s\n", entry->mtime, entry->size, (unsigned long) entry->type, entry->path, entry->name) > 0;
+  }
+
+  if(fclose(index_file)!=0)
+    ok= false;
+
+  if(!ok || rename(temporary_name, index_name)!=0)
+    remove(temporary_name);
+}
+
+//----------------------------------------------------------------------------------------
+// add_catalogued_protocols
+//----------------------------------------------------------------------------------------
+
+/* fills in the module list straight from the catalogue, without searching */
+static void add_catalogued_protocols(
+	void)
+{
+  NMSInt32 index;
+
+  for(index= 0; index<module_catalogue_count; index++)
+  {
+    module_data new_module;
+
+    machine_mem_zero(&new_module, sizeof(new_module));
+    strcpy(new_module.module_spec.name, module_catalogue[index].path);
+    new_module.module.version= CURRENT_OPENPLAY_VERSION;
+    new_module.module.type= module_catalogue[index].type;
+    strcpy(new_module.module.name, module_catalogue[index].name);
+
+    add_protocol_module(&new_module);
+  }
+}
+
+#endif
+
 //----------------------------------------------------------------------------------------
 // find_protocol_callback
 //----------------------------------------------------------------------------------------
@@ -681,22 +1040,14 @@ static NMBoolean find_protocol_callback(
       
       new_module.module.version= CURRENT_OPENPLAY_VERSION;
 
-      /* Get the type and the name from the fragment. */
+      /* Get the type and the name from the fragment (or from what it told us last time). */
+#if defined(OP_API_PLUGIN_POSIX) || defined(OP_API_PLUGIN_POSIX_DARWIN)
+      if(get_catalogued_module_name_and_type(file, &new_module.module.type, new_module.module.name))
+#else
       if(get_module_name_and_type(file, &new_module.module.type, new_module.module.name))
+#endif
       {
-		  module_data *old_module_list= gOp_globals.modules;
-
-		  gOp_globals.modules= (module_data *) new_pointer((gOp_globals.module_count+1)*sizeof(module_data));
-		  if(gOp_globals.modules)
-		  {
-		      if(old_module_list)
-		      {
-				  machine_copy_data(old_module_list, gOp_globals.modules, gOp_globals.module_count*sizeof(module_data));
-				  dispose_pointer(old_module_list);
-		      }
-		      machine_copy_data(&new_module, &gOp_globals.modules[gOp_globals.module_count], sizeof(module_data));
-		      gOp_globals.module_count++;
-		  }
+		  add_protocol_module(&new_module);
       }
   }
   return true;
@@ -730,6 +1081,18 @@ static void find_protocols(
 
 	build_find_protocol_search_start(&pb.start_search_from);
 
+#if defined(OP_API_PLUGIN_POSIX) || defined(OP_API_PLUGIN_POSIX_DARWIN)
+	/* nothing's changed since we last looked - the catalogue can fill in the list without touching a module */
+	if(module_catalogue_is_current(pb.start_search_from.name))
+	{
+		add_catalogued_protocols();
+		return;
+	}
+
+	next_module_catalogue= NULL;
+	next_module_catalogue_count= 0;
+#endif
+
    pb.type_to_find = d_LIBRARY_TYPE;
 	pb.buffer = NULL;
 	pb.max = MAXIMUM_NETMODULES;
@@ -738,6 +1101,19 @@ static void find_protocols(
 	pb.user_data = NULL;
 	
 	err = find_files(&pb);
+
+#if defined(OP_API_PLUGIN_POSIX) || defined(OP_API_PLUGIN_POSIX_DARWIN)
+	/* what we found becomes the catalogue */
+	if(module_catalogue)
+		dispose_pointer(module_catalogue);
+	module_catalogue= next_module_catalogue;
+	module_catalogue_count= next_module_catalogue_count;
+	next_module_catalogue= NULL;
+	next_module_catalogue_count= 0;
+
+	note_module_catalogue_directory(pb.start_search_from.name);
+	write_module_index();
+#endif
 }
 
 //----------------------------------------------------------------------------------------
@@ -752,6 +1128,15 @@ void refresh_protocols(
            machine_tick_count()-gOp_globals.ticks_at_last_protocol_search>30*MACHINE_TICKS_PER_SECOND) 
  */
 	{
+#if defined(OP_API_PLUGIN_POSIX) || defined(OP_API_PLUGIN_POSIX_DARWIN)
+		/* the first time through, start from whatever a previous process left us */
+		if(!module_index_read)
+		{
+			module_index_read= true;
+			read_module_index();
+		}
+#endif
+
 		/* find the protocols. */
 		find_protocols();
 		
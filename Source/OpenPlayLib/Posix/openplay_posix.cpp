@@ -30,8 +30,14 @@
 #include "op_globals.h"
 #include "module_management.h"
 
+#include <stdlib.h>
+#include <pthread.h>
+
 static void release_openplay(void);
 
+/* endpoints are returned to the pool from netmodule threads, so it has its own lock */
+static pthread_mutex_t endpoint_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
 extern "C"{
 
 /* _init is called when the library is loaded */
@@ -100,6 +106,19 @@ static void release_openplay(
 	/* Remove all the modules with zero counts (which should be all of them) */
 	module_management_idle_time();
 	
+	/* Free the endpoint pool */
+	pthread_mutex_lock(&endpoint_pool_lock);
+	while(gOp_globals.endpoint_pool)
+	{
+		Endpoint *pooled_endpoint = gOp_globals.endpoint_pool;
+
+		gOp_globals.endpoint_pool = pooled_endpoint->next;
+		dispose_pointer(pooled_endpoint);
+	}
+	gOp_globals.endpoint_pool_tail = NULL;
+	gOp_globals.endpoint_pool_size = 0;
+	pthread_mutex_unlock(&endpoint_pool_lock);
+
 	/* Free the available modules list */
 	if(gOp_globals.module_count)
 	{
@@ -111,8 +130,90 @@ static void release_openplay(
 	return;
 }
 
+//----------------------------------------------------------------------------------------
+// get_pooled_endpoint
+//----------------------------------------------------------------------------------------
+
+/* returns a zeroed endpoint, from the pool if possible */
+Endpoint *get_pooled_endpoint(
+	void)
+{
+	Endpoint *endpoint;
+
+	pthread_mutex_lock(&endpoint_pool_lock);
+	endpoint = gOp_globals.endpoint_pool;
+	if(endpoint)
+	{
+		gOp_globals.endpoint_pool = endpoint->next;
+		if(!gOp_globals.endpoint_pool)
+			gOp_globals.endpoint_pool_tail = NULL;
+		gOp_globals.endpoint_pool_size--;
+	}
+	pthread_mutex_unlock(&endpoint_pool_lock);
+
+	if(!endpoint)
+		endpoint = (Endpoint *) new_pointer(sizeof(Endpoint));
+
+	if(endpoint)
+		machine_mem_zero(endpoint, sizeof(Endpoint));
+
+	return endpoint;
+}
+
+//----------------------------------------------------------------------------------------
+// release_pooled_endpoint
+//----------------------------------------------------------------------------------------
+
+/* puts it at the back of the pool, so its address is reused as late as possible; frees it if the pool is full */
+void release_pooled_endpoint(
+	Endpoint *endpoint)
+{
+	pthread_mutex_lock(&endpoint_pool_lock);
+	if(gOp_globals.endpoint_pool_size < MAXIMUM_ENDPOINT_POOL_SIZE)
+	{
+		endpoint->next = NULL;
+		if(gOp_globals.endpoint_pool_tail)
+			gOp_globals.endpoint_pool_tail->next = endpoint;
+		else
+			gOp_globals.endpoint_pool = endpoint;
+		gOp_globals.endpoint_pool_tail = endpoint;
+		gOp_globals.endpoint_pool_size++;
+		endpoint = NULL;
+	}
+	pthread_mutex_unlock(&endpoint_pool_lock);
+
+	if(endpoint)
+		dispose_pointer(endpoint);
+}
+
 /* call this whenever you can (synchronously) */
 void op_idle_synchronous(void)
-{	
-	return;
+{
+	char *env_ptr;
+
+	/* first time through, see how many endpoints we should keep ready */
+	if(!gOp_globals.endpoint_pool_configured)
+	{
+		gOp_globals.endpoint_pool_configured = true;
+		gOp_globals.endpoint_pool_target = DEFAULT_ENDPOINT_POOL_SIZE;
+		env_ptr = getenv(kEndpointPoolSizeVariable);
+		if(env_ptr)
+		{
+			gOp_globals.endpoint_pool_target = atol(env_ptr);
+			if(gOp_globals.endpoint_pool_target < 0)
+				gOp_globals.endpoint_pool_target = 0;
+			if(gOp_globals.endpoint_pool_target > MAXIMUM_ENDPOINT_POOL_SIZE)
+				gOp_globals.endpoint_pool_target = MAXIMUM_ENDPOINT_POOL_SIZE;
+		}
+	}
+
+	/* top up the pool, so accepts during a burst of joiners needn't allocate */
+	while(gOp_globals.endpoint_pool_size < gOp_globals.endpoint_pool_target)
+	{
+		Endpoint *endpoint = (Endpoint *) new_pointer(sizeof(Endpoint));
+
+		if(!endpoint)
+			break; /* silently bail. */
+		release_pooled_endpoint(endpoint);
+	}
 }
@@ -56,10 +56,13 @@ static void release_openplay(void);
 	#pragma aux ProtocolIdle export
 	#pragma aux ProtocolFunctionPassThrough export
 	#pragma aux ProtocolSendPacket export
+	#pragma aux ProtocolSendPacketv export
+	#pragma aux ProtocolSendPackets export
 	#pragma aux ProtocolReceivePacket export
 	#pragma aux ProtocolAcceptConnection export
 	#pragma aux ProtocolRejectConnection export
 	#pragma aux ProtocolSend export
+	#pragma aux ProtocolSendv export
 	#pragma aux ProtocolReceive export
 	#pragma aux ProtocolGetEndpointInfo export
 	#pragma aux ValidateCrossPlatformPacket export
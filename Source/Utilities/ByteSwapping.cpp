@@ -108,6 +108,15 @@ void SwapSystemMessageContent(NSpMessageHeader *inMessage)
 		case kNSpPlayerTypeChanged:
 			SwapPlayerTypeChanged(inMessage);
 			break;
+
+		case kRTTPing:
+			SwapRTTPing(inMessage);
+			break;
+
+		case kThruputPing:
+		case kThruputPingReply:
+			SwapThruput(inMessage);
+			break;
 	}
 }
 
@@ -357,3 +366,44 @@ void	SwapPlayerTypeChanged(NSpMessageHeader *inMessage)	// DONE
 #endif	// big_endian == false
 }
 
+//----------------------------------------------------------------------------------------
+// SwapRTTPing
+//----------------------------------------------------------------------------------------
+
+void	SwapRTTPing(NSpMessageHeader *inMessage)
+{
+#if !big_endian
+
+	TRTTPingMessage *pingPtr;
+	
+	pingPtr = (TRTTPingMessage *) inMessage;
+	
+	pingPtr->flags = SWAP4(pingPtr->flags);
+	pingPtr->stamp = SWAP4(pingPtr->stamp);
+	pingPtr->echoStamp = SWAP4(pingPtr->echoStamp);
+	pingPtr->echoDelay = SWAP4(pingPtr->echoDelay);
+	pingPtr->bytesReceived = SWAP4(pingPtr->bytesReceived);
+
+#else
+	#pragma unused (inMessage)
+#endif	// big_endian == false
+}
+
+//----------------------------------------------------------------------------------------
+// SwapThruput
+//----------------------------------------------------------------------------------------
+
+void	SwapThruput(NSpMessageHeader *inMessage)
+{
+#if !big_endian
+
+	TThruputMessage *thruputPtr;
+	
+	thruputPtr = (TThruputMessage *) inMessage;
+	
+	thruputPtr->count = SWAP4(thruputPtr->count);
+
+#else
+	#pragma unused (inMessage)
+#endif	// big_endian == false
+}
@@ -49,6 +49,8 @@
 	void		SwapCreateGroup(NSpMessageHeader *inMessage);
 	void		SwapAddPlayerToGroup(NSpMessageHeader *inMessage);
 	void		SwapPlayerTypeChanged(NSpMessageHeader *inMessage);
+	void		SwapRTTPing(NSpMessageHeader *inMessage);
+	void		SwapThruput(NSpMessageHeader *inMessage);
 
 #endif	// __BYTESWAPPING__
 
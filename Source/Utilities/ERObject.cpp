@@ -38,6 +38,7 @@ ERObject::ERObject()
 	mMaxMessageLen = 0;
 	mTimeReceived = 0;
 	mEndpoint = NULL;
+	mRefCount = 0;
 }
 
 //----------------------------------------------------------------------------------------
@@ -49,6 +50,7 @@ ERObject::ERObject(NSpMessageHeader *inMessage, NMUInt32 inMaxLen)
 	mMessage = inMessage;
 	mMaxMessageLen = inMaxLen;
 	mEndpoint = NULL;
+	mRefCount = 0;
 }
 
 //----------------------------------------------------------------------------------------
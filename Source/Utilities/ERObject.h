@@ -69,6 +69,11 @@
 		inline	NMUInt32			GetMaxMessageLen() {return mMaxMessageLen;}
 		inline	NMUInt32			GetTimeReceived() {return mTimeReceived;}
 		inline	void				*GetCookie() {return mCookie;}
+
+		//	Counts the app's references to a message lent by NSpMessage_GetBorrowed
+		inline	void				SetRefCount(NMUInt32 inCount) {mRefCount = inCount;}
+		inline	NMUInt32			AddRef() {return ++mRefCount;}
+		inline	NMUInt32			DropRef() {return --mRefCount;}
 		
 	protected:
 		NSpMessageHeader	*mMessage;
@@ -76,6 +81,7 @@
 		NMUInt32			mTimeReceived;
 		CEndpoint			*mEndpoint;
 		void				*mCookie;
+		NMUInt32			mRefCount;
 	};
 
 //	------------------------------	Public Functions
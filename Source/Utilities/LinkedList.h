@@ -47,6 +47,7 @@ class OSCriticalSection
 		~OSCriticalSection() {pthread_mutex_destroy(&theMutex);}
 		NMBoolean	acquire()	{	int error = pthread_mutex_trylock(&theMutex);
 									if (error) return false; else return true;}
+		void	wait()		{	pthread_mutex_lock(&theMutex);}
 		void	release()	{	pthread_mutex_unlock(&theMutex);}
 		private:
 		pthread_mutex_t theMutex;
@@ -58,6 +59,7 @@ class OSCriticalSection
 			OSCriticalSection() {OTClearLock(&theLock);}
 			~OSCriticalSection() {}
 			NMBoolean	acquire() {	return OTAcquireLock(&theLock);}
+			void	wait()		{	while (OTAcquireLock(&theLock) == false) {}}
 			void	release() 	{OTClearLock(&theLock);}
 		private:
 			OTLock theLock;
@@ -65,20 +67,26 @@ class OSCriticalSection
 #elif (OP_PLATFORM_WINDOWS)
 	// ECF 010928 win32 syncronization routines for safe critical sections.  We can't simply use TryEnterCriticalSection()
 	// to return a true/false value because it's not available in win95 and 98
+	// wait() sleeps on an auto-reset event that release() sets; if the release lands between a failed acquire()
+	// and the wait, the event is left set and we just go around again
 	class OSCriticalSection
 	{
 		public:
-			OSCriticalSection() {	locked = false; InitializeCriticalSection(&theCriticalSection);}
-			~OSCriticalSection() {	DeleteCriticalSection(&theCriticalSection);}
+			OSCriticalSection() {	locked = false; InitializeCriticalSection(&theCriticalSection);
+									released = CreateEvent(NULL, FALSE, FALSE, NULL);}
+			~OSCriticalSection() {	CloseHandle(released); DeleteCriticalSection(&theCriticalSection);}
 			NMBoolean	acquire()	{	if (locked == true) return false; //dont have to wait in this case	
 									EnterCriticalSection(&theCriticalSection);
 									if (locked) {LeaveCriticalSection(&theCriticalSection); return false;}
 									else {locked = true; LeaveCriticalSection(&theCriticalSection); return true;}}
+			void	wait()		{	while (acquire() == false) {WaitForSingleObject(released, INFINITE);}}
 			void	release()	{	EnterCriticalSection(&theCriticalSection);
-									locked = false; LeaveCriticalSection(&theCriticalSection);}
+									locked = false; LeaveCriticalSection(&theCriticalSection);
+									SetEvent(released);}
 		private:
 			NMBoolean locked;
 			CRITICAL_SECTION theCriticalSection;
+			HANDLE released;
 	};
 #else
 	#error "Linked list OSCriticalSection undefined"
@@ -116,7 +124,7 @@ class OSCriticalSection
 		
 			void	Enqueue(NMLink* link)
 							{ 
-								while (true) {if (theLock.acquire()) break;}
+								theLock.wait();
 								link->fNext = fHead;
 								fHead = link;	
 								theLock.release();	
@@ -125,7 +133,7 @@ class OSCriticalSection
 
 			NMLink*	Dequeue()
 							{
-								while (true) {if (theLock.acquire()) break;}						
+								theLock.wait();						
 								NMLink *origHead = fHead;
 								if (fHead) /* check for empty list */
 									fHead = fHead->fNext;
@@ -136,7 +144,7 @@ class OSCriticalSection
 						
 			NMLink*	StealList()
 							{	
-								while (true) {if (theLock.acquire()) break;}
+								theLock.wait();
 								NMLink *origHead = fHead;
 								fHead = NULL;
 								theLock.release();
@@ -150,6 +158,133 @@ class OSCriticalSection
 							}
 	};
 
+/*	-------------------------------------------------------------------------
+	** NMFIFO
+	**
+	** A lock-free FIFO that any number of threads may Enqueue onto, but only
+	** one thread may Dequeue from.  Producers never block or spin: each one
+	** swaps itself in as the new tail and then links the old tail to it.
+	** The consumer walks from the head, so items come out in the order they
+	** went in, without the steal-and-reverse pass an NMLIFO needs.
+	**
+	** A producer that has swapped the tail but not yet linked it makes the
+	** queue briefly look empty to the consumer; Dequeue returns NULL and the
+	** item turns up on the next call.
+	------------------------------------------------------------------------- */
+
+#if defined(OP_PLATFORM_UNIX) || defined(OP_PLATFORM_MAC_MACHO)
+	#if defined(__ATOMIC_ACQ_REL)
+		static inline NMLink*	NMAtomicSwapLink(NMLink** where, NMLink* link)
+									{ return __atomic_exchange_n(where, link, __ATOMIC_ACQ_REL); }
+		static inline NMLink*	NMAtomicLoadLink(NMLink** where)
+									{ return __atomic_load_n(where, __ATOMIC_ACQUIRE); }
+		static inline void		NMAtomicStoreLink(NMLink** where, NMLink* link)
+									{ __atomic_store_n(where, link, __ATOMIC_RELEASE); }
+		static inline NMSInt32	NMAtomicAdd32(volatile NMSInt32* where, NMSInt32 delta)
+									{ return __atomic_add_fetch(where, delta, __ATOMIC_SEQ_CST); }
+	#else
+		//	__sync_lock_test_and_set is only an acquire barrier, so fence first
+		static inline NMLink*	NMAtomicSwapLink(NMLink** where, NMLink* link)
+									{ __sync_synchronize(); return __sync_lock_test_and_set(where, link); }
+		static inline NMLink*	NMAtomicLoadLink(NMLink** where)
+									{ NMLink *link = *(NMLink* volatile *) where; __sync_synchronize(); return link; }
+		static inline void		NMAtomicStoreLink(NMLink** where, NMLink* link)
+									{ __sync_synchronize(); *(NMLink* volatile *) where = link; }
+		static inline NMSInt32	NMAtomicAdd32(volatile NMSInt32* where, NMSInt32 delta)
+									{ return __sync_add_and_fetch(where, delta); }
+	#endif
+#elif (OP_PLATFORM_MAC_CFM)
+	static inline NMLink*	NMAtomicSwapLink(NMLink** where, NMLink* link)
+								{	NMLink *old;
+									do { old = *(NMLink* volatile *) where; }
+									while (!OTCompareAndSwapPtr(old, link, (void**) where));
+									return old;}
+	static inline NMLink*	NMAtomicLoadLink(NMLink** where)
+								{ return *(NMLink* volatile *) where; }
+	static inline void		NMAtomicStoreLink(NMLink** where, NMLink* link)
+								{ *(NMLink* volatile *) where = link; }
+	static inline NMSInt32	NMAtomicAdd32(volatile NMSInt32* where, NMSInt32 delta)
+								{ return OTAtomicAdd32(delta, (SInt32*) where); }
+#elif (OP_PLATFORM_WINDOWS)
+	//	volatile accesses are acquire/release under MSVC
+	static inline NMLink*	NMAtomicSwapLink(NMLink** where, NMLink* link)
+								{ return (NMLink*) InterlockedExchangePointer((PVOID volatile *) where, link); }
+	static inline NMLink*	NMAtomicLoadLink(NMLink** where)
+								{ return *(NMLink* volatile *) where; }
+	static inline void		NMAtomicStoreLink(NMLink** where, NMLink* link)
+								{ *(NMLink* volatile *) where = link; }
+	static inline NMSInt32	NMAtomicAdd32(volatile NMSInt32* where, NMSInt32 delta)
+								{ return InterlockedExchangeAdd((LONG volatile *) where, delta) + delta; }
+#else
+	#error "Linked list atomics undefined"
+#endif
+
+	class NMFIFO
+	{
+		public:
+			NMLink	fStub;
+			NMLink*	fHead;		//	consumer side
+			NMLink*	fTail;		//	producer side
+		
+			void	Init()
+					{
+						fStub.fNext = NULL;
+						fHead = &fStub;
+						fTail = &fStub;
+					}
+
+			void	Enqueue(NMLink* link)
+							{
+								link->fNext = NULL;
+								NMLink *prev = NMAtomicSwapLink(&fTail, link);
+								NMAtomicStoreLink(&prev->fNext, link);
+							}
+
+			//	Only ever call this from the one consumer thread
+			NMLink*	Dequeue()
+							{
+								NMLink *head = fHead;
+								NMLink *next = NMAtomicLoadLink(&head->fNext);
+
+								//	step over the stub
+								if (head == &fStub)
+								{
+									if (next == NULL)
+										return NULL;
+
+									fHead = head = next;
+									next = NMAtomicLoadLink(&head->fNext);
+								}
+
+								if (next)
+								{
+									fHead = next;
+									return head;
+								}
+
+								//	head is the last item; a producer is mid-enqueue behind it
+								if (head != NMAtomicLoadLink(&fTail))
+									return NULL;
+
+								//	park the stub behind it so head can be handed out
+								Enqueue(&fStub);
+								next = NMAtomicLoadLink(&head->fNext);
+
+								if (next)
+								{
+									fHead = next;
+									return head;
+								}
+
+								return NULL;
+							}
+
+			NMBoolean	IsEmpty()
+							{
+								return fHead == &fStub && NMAtomicLoadLink(&fStub.fNext) == NULL;
+							}
+	};
+
 /*	-------------------------------------------------------------------------
 	** NMList
 	**
@@ -123,7 +123,8 @@ void *load_proc(
 	strcpy(function_name, module_names[proc_id]);
 	c2pstr(function_name);
 	err= FindSymbol(conn_id, (unsigned char *) function_name, &module_info, &sym_class);
-	op_assert(err == noErr);
+	if (err != noErr)
+		module_info= NULL;	/* optional functions (NMSendv etc) may be missing */
 	
 	return (void *) module_info;
 }
@@ -42,6 +42,17 @@ machine_acquire_lock(machine_lock *lockPtr)
 	return lockPtr->acquire();
 }
 
+//----------------------------------------------------------------------------------------
+// machine_wait_for_lock
+//----------------------------------------------------------------------------------------
+
+void
+machine_wait_for_lock(machine_lock *lockPtr)
+{
+	op_assert(lockPtr);
+	lockPtr->wait();
+}
+
 //----------------------------------------------------------------------------------------
 // machine_acquire_lock
 //----------------------------------------------------------------------------------------
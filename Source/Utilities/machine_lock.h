@@ -33,6 +33,7 @@
 //	------------------------------	Public Functions
 
 	extern	NMBoolean	machine_acquire_lock(machine_lock *lockPtr);
+	extern	void		machine_wait_for_lock(machine_lock *lockPtr);
 	extern	void		machine_clear_lock(machine_lock *lockPtr);
 
 #endif __MACHINELOCK__